@@ -6,6 +6,8 @@
 #include "encodeVideo.h"
 #include "capabilities.h"
 #include "tasks.h"
+#include "scalerCache.h"
+#include "frameArena.h"
 #include <math.h>
 #define VIDEO_TIMELINE_SIZE 98
 #define AUDIO_TIMELINE_SIZE 30
@@ -81,6 +83,33 @@ void MainComponent::SetVisibleButtons(bool visible)
     scale_timeline->setVisible(visible);
 }
 
+void _RepaintAfterRequest(void * object)
+{
+    MainComponent * o = (MainComponent *)object;
+    o->repaint();
+}
+
+void _AfterChangePosition(void * object)
+{
+    MainComponent * o = (MainComponent *)object;
+    CallEventList(o->AfterChangePosition);
+    o->ResizeViewport();
+    o->repaint();
+}
+
+/* frame asked for by the shuttle is decoded, the playback goes on from it */
+void _ShuttleFrameShown(void * object)
+{
+    MainComponent * o = (MainComponent *)object;
+    if(o->video_playing)
+    {
+        o->shuttle->FrameShown(o->timeline);
+        o->startTimer(1);
+    }
+    o->ResizeViewport();
+    o->repaint();
+}
+
 void MainComponent::ResizeViewport()
 {
     int height_current = getHeight();
@@ -97,24 +126,29 @@ void  MainComponent::timerCallback()
 {
     stopTimer();
 
-    int width_prev = timeline->GetImage()->getWidth();
-    int height_prev = timeline->GetImage()->getHeight();
-    timeline->ReadAndDecodeFrame();
-    if(timeline->GetImage()->getWidth()!=width_prev || timeline->GetImage()->getHeight() != height_prev)
+    int width_prev, height_prev;
+    {
+        const ScopedLock image_lock (timeline->GetImageLock());
+        width_prev = timeline->GetImage()->getWidth();
+        height_prev = timeline->GetImage()->getHeight();
+    }
+    // the shuttle waits for the seek thread itself, a keyframe of
+    // trick-play asked for meanwhile replaces the one waiting
+    int timer = shuttle->Tick(timeline,this,_ShuttleFrameShown);
+    bool resized;
+    {
+        const ScopedLock image_lock (timeline->GetImageLock());
+        resized = timeline->GetImage()->getWidth()!=width_prev || timeline->GetImage()->getHeight() != height_prev;
+    }
+    if(resized)
         ResizeViewport();
     repaint();
 
-    int spend = Time::getCurrentTime().toMilliseconds()-miliseconds_start;
-    if(miliseconds_start<0)
-        spend = 0;
-    int need = 1000.0 / timeline->GetFps();
-
-    int timer = need - spend;
-
-    if(timer<1)
-        timer = 1;
-
-    miliseconds_start = Time::getCurrentTime().toMilliseconds();
+    if(timer<0)
+    {
+        StopVideo();
+        return;
+    }
     startTimer(timer);
 
 }
@@ -240,6 +274,9 @@ MainComponent::MainComponent (MainAppWindow* mainWindow_)
     capabilities::InitFormats();
 
     tasks = new taskTab();
+    // the queue of the last run goes on
+    if(RestoreTasks()>0)
+        tasks->add();
 
     initImageButton(String("..\\pic\\zoomin.png"),zoomInButton);
     initImageButton(String("..\\pic\\zoomout.png"),zoomOutButton);
@@ -276,7 +313,7 @@ MainComponent::MainComponent (MainAppWindow* mainWindow_)
     ask_jump_target = 0;
 
     video_playing = false;
-    miliseconds_start = -1;
+    shuttle = new Shuttle();
 
     current_drag_x = -1;
     timeline_original = 0;
@@ -304,6 +341,7 @@ MainComponent::~MainComponent()
         delete viewed;
     }
 
+    delete shuttle;
     delete timeline;
     if(ask_jump_target)
     {
@@ -348,8 +386,12 @@ int MainComponent::GetMoviesBorder()
     int width_current = getWidth();
     int height_current = getHeight();
 
-    int width_image = timeline->GetImage()->getWidth();
-    int height_image = timeline->GetImage()->getHeight();
+    int width_image, height_image;
+    {
+        const ScopedLock image_lock (timeline->GetImageLock());
+        width_image = timeline->GetImage()->getWidth();
+        height_image = timeline->GetImage()->getHeight();
+    }
 
     int res = 300;
     float scalex = (float)(width_current-310.0f)/(float)width_image;
@@ -370,25 +412,29 @@ void MainComponent::paint (Graphics& g)
         int width_current = getWidth();
         int height_current = getHeight();
 
-        int width_image = timeline->GetImage()->getWidth();
-        int height_image = timeline->GetImage()->getHeight();
-
-        float scalex = (width_current-310.0f )/(float)width_image;
-        float scaley = (height_current-230.0f - TIMELINE_OFFSET)/(float)height_image;
-        float scale = scalex;
-        float deltax = 305.0f;
-        float deltay = 0.0f;
-        if(scaley<scalex)
         {
-            scale = scaley;
-            deltax += ((float)width_current - 310.0f  - (float)width_image*scale) - 5.0f;
-        }
-        else
-        {
-            deltay += ((float)height_current - 230.0f - TIMELINE_OFFSET - (float)height_image*scale)/2.0f;
-        }
+            // the seek thread does not replace the picture while it is drawn
+            const ScopedLock image_lock (timeline->GetImageLock());
+            int width_image = timeline->GetImage()->getWidth();
+            int height_image = timeline->GetImage()->getHeight();
+
+            float scalex = (width_current-310.0f )/(float)width_image;
+            float scaley = (height_current-230.0f - TIMELINE_OFFSET)/(float)height_image;
+            float scale = scalex;
+            float deltax = 305.0f;
+            float deltay = 0.0f;
+            if(scaley<scalex)
+            {
+                scale = scaley;
+                deltax += ((float)width_current - 310.0f  - (float)width_image*scale) - 5.0f;
+            }
+            else
+            {
+                deltay += ((float)height_current - 230.0f - TIMELINE_OFFSET - (float)height_image*scale)/2.0f;
+            }
 
-        g.drawImageWithin(*(timeline->GetImage()),deltax,deltay,(width_image * scale),(height_image * scale) ,RectanglePlacement::centred,false);
+            g.drawImageWithin(*(timeline->GetImage()),deltax,deltay,(width_image * scale),(height_image * scale) ,RectanglePlacement::centred,false);
+        }
 
         g.setColour(Colour::fromRGB(70,70,70));
 
@@ -751,10 +797,23 @@ const PopupMenu MainComponent::getMenuForIndex (int menuIndex,
         menu.addCommandItem(commandManager,commandSave);
         menu.addSeparator();
         menu.addCommandItem(commandManager,commandPlay);
+        menu.addCommandItem(commandManager,commandPlayReverse);
         menu.addCommandItem(commandManager,commandPause);
         menu.addCommandItem(commandManager,commandStop);
+        {
+            PopupMenu shuttle_menu;
+            shuttle_menu.addCommandItem(commandManager,commandShuttleReverse);
+            shuttle_menu.addCommandItem(commandManager,commandShuttleReverseSlow);
+            shuttle_menu.addCommandItem(commandManager,commandShuttleStop);
+            shuttle_menu.addCommandItem(commandManager,commandShuttleForwardSlow);
+            shuttle_menu.addCommandItem(commandManager,commandShuttleForward);
+            menu.addSubMenu(MENU_SHUTTLE,shuttle_menu);
+        }
         menu.addSeparator();
         menu.addCommandItem(commandManager,commandShowTasks);
+        menu.addCommandItem(commandManager,commandPlaybackStatistics);
+        menu.addCommandItem(commandManager,commandExportPlaybackStatistics);
+        menu.addCommandItem(commandManager,commandScaleBenchmark);
         menu.addSeparator();
         menu.addCommandItem(commandManager,commandRemoveSpaces);
         menu.addSeparator();
@@ -801,6 +860,7 @@ bool MainComponent::perform (const InvocationInfo& info)
         if(interval)
         {
             StopVideo();
+            timeline->CancelRequests();
             if(timeline->intervals.size()==1 && encodeVideoWindow)
             {
                 encodeVideoWindow->closeButtonPressed();
@@ -812,6 +872,7 @@ bool MainComponent::perform (const InvocationInfo& info)
     break;
     case commandRemoveSpaces:
         {
+            timeline->CancelRequests();
             timeline->RemoveSpaces();
             sliderValueChanged(scale_timeline);
             repaint();
@@ -825,6 +886,7 @@ bool MainComponent::perform (const InvocationInfo& info)
 
     case commandSplit:
     {
+        timeline->CancelRequests();
         timeline->Split();
         repaintSlider();
     }
@@ -848,6 +910,76 @@ bool MainComponent::perform (const InvocationInfo& info)
     }
     break;
 
+    case commandPlayReverse:
+    {
+        PlayVideo(-1.0);
+    }
+    break;
+
+    case commandShuttleForward:
+    {
+        PlayVideo(Shuttle::Faster(shuttle->speed,true));
+    }
+    break;
+
+    case commandShuttleReverse:
+    {
+        PlayVideo(Shuttle::Faster(shuttle->speed,false));
+    }
+    break;
+
+    case commandShuttleForwardSlow:
+    {
+        PlayVideo(Shuttle::Slower(shuttle->speed,true));
+    }
+    break;
+
+    case commandShuttleReverseSlow:
+    {
+        PlayVideo(Shuttle::Slower(shuttle->speed,false));
+    }
+    break;
+
+    case commandShuttleStop:
+    {
+        StopVideo();
+    }
+    break;
+
+    case commandPlaybackStatistics:
+    {
+        toolbox::show_info_popup(MENU_PLAYBACK_STATISTICS,shuttle->clock.PrintStatistics(),this);
+    }
+    break;
+
+    case commandScaleBenchmark:
+    {
+        StopVideo();
+        if(isVideoReady() && timeline->GetCurrentInterval())
+        {
+            /* current picture of the player scaled to the usual output size */
+            Movie * movie = timeline->GetCurrentInterval()->movie;
+            String res = BenchmarkScaleQualities((AVPicture *)movie->pFrame, movie->pCodecCtx->width, movie->pCodecCtx->height, movie->pCodecCtx->pix_fmt, SCALE_BENCHMARK_WIDTH, SCALE_BENCHMARK_HEIGHT);
+            res += "\n" + BenchmarkFrameArena(SCALE_BENCHMARK_WIDTH, SCALE_BENCHMARK_HEIGHT);
+            toolbox::show_info_popup(MENU_SCALE_BENCHMARK,res,this);
+        }
+    }
+    break;
+
+    case commandExportPlaybackStatistics:
+    {
+        FileChooser fc (DIALOG_CHOOSE_STATISTICS_TO_SAVE,File::getCurrentWorkingDirectory().getChildFile("playback.csv"),"*.csv",true);
+        if (fc.browseForFileToSave(true))
+        {
+            File chosenFile = fc.getResult();
+            if(shuttle->clock.ExportStatistics(chosenFile))
+                AlertWindow::showMessageBox(AlertWindow::InfoIcon,FILE_SAVED,chosenFile.getFullPathName());
+            else
+                AlertWindow::showMessageBox(AlertWindow::WarningIcon,FILE_NOT_SAVED,chosenFile.getFullPathName());
+        }
+    }
+    break;
+
     case commandPause:
     {
         StopVideo();
@@ -857,67 +989,49 @@ bool MainComponent::perform (const InvocationInfo& info)
     case commandStop:
     {
         StopVideo();
-        timeline->GotoSecondAndRead(0.0);
-        repaint();
+        timeline->GotoSecondAndReadAsync(0.0,this,_RepaintAfterRequest);
     }
     break;
 
     case commandNextFrame:
     {
         StopVideo();
-        timeline->ReadAndDecodeFrame();
-        repaint();
+        timeline->SkipFramesAsync(1,this,_RepaintAfterRequest);
     }
     break;
 
     case commandPrevFrame:
     {
         StopVideo();
-
-        timeline->GoBack(1);
-        timeline->DecodeFrame();
-        repaint();
+        timeline->GoBackAsync(1,this,_RepaintAfterRequest);
     }
     break;
 
     case commandNext5Frame:
     {
         StopVideo();
-        for(int i = 0; i<5; ++i)
-        {
-            timeline->SkipFrame();
-        }
-        timeline->DecodeFrame();
-        repaint();
-
+        timeline->SkipFramesAsync(5,this,_RepaintAfterRequest);
     }
     break;
 
     case commandPrev5Frame:
     {
         StopVideo();
-
-        timeline->GoBack(5);
-        timeline->DecodeFrame();
-        repaint();
+        timeline->GoBackAsync(5,this,_RepaintAfterRequest);
     }
     break;
 
     case commandNextSecond:
     {
         StopVideo();
-        timeline->GotoSecondAndRead(timeline->current+1.0);
-        repaint();
-
+        timeline->GotoSecondAndReadAsync(timeline->GetRequestedSecond()+1.0,this,_RepaintAfterRequest);
     }
     break;
 
     case commandPrevSecond:
     {
         StopVideo();
-        timeline->GotoSecondAndRead(timeline->current-1.0);
-        repaint();
-
+        timeline->GotoSecondAndReadAsync(timeline->GetRequestedSecond()-1.0,this,_RepaintAfterRequest);
     }
     break;
 
@@ -973,6 +1087,7 @@ bool MainComponent::perform (const InvocationInfo& info)
                             stream = file_with_jpg_ext.createOutputStream();
                         }
 
+                        const ScopedLock image_lock (timeline->GetImageLock());
                         jpeg_format->writeImageToStream(*timeline->GetImage(),*stream);
                         if(stream)
                         {
@@ -1030,6 +1145,15 @@ void MainComponent::getAllCommands (Array <CommandID>& commands)
                               commandSaveFrame,
                               commandJump,
                               commandPlay,
+                              commandPlayReverse,
+                              commandShuttleForward,
+                              commandShuttleReverse,
+                              commandShuttleForwardSlow,
+                              commandShuttleReverseSlow,
+                              commandShuttleStop,
+                              commandPlaybackStatistics,
+                              commandExportPlaybackStatistics,
+                              commandScaleBenchmark,
                               commandPause,
                               commandPrevFrame,
                               commandNextFrame,
@@ -1056,11 +1180,27 @@ void MainComponent::StopVideo()
 {
     stopTimer();
     video_playing = false;
-    miliseconds_start = -1;
+    if(shuttle->Stop())
+    {
+        // decoder of the movie is still at the place where reverse playback started
+        timeline->GotoSecondAndReadAsync(timeline->current,this,_RepaintAfterRequest);
+    }
 }
 
 void MainComponent::StartVideo()
 {
+    PlayVideo(1.0);
+}
+
+void MainComponent::PlayVideo(double speed)
+{
+    // statistics are collected from the start until the playback is stopped
+    if(!video_playing)
+        shuttle->clock.Reset();
+    // speed is changed on the fly, direction change starts from the shown frame
+    if(!video_playing || (speed>0.0) != (shuttle->speed>0.0))
+        StopVideo();
+    shuttle->Start(speed);
     startTimer(1);
     video_playing = true;
 }
@@ -1109,6 +1249,46 @@ void MainComponent::getCommandInfo (CommandID commandID, ApplicationCommandInfo&
         result.setInfo (LABEL_PLAY, LABEL_PLAY, MENU_FILE, ApplicationCommandInfo::dontTriggerVisualFeedback);
         result.setActive(isVideoReady());
         break;
+    case commandPlayReverse:
+        result.setInfo (LABEL_PLAY_REVERSE, LABEL_PLAY_REVERSE, MENU_FILE, ApplicationCommandInfo::dontTriggerVisualFeedback);
+        result.addDefaultKeypress (T('R'), ModifierKeys::commandModifier);
+        result.setActive(isVideoReady());
+        break;
+    case commandShuttleForward:
+        result.setInfo (LABEL_SHUTTLE_FORWARD, LABEL_SHUTTLE_FORWARD, MENU_FILE, ApplicationCommandInfo::dontTriggerVisualFeedback);
+        result.addDefaultKeypress (T('L'), ModifierKeys());
+        result.setActive(isVideoReady());
+        break;
+    case commandShuttleReverse:
+        result.setInfo (LABEL_SHUTTLE_REVERSE, LABEL_SHUTTLE_REVERSE, MENU_FILE, ApplicationCommandInfo::dontTriggerVisualFeedback);
+        result.addDefaultKeypress (T('J'), ModifierKeys());
+        result.setActive(isVideoReady());
+        break;
+    case commandShuttleForwardSlow:
+        result.setInfo (LABEL_SHUTTLE_FORWARD_SLOW, LABEL_SHUTTLE_FORWARD_SLOW, MENU_FILE, ApplicationCommandInfo::dontTriggerVisualFeedback);
+        result.addDefaultKeypress (T('L'), ModifierKeys::shiftModifier);
+        result.setActive(isVideoReady());
+        break;
+    case commandShuttleReverseSlow:
+        result.setInfo (LABEL_SHUTTLE_REVERSE_SLOW, LABEL_SHUTTLE_REVERSE_SLOW, MENU_FILE, ApplicationCommandInfo::dontTriggerVisualFeedback);
+        result.addDefaultKeypress (T('J'), ModifierKeys::shiftModifier);
+        result.setActive(isVideoReady());
+        break;
+    case commandShuttleStop:
+        result.setInfo (LABEL_SHUTTLE_STOP, LABEL_SHUTTLE_STOP, MENU_FILE, ApplicationCommandInfo::dontTriggerVisualFeedback);
+        result.addDefaultKeypress (T('K'), ModifierKeys());
+        result.setActive(isVideoReady());
+        break;
+    case commandPlaybackStatistics:
+        result.setInfo (MENU_PLAYBACK_STATISTICS, MENU_PLAYBACK_STATISTICS, MENU_FILE, ApplicationCommandInfo::dontTriggerVisualFeedback);
+        break;
+    case commandExportPlaybackStatistics:
+        result.setInfo (MENU_EXPORT_PLAYBACK_STATISTICS, MENU_EXPORT_PLAYBACK_STATISTICS, MENU_FILE, ApplicationCommandInfo::dontTriggerVisualFeedback);
+        break;
+    case commandScaleBenchmark:
+        result.setInfo (MENU_SCALE_BENCHMARK, MENU_SCALE_BENCHMARK, MENU_FILE, ApplicationCommandInfo::dontTriggerVisualFeedback);
+        result.setActive(isVideoReady() && timeline->GetCurrentInterval());
+        break;
     case commandPause:
         result.setInfo (LABEL_PAUSE, LABEL_PAUSE, MENU_FILE, ApplicationCommandInfo::dontTriggerVisualFeedback);
         result.setActive(isVideoReady());
@@ -1160,6 +1340,7 @@ void MainComponent::itemDropped (const String& sourceDescription,Component* sour
         String description = getCurrentDragDescription();
         double pos = GetPositionSecond(x);
         int index = description.substring(1).getIntValue();
+        timeline_original->CancelRequests();
 
         if(description.startsWith("m"))
         {
@@ -1283,8 +1464,5 @@ void MainComponent::mouseExit(const MouseEvent& e)
 
 void MainComponent::GotoSecondAndRead(double second)
 {
-    timeline->GotoSecondAndRead(second);
-    CallEventList(AfterChangePosition);
-    ResizeViewport();
-    repaint();
+    timeline->GotoSecondAndReadAsync(second,this,_AfterChangePosition);
 }
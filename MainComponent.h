@@ -11,6 +11,7 @@
 #include "encodeVideo.h"
 #include "events.h"
 #include "taskTab.h"
+#include "shuttle.h"
 
 class AskJumpDestanation;
 class encodeVideo;
@@ -64,7 +65,16 @@ public:
         commandRemoveMovie          = 0x200E,
         commandSplit                = 0x200F,
         commandRemoveSpaces         = 0x2010,
-        commandShowTasks            = 0x2011
+        commandShowTasks            = 0x2011,
+        commandPlayReverse          = 0x2012,
+        commandShuttleForward       = 0x2013,
+        commandShuttleReverse       = 0x2014,
+        commandShuttleForwardSlow   = 0x2015,
+        commandShuttleReverseSlow   = 0x2016,
+        commandShuttleStop          = 0x2017,
+        commandPlaybackStatistics   = 0x2018,
+        commandExportPlaybackStatistics = 0x2019,
+        commandScaleBenchmark       = 0x201A
 
 
     };
@@ -106,11 +116,14 @@ public:
     bool isVideoReady ();
     void getCommandInfo (CommandID commandID, ApplicationCommandInfo& result);
 
-    int64 miliseconds_start;
     bool video_playing;
     void StopVideo();
     void StartVideo();
 
+    Shuttle * shuttle;
+    // negative speed plays backwards
+    void PlayVideo(double speed);
+
     int GetMoviesBorder();
 
     ContainerBox * movies_list;
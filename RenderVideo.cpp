@@ -2,6 +2,18 @@
 #include "timeline.h"
 #include "movie.h"
 #include "localization.h"
+#include "renderPipeline.h"
+#include "audioSource.h"
+#include "twoPass.h"
+#include "outputWriter.h"
+#include "scalerCache.h"
+#include "presetTuner.h"
+#include "renderTelemetry.h"
+#include "renderCheckpoint.h"
+#include "frameArena.h"
+#include "rawOutput.h"
+#include "chunkPlaylist.h"
+#include <algorithm>
 
 extern "C" {
 #include <libavcodec/opt.h>
@@ -11,11 +23,9 @@ using namespace localization;
 class RenderContext
 {
 public:
-    AVFrame *picture;
     uint8_t *video_outbuf;
     int frame_count, video_outbuf_size;
     bool end_writing;
-    float t, tincr, tincr2;
     int16_t *samples;
     uint8_t *audio_outbuf;
     int audio_outbuf_size;
@@ -23,9 +33,24 @@ public:
     int64_t pts;
     int current_pass;
     int all_pass;
-    String pass_info;
+    // statistics of the first pass, 0 for one pass
+    TwoPassStats *pass_stats;
+    // scaled pictures of the first pass are written here when it is not 0
+    FrameCache *frame_cache;
     bool is_codec_x264;
+    // stream headers are repeated with keyframes instead of the global header
+    bool inband_headers;
+    // contexts of the intervals already scaled
+    ScalerCache scalers;
     SwsContext *img_convert_ctx;
+    // flags of sws_getContext for the scale quality of the render
+    int scale_flags;
+    // threads of the encoder from the cores given to the task
+    int threads;
+    // compression preset chosen for the deadline, 0 - the one of the settings
+    int preset;
+    // output frames of a chunk of the segmented export, 0 - one file
+    int chunk_frames;
     bool error;
     String errorText;
     int srcW;
@@ -34,17 +59,43 @@ public:
     int dstH;
     double fpsr;
     int location;
-    uint8_t *data_original0,*data_original1,*data_original2;
-    uint8_t *data_real0,*data_real1,*data_real2;
+    // letterbox offsets of the picture planes
+    int offset0,offset1,offset2;
+    // changes with the scaling context, the letterbox has to be painted again
+    int geometry;
     PixelFormat srcFormat;
     PixelFormat dstFormat;
     RenderContext()
     {
-        picture = 0;
         video_outbuf = 0;
+        frame_count = 0;
+        video_outbuf_size = 0;
+        end_writing = false;
         samples = 0;
         audio_outbuf = 0;
+        audio_outbuf_size = 0;
+        audio_input_frame_size = 0;
+        pts = 1;
+        current_pass = 1;
+        all_pass = 1;
+        pass_stats = 0;
+        frame_cache = 0;
+        is_codec_x264 = false;
+        inband_headers = false;
         img_convert_ctx = 0;
+        scale_flags = SWS_BICUBIC;
+        threads = 1;
+        preset = 0;
+        chunk_frames = 0;
+        error = false;
+        srcW = srcH = 0;
+        dstW = dstH = 0;
+        fpsr = 0.0;
+        location = 0;
+        offset0 = offset1 = offset2 = 0;
+        geometry = 0;
+        srcFormat = PIX_FMT_NONE;
+        dstFormat = PIX_FMT_NONE;
     }
     ~RenderContext()
     {
@@ -52,30 +103,22 @@ public:
     }
     void Dispose()
     {
-        if(img_convert_ctx != NULL )
-        {
-            sws_freeContext(img_convert_ctx);
-            img_convert_ctx = NULL;
-        }
-        if(picture)
-        {
-            av_free(picture->data[0]);
-            av_free(picture);
-            picture = 0;
-        }
+        // the context belongs to the cache
+        img_convert_ctx = NULL;
+        scalers.Clear();
         if(video_outbuf)
         {
-            av_free(video_outbuf);
+            GetFrameArena().Free(video_outbuf);
             video_outbuf = 0;
         }
         if(samples)
         {
-            av_free(samples);
+            GetFrameArena().Free(samples);
             samples = 0;
         }
         if(audio_outbuf)
         {
-            av_free(audio_outbuf);
+            GetFrameArena().Free(audio_outbuf);
             audio_outbuf = 0;
         }
 
@@ -83,8 +126,6 @@ public:
 };
 
 
-static int sws_flags = SWS_GAUSS;
-
 
 extern "C" {
 #include <libavutil/intreadwrite.h>
@@ -658,6 +699,22 @@ static void setCompressionPreset(AVCodecContext *c, int preset,int pass_number,R
 }
 
 
+/* First pass only collects the statistics, so the slow analysis is turned
+   off the way x264 does it without --slow-firstpass. Frame types and rate
+   control stay as they are, the second pass depends on them */
+static void set_fast_first_pass(AVCodecContext *c, RenderContext *rc)
+{
+    if(!rc->is_codec_x264)
+        return;
+    av_set_string3(c,"refs","1",1,NULL);
+    av_set_string3(c,"partitions","-parti8x8-parti4x4-partp8x8-partp4x4-partb8x8",1,NULL);
+    av_set_string3(c,"me_method","dia",1,NULL);
+    av_set_string3(c,"trellis","0",1,NULL);
+    av_set_string3(c,"flags2","-dct8x8+fastpskip",1,NULL);
+    if(c->me_subpel_quality > 2)
+        av_set_string3(c,"subq","2",1,NULL);
+}
+
 static AVStream *add_video_stream(AVFormatContext *oc,const Movie::Info & info,RenderContext *rc)
 {
     AVCodecContext *c;
@@ -695,6 +752,7 @@ static AVStream *add_video_stream(AVFormatContext *oc,const Movie::Info & info,R
     {
         rc->is_codec_x264 = true;
     }
+    rc->scale_flags = GetScaleFlags(info.videos[0].scale_quality);
 
     /* put sample parameters */
     if(info.videos[0].is_bitrate_or_crf)
@@ -735,6 +793,7 @@ static AVStream *add_video_stream(AVFormatContext *oc,const Movie::Info & info,R
     if (codec->supported_framerates)
         fps = codec->supported_framerates[av_find_nearest_q_idx(fps, codec->supported_framerates)];
     rc->fpsr = (double)fps.den/(double)fps.num;
+    rc->chunk_frames = (info.videos[0].chunk_duration>0)?jmax(1, (int)floor(info.videos[0].chunk_duration / rc->fpsr + 0.5)):0;
     swapVariables(fps.num,fps.den);
     c->time_base = st->time_base = st->r_frame_rate = fps;
 
@@ -743,14 +802,14 @@ static AVStream *add_video_stream(AVFormatContext *oc,const Movie::Info & info,R
     else
         c->pix_fmt = PIX_FMT_YUV420P;
 
-    setCompressionPreset(c,info.videos[0].compressionPreset,(rc->all_pass>1)?rc->current_pass:2,rc);
+    setCompressionPreset(c,(rc->preset>0)?rc->preset:info.videos[0].compressionPreset,(rc->all_pass>1)?rc->current_pass:2,rc);
     if(info.videos[0].codec_short == "mjpeg")
         c->gop_size = 0;
     else
         c->gop_size = info.videos[0].gop;
 
     // some formats want stream headers to be separate
-    if(oc->oformat && oc->oformat->flags & AVFMT_GLOBALHEADER)
+    if(oc->oformat && oc->oformat->flags & AVFMT_GLOBALHEADER && !rc->inband_headers)
         c->flags |= CODEC_FLAG_GLOBAL_HEADER;
 
     //c->flags |= CODEC_FLAG2_LOCAL_HEADER;
@@ -758,16 +817,28 @@ static AVStream *add_video_stream(AVFormatContext *oc,const Movie::Info & info,R
     if(rc->all_pass>1)
     {
         if(rc->current_pass == 1)
+        {
             c->flags |= CODEC_FLAG_PASS1;
+            set_fast_first_pass(c, rc);
+        }
         else
         {
             c->flags |= CODEC_FLAG_PASS2;
 
-            c->stats_in = const_cast<char *>(rc->pass_info.toCString());
+            c->stats_in = (rc->pass_stats)?rc->pass_stats->Load():0;
+            if(!c->stats_in)
+            {
+                rc->error = true;
+                rc->errorText = LABEL_SAVE_VIDEO_ERROR_PASS_STATS;
+                return st;
+            }
         }
     }
     {
         const ScopedLock myScopedLock (avcodec_critical);
+        int threads = jmin(rc->threads, RENDER_MAX_CODEC_THREADS);
+        if(threads>1)
+            avcodec_thread_init(c, threads);
         if(avcodec_open(c, codec)<0)
         {
             rc->error = true;
@@ -779,10 +850,11 @@ static AVStream *add_video_stream(AVFormatContext *oc,const Movie::Info & info,R
     return st;
 }
 
-static AVStream *add_audio_stream(AVFormatContext *oc, enum CodecID codec_id,const Movie::Info & info, RenderContext *rc)
+static AVStream *add_audio_stream(AVFormatContext *oc, AVOutputFormat *fmt, const Movie::Info & info, RenderContext *rc)
 {
     AVCodecContext *c;
     AVStream *st;
+    const Movie::AudioInfo & audio_info = info.audios[0];
 
     st = av_new_stream(oc, 1);
     if (!st)
@@ -793,16 +865,26 @@ static AVStream *add_audio_stream(AVFormatContext *oc, enum CodecID codec_id,con
     }
 
     c = st->codec;
-    c->codec_id = codec_id;
+    AVCodec *codec = avcodec_find_encoder_by_name(audio_info.codec_short.toCString());
+    c->codec_id = (codec)?codec->id:fmt->audio_codec;
     c->codec_type = AVMEDIA_TYPE_AUDIO;
 
-
-
     /* put sample parameters */
     c->sample_fmt = AV_SAMPLE_FMT_S16;
-    c->bit_rate = 64000;
-    c->sample_rate = 44100;
-    c->channels = 2;
+    c->bit_rate = (audio_info.bit_rate>0)?audio_info.bit_rate * 1000:64000;
+    c->sample_rate = (audio_info.sample_rate>0)?audio_info.sample_rate:44100;
+    // resampler of libavcodec mixes only mono and stereo
+    c->channels = jlimit(1, 2, audio_info.channels);
+
+    /* the nearest rate the encoder supports */
+    if(codec && codec->supported_samplerates)
+    {
+        int best = codec->supported_samplerates[0];
+        for(const int * rate = codec->supported_samplerates; *rate; ++rate)
+            if(abs(*rate - c->sample_rate) < abs(best - c->sample_rate))
+                best = *rate;
+        c->sample_rate = best;
+    }
 
     // some formats want stream headers to be separate
     if(oc->oformat->flags & AVFMT_GLOBALHEADER)
@@ -837,14 +919,8 @@ static void open_audio(AVFormatContext *oc, AVStream *st,RenderContext *rc)
             return;
         }
     }
-    /* init signal generator */
-    rc->t = 0;
-    rc->tincr = 2 * M_PI * 110.0 / c->sample_rate;
-    /* increment frequency by 110 Hz per second */
-    rc->tincr2 = 2 * M_PI * 110.0 / c->sample_rate / c->sample_rate;
-
     rc->audio_outbuf_size = 262144;
-    rc->audio_outbuf = (uint8_t *)av_malloc(rc->audio_outbuf_size);
+    rc->audio_outbuf = GetFrameArena().Alloc(rc->audio_outbuf_size);
     if(!rc->audio_outbuf)
     {
         rc->error = true;
@@ -873,7 +949,7 @@ static void open_audio(AVFormatContext *oc, AVStream *st,RenderContext *rc)
         rc->audio_input_frame_size = c->frame_size;
     }
     int size_samples = rc->audio_input_frame_size * 2 * c->channels;
-    rc->samples = (int16_t *)av_malloc(size_samples);
+    rc->samples = (int16_t *)GetFrameArena().Alloc(size_samples);
     if(!rc->samples)
     {
         rc->error = true;
@@ -897,7 +973,7 @@ static AVFrame *alloc_picture(enum PixelFormat pix_fmt, int width, int height)
         av_free(picture);
         return 0;
     }
-    picture_buf = (uint8_t *)av_malloc(size);
+    picture_buf = GetFrameArena().Alloc(size);
     if (!picture_buf)
     {
         av_free(picture);
@@ -919,7 +995,7 @@ static void open_video(AVFormatContext *oc, AVStream *st, RenderContext* rc)
     {
         int video_outbuf_size_candidate = 6 * c->width * c->height + 200;
         rc->video_outbuf_size = (video_outbuf_size_candidate>262144)?video_outbuf_size_candidate:262144;
-        rc->video_outbuf = (uint8_t *)av_malloc(rc->video_outbuf_size);
+        rc->video_outbuf = GetFrameArena().Alloc(rc->video_outbuf_size);
         if(!rc->video_outbuf)
         {
             rc->error = true;
@@ -927,39 +1003,49 @@ static void open_video(AVFormatContext *oc, AVStream *st, RenderContext* rc)
             return;
         }
     }
-
-    rc->picture = alloc_picture(c->pix_fmt, c->width, c->height);
-    if(!rc->picture)
-    {
-        rc->error = true;
-        rc->errorText = LABEL_SAVE_VIDEO_ERROR_ENCODING_ALLOC_PICTURE;
-        return;
-    }
 }
 
-static void fill_frame(AVFrame *pict, int frame_index, const Movie::Info& info, Timeline * timeline,PixelFormat pix_fmt, RenderContext *rc)
+/* encodes audio_input_frame_size samples of rc->samples */
+static bool write_audio_frame(AVFormatContext *oc, AVStream *st, RenderContext* rc)
 {
+    AVCodecContext *c;
+    AVPacket pkt;
+    av_init_packet(&pkt);
 
-    Movie::VideoInfo video_info = info.videos[0];
-    int dstW_candidate = video_info.width;
-    int dstH_candidate = video_info.height;
-
-    if(!timeline->current_interval)
+    c = st->codec;
+    pkt.size = avcodec_encode_audio(c, rc->audio_outbuf, rc->audio_outbuf_size, rc->samples);
+    if(pkt.size<0)
     {
-        memset(pict->data[0],0,pict->linesize[0] * dstH_candidate);
-        memset(pict->data[1],128,(dstH_candidate/2) * pict->linesize[1]);
-        memset(pict->data[2],128,(dstH_candidate/2) * pict->linesize[2]);
+        rc->errorText =  LABEL_SAVE_VIDEO_ERROR_ENCODING_AUDIO_PACKET;
+        rc->error = true;
+        return false;
+    }
+    if (c->coded_frame && c->coded_frame->pts != AV_NOPTS_VALUE)
+        pkt.pts= av_rescale_q(c->coded_frame->pts, c->time_base, st->time_base);
+    pkt.flags |= AV_PKT_FLAG_KEY;
+    pkt.stream_index = st->index;
+    pkt.data = rc->audio_outbuf;
 
-        rc->end_writing = !timeline->SkipFrame();
-        return;
+    /* write the compressed frame in the media file */
+    if (av_interleaved_write_frame(oc, &pkt) <0)
+    {
+        rc->errorText =  LABEL_SAVE_VIDEO_ERROR_WRITTING_AUDIO_PACKET;
+        rc->error = true;
+        return false;
     }
-    Movie * movie = timeline->current_interval->movie;
+    return true;
+}
 
-    int srcW_candidate = movie->width;
-    int srcH_candidate = movie->height;
+static void fill_black(AVFrame *pict, int height)
+{
+    memset(pict->data[0],0,pict->linesize[0] * height);
+    memset(pict->data[1],128,(height/2) * pict->linesize[1]);
+    memset(pict->data[2],128,(height/2) * pict->linesize[2]);
+}
 
-    PixelFormat srcFormat_candidate = movie->GetMovieInfo()->videos[0].pix_fmt;
-    PixelFormat dstFormat_candidate = pix_fmt;
+/* geometry - version of the letterbox already painted on the picture */
+static String scale_picture(AVFrame *pict, int & geometry, AVPicture *src, int srcW_candidate, int srcH_candidate, PixelFormat srcFormat_candidate, int dstW_candidate, int dstH_candidate, PixelFormat dstFormat_candidate, RenderContext *rc)
+{
     if(
         rc->img_convert_ctx == NULL
         || rc->srcW != srcW_candidate
@@ -976,6 +1062,7 @@ static void fill_frame(AVFrame *pict, int frame_index, const Movie::Info& info,
         rc->dstH = dstH_candidate;
         rc->srcFormat = srcFormat_candidate;
         rc->dstFormat = dstFormat_candidate;
+        rc->geometry++;
         double c1 = (double)dstW_candidate / (double)srcW_candidate;
         double c2 = (double)dstH_candidate / (double)srcH_candidate;
 
@@ -989,327 +1076,3002 @@ static void fill_frame(AVFrame *pict, int frame_index, const Movie::Info& info,
         {
             coff = c2;
             rc->location = 1;
-        }else if(c1 < c2)
+        }else
         {
             coff = c1;
             rc->location = -1;
         }
 
-        if(rc->location!=0)
-        {
-            memset(pict->data[0],0,pict->linesize[0] * dstH_candidate);
-            memset(pict->data[1],128,(dstH_candidate/2) * pict->linesize[1]);
-            memset(pict->data[2],128,(dstH_candidate/2) * pict->linesize[2]);
-        }
-
-        if(rc->img_convert_ctx != NULL )
-        {
-            sws_freeContext(rc->img_convert_ctx);
-            rc->img_convert_ctx = NULL;
-        }
-
-        rc->img_convert_ctx = sws_getContext(rc->srcW, rc->srcH,
-                                             rc->srcFormat,
-                                             coff*rc->srcW, coff*rc->srcH,
-                                             rc->dstFormat,
-                                             sws_flags, NULL, NULL, NULL);
+        rc->img_convert_ctx = rc->scalers.Get(rc->srcW, rc->srcH,
+                                              rc->srcFormat,
+                                              coff*rc->srcW, coff*rc->srcH,
+                                              rc->dstFormat,
+                                              rc->scale_flags);
         if (rc->img_convert_ctx == NULL)
-        {
-            rc->errorText = "Can't initialize the conversion context";
-            rc->error = true;
-            return;
-        }
+            return "Can't initialize the conversion context";
+
         /* centering image */
-        rc->data_original0 = pict->data[0];
-        rc->data_original1 = pict->data[1];
-        rc->data_original2 = pict->data[2];
-        int linesize0 = pict->linesize[0],linesize1 = pict->linesize[1],linesize2 = pict->linesize[2];
+        rc->offset0 = rc->offset1 = rc->offset2 = 0;
         if(rc->location<0)
         {
             int realH = (int)(coff*rc->srcH);
             int diff_o = (rc->dstH - realH);
-            int diff = (linesize0)*(diff_o/2);
-
-            rc->data_real0 = pict->data[0] + diff;
-
-            int diff2 = (linesize1)*(diff_o/4);
-
-            rc->data_real1 = pict->data[1] + diff2;
-
-            rc->data_real2 = pict->data[2] + diff2;
-
+            rc->offset0 = pict->linesize[0]*(diff_o/2);
+            rc->offset1 = pict->linesize[1]*(diff_o/4);
+            rc->offset2 = pict->linesize[2]*(diff_o/4);
         }else if(rc->location>0)
         {
             int realW = (int)(coff*rc->srcW);
             int diff = (rc->dstW - realW)/2;
-            rc->data_real0 = pict->data[0] + diff;
-            rc->data_real1 = pict->data[1] + diff/2;
-            rc->data_real2 = pict->data[2] + diff/2;
-
+            rc->offset0 = diff;
+            rc->offset1 = diff/2;
+            rc->offset2 = diff/2;
         }
         /* ~centering image */
     }
-    if(rc->location!=0)
-    {
-        pict->data[0] = rc->data_real0;
-        pict->data[1] = rc->data_real1;
-        pict->data[2] = rc->data_real2;
-    }
-
-    int scale_res = sws_scale(rc->img_convert_ctx, movie->pFrame->data, movie->pFrame->linesize,
-                              0, movie->height, pict->data, pict->linesize);
-    if(rc->location!=0)
-    {
-        pict->data[0] = rc->data_original0;
-        pict->data[1] = rc->data_original1;
-        pict->data[2] = rc->data_original2;
-    }
+    if(rc->location!=0 && geometry != rc->geometry)
+        fill_black(pict, rc->dstH);
+    geometry = rc->geometry;
 
+    uint8_t *data[4] = {pict->data[0] + rc->offset0, pict->data[1] + rc->offset1, pict->data[2] + rc->offset2, pict->data[3]};
+    sws_scale(rc->img_convert_ctx, src->data, src->linesize,
+              0, rc->srcH, data, pict->linesize);
+    return String::empty;
 }
 
+class RenderPipeline;
 
-static bool write_video_frame(AVFormatContext *oc, AVStream *st, const Movie::Info& info, Timeline * timeline,RenderContext *rc)
+// Picture of the timeline in the pixel format of the decoder
+class DecodedFrame
 {
-    int out_size;
-    AVCodecContext *c;
-    c = st->codec;
-    while((double)rc->pts * rc->fpsr>timeline->current)
+public:
+    enum Kind
     {
-        fill_frame(rc->picture, rc->frame_count, info, timeline, c->pix_fmt, rc);
-        rc->end_writing = !timeline->SkipFrame();
-        if(rc->end_writing)
-            break;
+        Picture,
+        Black,
+        // output frame rate is higher than the source one, previous picture is encoded again
+        Repeat
+    }kind;
+    AVPicture picture;
+    int width;
+    int height;
+    PixelFormat pix_fmt;
+    bool allocated;
+    // pipeline of the decoder shared by the renditions, 0 for the frames of its own pipeline
+    RenderPipeline * owner;
+    // renditions which have not scaled the shared frame yet
+    Atomic<int> references;
+    DecodedFrame()
+    {
+        kind = Black;
+        allocated = false;
+        owner = 0;
     }
-
-    if(rc->error)
+    ~DecodedFrame()
     {
-        return false;
+        if(allocated)
+            GetFrameArena().FreePicture(&picture);
     }
-
-    if (oc->oformat->flags & AVFMT_RAWPICTURE)
+    bool Copy(Timeline * timeline)
     {
-        /* raw video case. The API will change slightly in the near
-           futur for that */
-        AVPacket pkt;
-        av_init_packet(&pkt);
-
-        pkt.flags |= AV_PKT_FLAG_KEY;
-        pkt.stream_index= st->index;
-        pkt.data= (uint8_t *)rc->picture;
-        pkt.size= sizeof(AVPicture);
-
-        if(av_interleaved_write_frame(oc, &pkt)<0)
+        if(!timeline->current_interval)
         {
-            rc->errorText =  LABEL_SAVE_VIDEO_ERROR_WRITTING_VIDEO_PACKET;
-            rc->error = true;
-            return false;
+            kind = Black;
+            return true;
         }
-    }
-    else
-    {
-        /* encode the image */
-
-        //if(rc->is_codec_x264)
-        rc->picture->pts = rc->pts++;
-        for(;;)
+        Movie * movie = timeline->current_interval->movie;
+        PixelFormat movie_pix_fmt = movie->pCodecCtx->pix_fmt;
+        if(!allocated || width != movie->width || height != movie->height || pix_fmt != movie_pix_fmt)
         {
-            /* flushing buffers */
-            AVFrame * send_picture = (rc->end_writing)?NULL:rc->picture;
-
-            out_size = avcodec_encode_video(c, rc->video_outbuf, rc->video_outbuf_size, send_picture);
-            /* if zero size, it means the image was buffered */
-
-            if (out_size < 0)
-            {
-                rc->errorText =  LABEL_SAVE_VIDEO_ERROR_ENCODING_VIDEO_PACKET;
-                rc->error = true;
-                return false;
-            }
-
-            if(out_size == 0)
-                break;
-
-            AVPacket pkt;
-            av_init_packet(&pkt);
-
-            if (c->coded_frame->pts != AV_NOPTS_VALUE)
-                pkt.pts= av_rescale_q(c->coded_frame->pts, c->time_base, st->time_base);
-            if(c->coded_frame->key_frame)
-                pkt.flags |= AV_PKT_FLAG_KEY;
-            pkt.stream_index= st->index;
-            pkt.data = rc->video_outbuf;
-            pkt.size = out_size;
-
-            /* write the compressed frame in the media file */
-            if(av_interleaved_write_frame(oc, &pkt)<0)
-            {
-                rc->errorText =  LABEL_SAVE_VIDEO_ERROR_WRITTING_VIDEO_PACKET;
-                rc->error = true;
+            if(allocated)
+                GetFrameArena().FreePicture(&picture);
+            width = movie->width;
+            height = movie->height;
+            pix_fmt = movie_pix_fmt;
+            allocated = GetFrameArena().AllocPicture(&picture, pix_fmt, width, height);
+            if(!allocated)
                 return false;
-            }
-            if(rc->all_pass>1 && c->stats_out)
-                rc->pass_info<<c->stats_out;
-            if (!rc->end_writing)
-                break;
-
         }
-
+        av_picture_copy(&picture, (AVPicture *)movie->pFrame, pix_fmt, width, height);
+        kind = Picture;
+        return true;
     }
+};
 
-    rc->frame_count++;
-    return true;
-}
-
-/* prepare a 16 bit dummy audio frame of 'frame_size' samples and
-   'nb_channels' channels */
-static void get_audio_frame(int16_t *samples, int frame_size, int nb_channels, const Movie::Info& info, Timeline * timeline,RenderContext* rc)
+// Picture in the pixel format and size of the encoder
+class ScaledFrame
 {
-    int j, i, v;
-    int16_t *q;
-
-    q = samples;
-    for(j=0; j<frame_size; j++)
+public:
+    AVFrame * picture;
+    int geometry;
+    ScaledFrame()
+    {
+        picture = 0;
+        geometry = -1;
+    }
+    ~ScaledFrame()
     {
-        v = (int)(sin(rc->t) * 10000);
-        for(i = 0; i < nb_channels; i++)
-            *q++ = v;
-        rc->t += rc->tincr;
-        rc->tincr += rc->tincr2;
+        if(picture)
+        {
+            GetFrameArena().Free(picture->data[0]);
+            av_free(picture);
+        }
     }
-}
+};
 
-static bool write_audio_frame(AVFormatContext *oc, AVStream *st, const Movie::Info& info, Timeline * timeline,RenderContext* rc)
+class EncodedPacket
 {
-    AVCodecContext *c;
-    AVPacket pkt;
-    av_init_packet(&pkt);
-
-    c = st->codec;
-    get_audio_frame(rc->samples, rc->audio_input_frame_size, c->channels, info, timeline, rc);
-
-    pkt.size = avcodec_encode_audio(c, rc->audio_outbuf, rc->audio_outbuf_size, rc->samples);
-    if(pkt.size<0)
+public:
+    uint8_t * data;
+    int size;
+    int64_t pts;
+    bool key;
+    // raw picture formats get the picture itself instead of a bitstream
+    AVPicture raw;
+    bool is_raw;
+    EncodedPacket()
     {
-        rc->errorText =  LABEL_SAVE_VIDEO_ERROR_ENCODING_AUDIO_PACKET;
-        rc->error = true;
-        return false;
+        data = 0;
+        size = 0;
+        pts = AV_NOPTS_VALUE;
+        key = false;
+        is_raw = false;
     }
-    if (c->coded_frame && c->coded_frame->pts != AV_NOPTS_VALUE)
-        pkt.pts= av_rescale_q(c->coded_frame->pts, c->time_base, st->time_base);
-    pkt.flags |= AV_PKT_FLAG_KEY;
-    pkt.stream_index = st->index;
-    pkt.data = rc->audio_outbuf;
-
-    /* write the compressed frame in the media file */
-    if (av_interleaved_write_frame(oc, &pkt) <0)
+    ~EncodedPacket()
     {
-        rc->errorText =  LABEL_SAVE_VIDEO_ERROR_WRITTING_AUDIO_PACKET;
-        rc->error = true;
-        return false;
+        if(is_raw)
+            GetFrameArena().FreePicture(&raw);
+        else if(data)
+            GetFrameArena().Free(data);
     }
-    return true;
-}
+};
 
-int _WritePacket(void* cookie, uint8_t* buffer, int bufferSize)
+// Frames go from the timeline to the file through four threads: decode,
+// scale, encode and mux. Pools of free frames bound the memory used. Sound
+// comes to the mux from its own decoder, as samples or as copied packets
+class RenderPipeline
 {
-    FileOutputStream* fs = reinterpret_cast<FileOutputStream*>(cookie);
-    bool res = fs->write(buffer,bufferSize);
-    fs->flush();
-    return (res)?bufferSize:0;
-}
+private:
+    CriticalSection critical;
+    String error;
+    bool aborted;
+    vector<DecodedFrame*> decoded_frames;
+    vector<ScaledFrame*> scaled_frames;
+    vector<RenderStage*> stages;
 
-int64_t _SeekWithOutputStream(void* cookie, int64_t offset, int whence)
-{
-    FileOutputStream* fs = reinterpret_cast<FileOutputStream*>(cookie);
-    int64_t real_offset = 0;
-    switch(whence)
+public:
+    RenderQueue<DecodedFrame*> decoded_free;
+    RenderQueue<DecodedFrame*> decoded;
+    RenderQueue<ScaledFrame*> scaled_free;
+    // NULL repeats the previous picture
+    RenderQueue<ScaledFrame*> scaled;
+    RenderQueue<EncodedPacket*> packets;
+    AudioRing audio;
+    RenderQueue<EncodedPacket*> audio_packets;
+    volatile bool paused;
+    // decoding stops at the current frame, the frames taken are encoded to the end
+    volatile bool draining;
+
+    RenderPipeline():
+        decoded_free(RENDER_PIPELINE_QUEUE + 2),
+        decoded(RENDER_PIPELINE_QUEUE),
+        scaled_free(RENDER_PIPELINE_QUEUE + 2),
+        scaled(RENDER_PIPELINE_QUEUE),
+        packets(RENDER_PIPELINE_QUEUE),
+        audio_packets(RENDER_AUDIO_PACKETS)
     {
-    case AVSEEK_SIZE:
-        return fs->getFile().getSize();
-    case SEEK_SET:
-        real_offset = offset;
-        break;
-    case SEEK_CUR:
-        real_offset = offset + fs->getPosition();
-        break;
-    case SEEK_END:
-        real_offset = fs->getFile().getSize() + offset - 1 ;
-        break;
-
+        aborted = false;
+        paused = false;
+        draining = false;
     }
-
-
-    fs->setPosition(offset);
-    return offset;
-}
-
-class CloseRender
-{
-public:
-    AVStream* video_st;
-    AVStream* audio_st;
-    AVFormatContext *oc;
-    ByteIOContext* ByteIOCtx;
-    unsigned char* pDataBuffer;
-    FileOutputStream* fs;
-    CloseRender()
+    ~RenderPipeline()
     {
-        video_st = 0;
-        audio_st = 0;
-        oc = 0;
-        ByteIOCtx = 0;
-        pDataBuffer = 0;
-        fs = 0;
+        Stop();
+        for(vector<RenderStage*>::iterator it = stages.begin(); it!=stages.end(); it++)
+            delete *it;
+        for(vector<DecodedFrame*>::iterator it = decoded_frames.begin(); it!=decoded_frames.end(); it++)
+            delete *it;
+        for(vector<ScaledFrame*>::iterator it = scaled_frames.begin(); it!=scaled_frames.end(); it++)
+            delete *it;
+        EncodedPacket * packet;
+        while(packets.TakeRest(packet))
+            delete packet;
+        while(audio_packets.TakeRest(packet))
+            delete packet;
     }
-    ~CloseRender()
+    void AllocDecodedFrames()
     {
-        if(video_st)
-        {
-            const ScopedLock myScopedLock (avcodec_critical);
-            avcodec_close(video_st->codec);
-            video_st = 0;
-        }
-        if(audio_st)
+        for(int i = 0; i<RENDER_PIPELINE_QUEUE + 2; ++i)
         {
-            const ScopedLock myScopedLock (avcodec_critical);
-            avcodec_close(audio_st->codec);
-            audio_st = 0;
+            DecodedFrame * frame = new DecodedFrame();
+            decoded_frames.push_back(frame);
+            decoded_free.Push(frame);
         }
-
-        if(oc)
+    }
+    bool AllocFrames(AVCodecContext * c)
+    {
+        return AllocFrames(c->width, c->height, c->pix_fmt);
+    }
+    bool AllocFrames(int width, int height, PixelFormat pix_fmt)
+    {
+        AllocDecodedFrames();
+        for(int i = 0; i<RENDER_PIPELINE_QUEUE + 2; ++i)
         {
-            for(int i = 0; i < oc->nb_streams; i++)
-            {
-                av_freep(&oc->streams[i]->codec);
-                av_freep(&oc->streams[i]);
-            }
-            av_free(oc);
-            oc = 0;
+            ScaledFrame * scaled_frame = new ScaledFrame();
+            scaled_frames.push_back(scaled_frame);
+            scaled_frame->picture = alloc_picture(pix_fmt, width, height);
+            if(!scaled_frame->picture)
+                return false;
+            scaled_free.Push(scaled_frame);
         }
-        if(pDataBuffer)
+        return true;
+    }
+    // frame shared by the renditions goes back to the pool of the decoder
+    // after the last of them has scaled it
+    void ReleaseDecoded(DecodedFrame * frame)
+    {
+        if(!frame->owner)
+            decoded_free.Push(frame);
+        else if(--(frame->references) == 0)
+            frame->owner->decoded_free.Push(frame);
+    }
+    void AddStage(RenderStage * stage)
+    {
+        stages.push_back(stage);
+    }
+    void Start()
+    {
+        for(vector<RenderStage*>::iterator it = stages.begin(); it!=stages.end(); it++)
+            (*it)->startThread(THREAD_PRIORITY_ENCODE);
+    }
+    bool IsRunning()
+    {
+        for(vector<RenderStage*>::iterator it = stages.begin(); it!=stages.end(); it++)
+            if((*it)->isThreadRunning())
+                return true;
+        return false;
+    }
+    void Stop()
+    {
+        Abort();
+        for(vector<RenderStage*>::iterator it = stages.begin(); it!=stages.end(); it++)
+            (*it)->signalThreadShouldExit();
+        for(vector<RenderStage*>::iterator it = stages.begin(); it!=stages.end(); it++)
+            (*it)->waitForThreadToExit(-1);
+    }
+    void Abort()
+    {
         {
-            delete []pDataBuffer;
-            pDataBuffer = 0;
+            const ScopedLock myScopedLock (critical);
+            aborted = true;
         }
-        if(ByteIOCtx)
+        decoded_free.Abort();
+        decoded.Abort();
+        scaled_free.Abort();
+        scaled.Abort();
+        packets.Abort();
+        audio.Abort();
+        audio_packets.Abort();
+    }
+    bool IsAborted()
+    {
+        const ScopedLock myScopedLock (critical);
+        return aborted;
+    }
+    // the first error stops the whole pipeline
+    void Fail(const String & text)
+    {
         {
-            delete ByteIOCtx;
-            ByteIOCtx = 0;
+            const ScopedLock myScopedLock (critical);
+            if(error.isEmpty())
+                error = text;
         }
-        if(fs)
+        Abort();
+    }
+    String GetError()
+    {
+        const ScopedLock myScopedLock (critical);
+        return error;
+    }
+    int GetStagesCount()
+    {
+        return (int)stages.size();
+    }
+    RenderStage * GetStage(int number)
+    {
+        return stages[number];
+    }
+    String PrintUtilisation()
+    {
+        String res;
+        for(vector<RenderStage*>::iterator it = stages.begin(); it!=stages.end(); it++)
         {
-            fs->flush();
-            delete fs;
-            fs = 0;
+            if(res.isNotEmpty())
+                res<<", ";
+            res<<(*it)->PrintUtilisation();
         }
-
+        return res;
+    }
+    // depth of the queues of the pictures and of the encoded packets
+    void SampleQueues(RenderTelemetry & telemetry)
+    {
+        telemetry.SampleQueue("decoded", decoded.GetSize(), decoded.GetCapacity());
+        telemetry.SampleQueue("scaled", scaled.GetSize(), scaled.GetCapacity());
+        telemetry.SampleQueue("packets", packets.GetSize(), packets.GetCapacity());
+    }
+    void ReportStages(RenderTelemetry & telemetry)
+    {
+        for(vector<RenderStage*>::iterator it = stages.begin(); it!=stages.end(); it++)
+            telemetry.AddStage((*it)->GetKey(), (*it)->label, (*it)->GetBusyMillis(), (*it)->GetRunningMillis(), (*it)->frames);
     }
 };
 
+// the source frame offset frames after the current one comes before the tick
+// of the output frame, in the same interval. Predicted from the frame rate
+// of the source, so nothing has to be decoded to know it
+static bool is_before_tick(Timeline * timeline, int offset, double tick)
+{
+    Timeline::Interval * interval = timeline->current_interval;
+    if(!interval || interval->movie->fps <= 0.0)
+        return false;
+    double second = timeline->current + (double)offset / interval->movie->fps;
+    return second < tick && second - interval->absolute_start + interval->start <= interval->end;
+}
 
-
-String Timeline::Render(const Movie::Info & info, Thread * thread, void (* reportProgress)(task*,double),task* t)
+// Walks the timeline with the output frame rate. Output frame takes the last
+// source frame before its tick, the cadence of the dropped and repeated
+// frames is decided from the timestamps. Dropped frames are not copied and
+// are not decoded unless other frames refer to them, repeated frames are
+// not scaled again
+class DecodeStage : public RenderStage
 {
+private:
+    RenderPipeline * pipeline;
+    Timeline * timeline;
+    double fpsr;
+    int64_t first;
+    int64_t count;
+
+public:
+    // all frames were taken, false if the pipeline was drained or stopped before
+    volatile bool complete;
+    // first - output frames before this stage, count - frames to take or -1 up to the end
+    DecodeStage(RenderPipeline * pipeline, Timeline * timeline, double fpsr, int64_t first = 0, int64_t count = -1):RenderStage("render decode thread", LABEL_RENDER_STAGE_DECODE)
+    {
+        this->pipeline = pipeline;
+        this->timeline = timeline;
+        this->fpsr = fpsr;
+        this->first = first;
+        this->count = count;
+        complete = false;
+    }
+    void run()
+    {
+        Begin();
+        int64_t pts = first + 1;
+        bool end = false;
+        DecodedFrame * frame;
+        while(!end && count != 0 && !pipeline->draining && Take(pipeline->decoded_free, frame))
+        {
+            while(pipeline->paused && !threadShouldExit())
+                Idle(100);
+            frame->kind = DecodedFrame::Repeat;
+            double tick = (double)pts * fpsr;
+            bool passed = false;
+            bool copied = false;
+            while(tick>timeline->current)
+            {
+                // the frame is overwritten by the next one before the tick
+                if(!is_before_tick(timeline, 1, tick))
+                {
+                    if(!frame->Copy(timeline))
+                    {
+                        pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_MEMORY);
+                        End();
+                        return;
+                    }
+                    copied = true;
+                }
+                // the next frame is decoded only if it can be the one taken
+                end = !(is_before_tick(timeline, 2, tick)?timeline->DropFrame():timeline->SkipFrame());
+                passed = true;
+                if(end)
+                    break;
+            }
+            if(end)
+                break;
+            // timestamps of the source were not regular, the picture decoded last is taken
+            if(passed && !copied && !frame->Copy(timeline))
+            {
+                pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_MEMORY);
+                End();
+                return;
+            }
+            pts++;
+            if(!Give(pipeline->decoded, frame))
+                break;
+            frames++;
+            if(count > 0)
+                count--;
+        }
+        complete = end || count == 0;
+        pipeline->decoded.Close();
+        End();
+    }
+};
+
+class ScaleStage : public RenderStage
+{
+private:
+    RenderPipeline * pipeline;
+    RenderContext * rc;
+    int width;
+    int height;
+    PixelFormat pix_fmt;
+
+public:
+    ScaleStage(RenderPipeline * pipeline, AVCodecContext * c, RenderContext * rc):RenderStage("render scale thread", LABEL_RENDER_STAGE_SCALE)
+    {
+        this->pipeline = pipeline;
+        this->rc = rc;
+        width = c->width;
+        height = c->height;
+        pix_fmt = c->pix_fmt;
+    }
+    ScaleStage(RenderPipeline * pipeline, int width, int height, PixelFormat pix_fmt, RenderContext * rc):RenderStage("render scale thread", LABEL_RENDER_STAGE_SCALE)
+    {
+        this->pipeline = pipeline;
+        this->rc = rc;
+        this->width = width;
+        this->height = height;
+        this->pix_fmt = pix_fmt;
+    }
+    void run()
+    {
+        Begin();
+        DecodedFrame * frame;
+        while(Take(pipeline->decoded, frame))
+        {
+            ScaledFrame * scaled_frame = 0;
+            if(frame->kind != DecodedFrame::Repeat)
+            {
+                if(!Take(pipeline->scaled_free, scaled_frame))
+                {
+                    pipeline->ReleaseDecoded(frame);
+                    break;
+                }
+                if(frame->kind == DecodedFrame::Black)
+                    fill_black(scaled_frame->picture, height);
+                else
+                {
+                    String error = scale_picture(scaled_frame->picture, scaled_frame->geometry, &frame->picture, frame->width, frame->height, frame->pix_fmt, width, height, pix_fmt, rc);
+                    if(error.isNotEmpty())
+                    {
+                        pipeline->ReleaseDecoded(frame);
+                        pipeline->scaled_free.Push(scaled_frame);
+                        pipeline->Fail(error);
+                        break;
+                    }
+                }
+            }
+            if(rc->frame_cache)
+            {
+                if(scaled_frame)
+                    rc->frame_cache->WritePicture(scaled_frame->picture);
+                else
+                    rc->frame_cache->WriteRepeat();
+            }
+            pipeline->ReleaseDecoded(frame);
+            if(!Give(pipeline->scaled, scaled_frame))
+                break;
+            frames++;
+        }
+        pipeline->scaled.Close();
+        End();
+    }
+};
+
+// Second pass reads the pictures scaled by the first one instead of the
+// decode and scale stages
+class CacheStage : public RenderStage
+{
+private:
+    RenderPipeline * pipeline;
+    FrameCache * cache;
+
+public:
+    CacheStage(RenderPipeline * pipeline, FrameCache * cache):RenderStage("render cache thread", LABEL_RENDER_STAGE_CACHE)
+    {
+        this->pipeline = pipeline;
+        this->cache = cache;
+    }
+    void run()
+    {
+        Begin();
+        ScaledFrame * scaled_frame = 0;
+        bool repeat = false;
+        while(!threadShouldExit())
+        {
+            while(pipeline->paused && !threadShouldExit())
+                Idle(100);
+            if(!scaled_frame && !Take(pipeline->scaled_free, scaled_frame))
+                break;
+            if(!cache->ReadPicture(scaled_frame->picture, repeat))
+            {
+                if(!cache->IsComplete())
+                    pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_FRAME_CACHE);
+                break;
+            }
+            if(!Give(pipeline->scaled, (repeat)?(ScaledFrame *)0:scaled_frame))
+                break;
+            if(!repeat)
+                scaled_frame = 0;
+            frames++;
+        }
+        if(scaled_frame)
+            pipeline->scaled_free.Push(scaled_frame);
+        pipeline->scaled.Close();
+        End();
+    }
+};
+
+class EncodeStage : public RenderStage
+{
+private:
+    RenderPipeline * pipeline;
+    AVFormatContext * oc;
+    AVStream * st;
+    RenderContext * rc;
+
+    bool Encode(AVFrame * picture)
+    {
+        AVCodecContext *c = st->codec;
+        EncodedPacket * packet;
+        if (oc->oformat->flags & AVFMT_RAWPICTURE)
+        {
+            /* raw video case. The API will change slightly in the near
+               futur for that */
+            packet = new EncodedPacket();
+            if(!GetFrameArena().AllocPicture(&packet->raw, c->pix_fmt, c->width, c->height))
+            {
+                delete packet;
+                pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_MEMORY);
+                return false;
+            }
+            packet->is_raw = true;
+            av_picture_copy(&packet->raw, (AVPicture *)picture, c->pix_fmt, c->width, c->height);
+            packet->data = (uint8_t *)&packet->raw;
+            packet->size = sizeof(AVPicture);
+            packet->key = true;
+            if(!Give(pipeline->packets, packet))
+            {
+                delete packet;
+                return false;
+            }
+            return true;
+        }
+
+        if(picture)
+        {
+            picture->pts = rc->pts++;
+            // every chunk of the segmented export begins with a keyframe
+            picture->pict_type = (rc->chunk_frames>0 && (picture->pts - 1) % rc->chunk_frames == 0)?FF_I_TYPE:0;
+        }
+        for(;;)
+        {
+            /* NULL picture flushes buffers */
+            int out_size = avcodec_encode_video(c, rc->video_outbuf, rc->video_outbuf_size, picture);
+            /* if zero size, it means the image was buffered */
+            if (out_size < 0)
+            {
+                pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_ENCODING_VIDEO_PACKET);
+                return false;
+            }
+            if(out_size == 0)
+                return true;
+
+            packet = new EncodedPacket();
+            packet->data = GetFrameArena().Alloc(out_size);
+            if(!packet->data)
+            {
+                delete packet;
+                pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_MEMORY);
+                return false;
+            }
+            memcpy(packet->data, rc->video_outbuf, out_size);
+            packet->size = out_size;
+            if (c->coded_frame->pts != AV_NOPTS_VALUE)
+                packet->pts = av_rescale_q(c->coded_frame->pts, c->time_base, st->time_base);
+            packet->key = c->coded_frame->key_frame;
+            if(rc->pass_stats && rc->current_pass==1 && c->stats_out)
+                rc->pass_stats->Write(c->stats_out);
+            if(!Give(pipeline->packets, packet))
+            {
+                delete packet;
+                return false;
+            }
+            if(picture)
+                return true;
+        }
+    }
+
+public:
+    EncodeStage(RenderPipeline * pipeline, AVFormatContext * oc, AVStream * st, RenderContext * rc):RenderStage("render encode thread", LABEL_RENDER_STAGE_ENCODE)
+    {
+        this->pipeline = pipeline;
+        this->oc = oc;
+        this->st = st;
+        this->rc = rc;
+    }
+    void run()
+    {
+        Begin();
+        // the last picture is kept for the repeated frames
+        ScaledFrame * last = 0;
+        ScaledFrame * scaled_frame;
+        bool res = true;
+        while(res && Take(pipeline->scaled, scaled_frame))
+        {
+            if(scaled_frame)
+            {
+                if(last)
+                    pipeline->scaled_free.Push(last);
+                last = scaled_frame;
+            }
+            if(!last)
+                continue;
+            res = Encode(last->picture);
+            if(res)
+                frames++;
+        }
+        if(res && !pipeline->IsAborted() && !(oc->oformat->flags & AVFMT_RAWPICTURE))
+            Encode(0);
+        pipeline->packets.Close();
+        End();
+    }
+};
+
+class CloseRender;
+
+// Cuts the output of the segmented export into the chunk files. The format
+// context is kept, every chunk gets its own header and trailer and the
+// writer goes on with the next file. A chunk begins with the first keyframe
+// after its duration, the playlist lists it when its trailer is written.
+// The encoder puts a keyframe at every chunk length; GOPs copied by the
+// smart render keep the keyframes of the source, so a chunk ending in one is
+// cut at its next keyframe and is listed with the duration it really has
+class ChunkWriter
+{
+private:
+    CloseRender * deleter;
+    String filename;
+    int buffer_size;
+    int64_t chunk_frames;
+    double fpsr;
+    int index;
+    // first output frame of the current chunk
+    int64_t first;
+    ChunkPlaylist playlist;
+
+public:
+    String error;
+    ChunkWriter(CloseRender * deleter, const String & filename, int buffer_size, int64_t chunk_frames, double fpsr);
+    bool Open();
+    bool IsCut(int64_t frame);
+    // the keyframe of the frame begins the next chunk
+    bool Cut(int64_t frame);
+    // the last chunk is listed after the trailer of the render
+    bool Finish(double duration);
+};
+
+class MuxStage : public RenderStage
+{
+private:
+    RenderPipeline * pipeline;
+    AVFormatContext * oc;
+    AVStream * video_st;
+    AVStream * audio_st;
+    const Movie::Info & info;
+    Timeline * timeline;
+    RenderContext * rc;
+    bool audio_passthrough;
+    bool audio_end;
+    ChunkWriter * chunks;
+
+    static double GetStreamSecond(AVStream * st)
+    {
+        return (double)st->pts.val * st->time_base.num / st->time_base.den;
+    }
+    /* sound ended before the pictures is continued with silence */
+    bool EncodeAudio()
+    {
+        int count = rc->audio_input_frame_size * audio_st->codec->channels;
+        int read = Take(pipeline->audio, rc->samples, count);
+        if(read < 0)
+            return false;
+        if(read < count)
+            memset(rc->samples + read, 0, (count - read) * sizeof(int16_t));
+        if(!write_audio_frame(oc, audio_st, rc))
+        {
+            pipeline->Fail(rc->errorText);
+            return false;
+        }
+        return true;
+    }
+    bool CopyAudio()
+    {
+        EncodedPacket * packet;
+        if(!Take(pipeline->audio_packets, packet))
+        {
+            audio_end = !pipeline->IsAborted();
+            return audio_end;
+        }
+        AVPacket pkt;
+        av_init_packet(&pkt);
+        pkt.pts = packet->pts;
+        pkt.flags |= AV_PKT_FLAG_KEY;
+        pkt.stream_index = audio_st->index;
+        pkt.data = packet->data;
+        pkt.size = packet->size;
+        bool res = av_interleaved_write_frame(oc, &pkt)>=0;
+        delete packet;
+        if(!res)
+            pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_WRITTING_AUDIO_PACKET);
+        return res;
+    }
+    /* audio is written up to the current video time */
+    bool WriteAudio(double second)
+    {
+        while(audio_st && !audio_end && GetStreamSecond(audio_st) < second)
+        {
+            if(!((audio_passthrough)?CopyAudio():EncodeAudio()))
+                return false;
+        }
+        return true;
+    }
+    bool Write(EncodedPacket * packet)
+    {
+        if(!WriteAudio(GetStreamSecond(video_st)))
+            return false;
+        /* packets come in the time base of the stream, encoded, stitched and
+           copied ones alike; the codec counts the frames from one */
+        if(chunks && packet->key && packet->pts != AV_NOPTS_VALUE)
+        {
+            int64_t frame = av_rescale_q(packet->pts, video_st->time_base, video_st->codec->time_base) - 1;
+            if(chunks->IsCut(frame) && !chunks->Cut(frame))
+            {
+                pipeline->Fail(chunks->error);
+                return false;
+            }
+        }
+
+        AVPacket pkt;
+        av_init_packet(&pkt);
+        if(packet->pts != AV_NOPTS_VALUE)
+            pkt.pts = packet->pts;
+        if(packet->key)
+            pkt.flags |= AV_PKT_FLAG_KEY;
+        pkt.stream_index = video_st->index;
+        pkt.data = packet->data;
+        pkt.size = packet->size;
+
+        /* write the compressed frame in the media file */
+        if(av_interleaved_write_frame(oc, &pkt)<0)
+        {
+            pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_WRITTING_VIDEO_PACKET);
+            return false;
+        }
+        return true;
+    }
+
+public:
+    // chunks - 0 for one file
+    MuxStage(RenderPipeline * pipeline, AVFormatContext * oc, AVStream * video_st, AVStream * audio_st, bool audio_passthrough, const Movie::Info & info, Timeline * timeline, RenderContext * rc, ChunkWriter * chunks):RenderStage("render mux thread", LABEL_RENDER_STAGE_MUX),info(info)
+    {
+        this->audio_passthrough = audio_passthrough;
+        this->chunks = chunks;
+        audio_end = false;
+        this->pipeline = pipeline;
+        this->oc = oc;
+        this->video_st = video_st;
+        this->audio_st = audio_st;
+        this->timeline = timeline;
+        this->rc = rc;
+    }
+    void run()
+    {
+        Begin();
+        EncodedPacket * packet;
+        bool res = true;
+        while(res && Take(pipeline->packets, packet))
+        {
+            res = Write(packet);
+            delete packet;
+            if(res)
+                frames++;
+        }
+        if(res && !video_st && !pipeline->IsAborted())
+            WriteAudio(timeline->duration);
+        // the rest of the sound is not needed, its decoder may wait for room
+        pipeline->audio.Abort();
+        pipeline->audio_packets.Abort();
+        End();
+    }
+};
+
+// Part of the timeline taken from one source, copied for the audio thread
+class AudioPart
+{
+public:
+    String filename;
+    double start;
+    double end;
+    double absolute_start;
+    double GetAbsoluteEnd() const
+    {
+        return end - start + absolute_start;
+    }
+};
+
+bool _CompareAudioParts(const AudioPart & a, const AudioPart & b)
+{
+    return a.absolute_start < b.absolute_start;
+}
+
+// Decodes the sound of the intervals in the timeline order into the ring of
+// the pipeline, gaps are filled with silence. Positions of the samples are
+// computed from the timeline seconds, so the sound stays in sync with the
+// pictures however the source timestamps drift. With passthrough the packets
+// are copied instead and their timestamps are moved to the timeline
+class AudioDecodeStage : public RenderStage
+{
+private:
+    RenderPipeline * pipeline;
+    vector<AudioPart> parts;
+    double duration;
+    AVStream * st;
+    bool passthrough;
+    int rate;
+    int channels;
+    int64_t written;
+    AudioReader reader;
+
+    int64_t ToSamples(double second)
+    {
+        return (int64_t)floor(second * rate + 0.5);
+    }
+    bool Write(const int16_t * samples, int64_t count)
+    {
+        if(count<=0)
+            return true;
+        if(!Give(pipeline->audio, samples, (int)(count * channels)))
+            return false;
+        written += count;
+        return true;
+    }
+    bool WriteSilence(int64_t until)
+    {
+        while(written < until)
+            if(!Write(0, jmin(until - written, (int64_t)rate)))
+                return false;
+        return true;
+    }
+    bool Open(const AudioPart & part)
+    {
+        if(reader.IsOpened() && reader.filename == part.filename)
+            return true;
+        return reader.Open(part.filename, rate, channels);
+    }
+    bool DecodePart(const AudioPart & part)
+    {
+        int64_t end = ToSamples(part.GetAbsoluteEnd());
+        // source without sound is silent
+        if(!Open(part))
+            return WriteSilence(end);
+        reader.Seek(part.start);
+        // jitter of the source timestamps is not corrected
+        int64_t tolerance = rate / 50;
+        while(written < end && !threadShouldExit())
+        {
+            while(pipeline->paused && !threadShouldExit())
+                Idle(100);
+            int16_t * samples;
+            double second;
+            int count = reader.Decode(&samples, second);
+            if(count < 0)
+                break;
+            int64_t at = ToSamples(part.absolute_start + second - part.start);
+            int64_t delta = at - written;
+            if(delta > -tolerance && delta < tolerance)
+                delta = 0;
+            if(delta > 0 && !WriteSilence(jmin(at, end)))
+                return false;
+            int64_t skip = (delta < 0)?-delta:0;
+            if(skip >= count)
+                continue;
+            if(!Write(samples + skip * channels, jmin((int64_t)count - skip, end - written)))
+                return false;
+            frames++;
+        }
+        return !threadShouldExit() && WriteSilence(end);
+    }
+    bool CopyPart(const AudioPart & part, int64_t & last_pts)
+    {
+        if(!Open(part))
+        {
+            pipeline->Fail(LABEL_TASK_TAB_ERROR_CANT_LOAD_FILE + part.filename);
+            return false;
+        }
+        reader.Seek(part.start);
+        double eps = 0.5 / rate;
+        bool res = true;
+        while(res && !threadShouldExit())
+        {
+            while(pipeline->paused && !threadShouldExit())
+                Idle(100);
+            double second;
+            AVPacket * packet = reader.ReadPacket(second);
+            if(!packet)
+                break;
+            bool after = second >= part.end - eps;
+            int64_t pts = (int64_t)floor((part.absolute_start + second - part.start) * st->time_base.den / st->time_base.num + 0.5);
+            /* packets crossing the cut would overlap the previous part */
+            if(!after && second >= part.start - eps && pts > last_pts)
+            {
+                EncodedPacket * encoded = new EncodedPacket();
+                encoded->data = GetFrameArena().Alloc(packet->size);
+                if(!encoded->data)
+                {
+                    delete encoded;
+                    pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_MEMORY);
+                    res = false;
+                }
+                else
+                {
+                    memcpy(encoded->data, packet->data, packet->size);
+                    encoded->size = packet->size;
+                    encoded->key = true;
+                    encoded->pts = pts;
+                    last_pts = pts;
+                    res = Give(pipeline->audio_packets, encoded);
+                    if(res)
+                        frames++;
+                    else
+                        delete encoded;
+                }
+            }
+            av_free_packet(packet);
+            delete packet;
+            if(after)
+                break;
+        }
+        return res && !threadShouldExit();
+    }
+
+public:
+    AudioDecodeStage(RenderPipeline * pipeline, const vector<AudioPart> & parts, double duration, AVStream * st, bool passthrough):RenderStage("render audio thread", LABEL_RENDER_STAGE_AUDIO)
+    {
+        this->pipeline = pipeline;
+        this->parts = parts;
+        this->duration = duration;
+        this->st = st;
+        this->passthrough = passthrough;
+        rate = st->codec->sample_rate;
+        channels = st->codec->channels;
+        written = 0;
+    }
+    // samples without the encoder, for the raw output
+    AudioDecodeStage(RenderPipeline * pipeline, const vector<AudioPart> & parts, double duration, int rate, int channels):RenderStage("render audio thread", LABEL_RENDER_STAGE_AUDIO)
+    {
+        this->pipeline = pipeline;
+        this->parts = parts;
+        this->duration = duration;
+        this->st = 0;
+        this->passthrough = false;
+        this->rate = rate;
+        this->channels = channels;
+        written = 0;
+    }
+    void run()
+    {
+        Begin();
+        bool res = true;
+        int64_t last_pts = AV_NOPTS_VALUE;
+        for(vector<AudioPart>::iterator it = parts.begin(); res && it!=parts.end(); it++)
+        {
+            if(passthrough)
+                res = CopyPart(*it, last_pts);
+            else
+                res = WriteSilence(ToSamples(it->absolute_start)) && DecodePart(*it);
+        }
+        if(res && !passthrough)
+            WriteSilence(ToSamples(duration));
+        reader.Close();
+        pipeline->audio.Close();
+        pipeline->audio_packets.Close();
+        End();
+    }
+};
+
+// Writes the scaled pictures to the YUV4MPEG2 stream instead of the encoder
+class RawVideoStage : public RenderStage
+{
+private:
+    RenderPipeline * pipeline;
+    RawOutput * output;
+    String filename;
+    String header;
+    int width;
+    int height;
+
+public:
+    RawVideoStage(RenderPipeline * pipeline, RawOutput * output, const String & filename, const String & header, int width, int height):RenderStage("render raw video thread", LABEL_RENDER_STAGE_OUTPUT)
+    {
+        this->pipeline = pipeline;
+        this->output = output;
+        this->filename = filename;
+        this->header = header;
+        this->width = width;
+        this->height = height;
+    }
+    void run()
+    {
+        Begin();
+        // a named pipe is opened here, so the reader may open the sound first
+        if(!output->Open(filename, this) || !output->Write(header.toUTF8(), header.getNumBytesAsUTF8()))
+        {
+            if(!threadShouldExit())
+                pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_WRITTING);
+            End();
+            return;
+        }
+        // the last picture is kept for the repeated frames
+        ScaledFrame * last = 0;
+        ScaledFrame * scaled_frame;
+        while(Take(pipeline->scaled, scaled_frame))
+        {
+            if(scaled_frame)
+            {
+                if(last)
+                    pipeline->scaled_free.Push(last);
+                last = scaled_frame;
+            }
+            if(!last)
+                continue;
+            if(!output->WritePicture((AVPicture *)last->picture, width, height))
+            {
+                pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_WRITTING);
+                break;
+            }
+            frames++;
+        }
+        if(!output->Close() && !pipeline->IsAborted())
+            pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_WRITTING);
+        End();
+    }
+};
+
+// Writes the samples to their own file or pipe. The thread of its own keeps
+// a reader taking the pictures first from stopping the sound and back
+class RawAudioStage : public RenderStage
+{
+private:
+    RenderPipeline * pipeline;
+    RawOutput output;
+    String filename;
+    int count;
+
+public:
+    RawAudioStage(RenderPipeline * pipeline, const String & filename, int rate, int channels):RenderStage("render raw audio thread", LABEL_RENDER_STAGE_AUDIO)
+    {
+        this->pipeline = pipeline;
+        this->filename = filename;
+        // a tenth of a second at once
+        count = jmax(1, rate / 10) * channels;
+    }
+    void run()
+    {
+        Begin();
+        int16_t * samples = (int16_t *)GetFrameArena().Alloc(count * sizeof(int16_t));
+        if(!samples)
+            pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_MEMORY);
+        else if(!output.Open(filename, this))
+        {
+            if(!threadShouldExit())
+                pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_WRITTING);
+        }
+        else
+        {
+            for(;;)
+            {
+                int read = Take(pipeline->audio, samples, count);
+                if(read <= 0)
+                    break;
+                if(!output.Write(samples, read * sizeof(int16_t)))
+                {
+                    pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_WRITTING);
+                    break;
+                }
+                frames++;
+                if(read < count)
+                    break;
+            }
+            if(!output.Close() && !pipeline->IsAborted())
+                pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_WRITTING);
+        }
+        GetFrameArena().Free(samples);
+        End();
+    }
+};
+
+int _WritePacket(void* cookie, uint8_t* buffer, int bufferSize)
+{
+    OutputWriter* writer = reinterpret_cast<OutputWriter*>(cookie);
+    bool res = writer->Write(buffer,bufferSize);
+    return (res)?bufferSize:0;
+}
+
+int64_t _SeekWithOutputStream(void* cookie, int64_t offset, int whence)
+{
+    OutputWriter* writer = reinterpret_cast<OutputWriter*>(cookie);
+    return writer->Seek(offset, whence);
+}
+
+class CloseRender
+{
+public:
+    AVStream* video_st;
+    AVStream* audio_st;
+    AVFormatContext *oc;
+    ByteIOContext* ByteIOCtx;
+    unsigned char* pDataBuffer;
+    OutputWriter* writer;
+    CloseRender()
+    {
+        video_st = 0;
+        audio_st = 0;
+        oc = 0;
+        ByteIOCtx = 0;
+        pDataBuffer = 0;
+        writer = 0;
+    }
+    ~CloseRender()
+    {
+        if(video_st)
+        {
+            const ScopedLock myScopedLock (avcodec_critical);
+            avcodec_close(video_st->codec);
+            video_st = 0;
+        }
+        if(audio_st)
+        {
+            const ScopedLock myScopedLock (avcodec_critical);
+            avcodec_close(audio_st->codec);
+            audio_st = 0;
+        }
+
+        if(oc)
+        {
+            for(int i = 0; i < oc->nb_streams; i++)
+            {
+                av_freep(&oc->streams[i]->codec);
+                av_freep(&oc->streams[i]);
+            }
+            av_free(oc);
+            oc = 0;
+        }
+        if(pDataBuffer)
+        {
+            delete []pDataBuffer;
+            pDataBuffer = 0;
+        }
+        if(ByteIOCtx)
+        {
+            delete ByteIOCtx;
+            ByteIOCtx = 0;
+        }
+        if(writer)
+        {
+            delete writer;
+            writer = 0;
+        }
+
+    }
+};
+
+
+ChunkWriter::ChunkWriter(CloseRender * deleter, const String & filename, int buffer_size, int64_t chunk_frames, double fpsr)
+{
+    this->deleter = deleter;
+    this->filename = filename;
+    this->buffer_size = buffer_size;
+    this->chunk_frames = chunk_frames;
+    this->fpsr = fpsr;
+    index = 0;
+    first = 0;
+}
+
+bool ChunkWriter::Open()
+{
+    return playlist.Open(filename);
+}
+
+bool ChunkWriter::IsCut(int64_t frame)
+{
+    return frame > first && frame - first >= chunk_frames;
+}
+
+bool ChunkWriter::Cut(int64_t frame)
+{
+    AVFormatContext * oc = deleter->oc;
+    if(av_write_trailer(oc))
+    {
+        error = LABEL_SAVE_VIDEO_ERROR_TRAILER;
+        return false;
+    }
+    File next = GetChunkFile(filename, index + 1);
+    next.deleteFile();
+    if(!deleter->writer->Next(next, RENDER_OUTPUT_DIRECT, 0) || !playlist.Add(GetChunkFile(filename, index), (frame - first) * fpsr))
+    {
+        error = LABEL_SAVE_VIDEO_ERROR_WRITTING;
+        return false;
+    }
+    index++;
+    first = frame;
+
+    /* the context starts from the beginning of the new file. The trailer has
+       freed the state of the muxer, the timestamps of the streams go on */
+    init_put_byte(deleter->ByteIOCtx, deleter->pDataBuffer, buffer_size, 1, deleter->writer, NULL, _WritePacket, _SeekWithOutputStream);
+    av_freep(&oc->priv_data);
+    vector<AVFrac> pts;
+    for(int i = 0; i < (int)oc->nb_streams; i++)
+        pts.push_back(oc->streams[i]->pts);
+    if(av_set_parameters(oc, NULL) < 0 || av_write_header(oc))
+    {
+        error = LABEL_SAVE_VIDEO_ERROR_HEADER;
+        return false;
+    }
+    for(int i = 0; i < (int)oc->nb_streams; i++)
+        oc->streams[i]->pts = pts[i];
+    return true;
+}
+
+bool ChunkWriter::Finish(double duration)
+{
+    return playlist.Add(GetChunkFile(filename, index), duration - first * fpsr) && playlist.Finish();
+}
+
+// Encoder of the samples of the timeline with one of the tried presets, the
+// encoders of all presets run at once
+class CalibrationEncoder : public Thread
+{
+public:
+    CloseRender deleter;
+    RenderContext rc;
+    const vector<AVFrame*> & pictures;
+    int preset;
+    double fps;
+    int64 bytes;
+
+    CalibrationEncoder(const vector<AVFrame*> & pictures, int preset):Thread("render calibration thread"),pictures(pictures)
+    {
+        this->preset = preset;
+        fps = 0.0;
+        bytes = 0;
+    }
+    ~CalibrationEncoder()
+    {
+        stopThread(-1);
+    }
+    bool Open(const Movie::Info & info, AVOutputFormat * fmt, int threads)
+    {
+        rc.is_codec_x264 = false;
+        rc.inband_headers = false;
+        rc.error = false;
+        rc.all_pass = 1;
+        rc.current_pass = 1;
+        rc.pts = 1;
+        rc.threads = threads;
+        rc.preset = preset;
+        deleter.oc = avformat_alloc_context();
+        if (!deleter.oc)
+            return false;
+        deleter.oc->oformat = fmt;
+        deleter.video_st = add_video_stream(deleter.oc, info, &rc);
+        if(rc.error)
+            return false;
+        open_video(deleter.oc, deleter.video_st, &rc);
+        return !rc.error;
+    }
+    void run()
+    {
+        AVCodecContext * c = deleter.video_st->codec;
+        double before = Time::getMillisecondCounterHiRes();
+        for(vector<AVFrame*>::const_iterator it = pictures.begin(); it!=pictures.end(); it++)
+        {
+            if(threadShouldExit())
+                return;
+            // pictures are shared by the encoders, the timestamp is not
+            AVFrame picture = **it;
+            picture.pts = rc.pts++;
+            int out_size = avcodec_encode_video(c, rc.video_outbuf, rc.video_outbuf_size, &picture);
+            if(out_size < 0)
+                return;
+            bytes += out_size;
+        }
+        /* delayed pictures are part of the cost of the preset */
+        int out_size;
+        while((out_size = avcodec_encode_video(c, rc.video_outbuf, rc.video_outbuf_size, 0)) > 0)
+            bytes += out_size;
+        double millis = Time::getMillisecondCounterHiRes() - before;
+        if(millis > 0.0)
+            fps = (double)pictures.size() * 1000.0 / millis;
+    }
+};
+
+/* pictures of the timeline at a few places, scaled for the encoder c.
+   decode_fps - pictures decoded and scaled per second */
+static bool get_calibration_pictures(Timeline * timeline, AVCodecContext * c, int scale_flags, double duration, vector<AVFrame*> & pictures, double & decode_fps)
+{
+    RenderContext scaler;
+    scaler.srcW = 0;
+    scaler.srcH = 0;
+    scaler.dstW = 0;
+    scaler.dstH = 0;
+    scaler.geometry = 0;
+    scaler.scale_flags = scale_flags;
+    DecodedFrame frame;
+    double millis = 0.0;
+    for(int i = 0; i<RENDER_CALIBRATION_SAMPLES; ++i)
+    {
+        timeline->GotoSecondAndRead(duration * (2 * i + 1) / (2 * RENDER_CALIBRATION_SAMPLES));
+        for(int j = 0; j<RENDER_CALIBRATION_FRAMES; ++j)
+        {
+            double before = Time::getMillisecondCounterHiRes();
+            AVFrame * picture = alloc_picture(c->pix_fmt, c->width, c->height);
+            if(!picture)
+                return false;
+            pictures.push_back(picture);
+            if(!frame.Copy(timeline))
+                return false;
+            int geometry = -1;
+            if(frame.kind == DecodedFrame::Black)
+                fill_black(picture, c->height);
+            else if(scale_picture(picture, geometry, &frame.picture, frame.width, frame.height, frame.pix_fmt, c->width, c->height, c->pix_fmt, &scaler).isNotEmpty())
+                return false;
+            bool more = timeline->SkipFrame();
+            millis += Time::getMillisecondCounterHiRes() - before;
+            if(!more)
+                break;
+        }
+    }
+    decode_fps = (millis > 0.0)?(double)pictures.size() * 1000.0 / millis:0.0;
+    return !pictures.empty();
+}
+
+static void free_calibration_pictures(vector<AVFrame*> & pictures)
+{
+    for(vector<AVFrame*>::iterator it = pictures.begin(); it!=pictures.end(); it++)
+    {
+        GetFrameArena().Free((*it)->data[0]);
+        av_free(*it);
+    }
+    pictures.clear();
+}
+
+/* presets tried for the deadline, from the fast ones to the slow ones */
+static const int calibration_presets[] = {9, 7, 5, 3};
+
+/* encodes the samples of the timeline with the tried presets at once and
+   chooses the preset of the export. frames - frames of the timeline are
+   written there, false if nothing could be measured */
+static bool calibrate_presets(Timeline * timeline, const Movie::Info & info, AVOutputFormat * fmt, RenderContext * rc, double duration, int cores, int segments, PresetTuner & tuner, int64_t & frames)
+{
+    int count = sizeof(calibration_presets) / sizeof(calibration_presets[0]);
+    int threads = jmax(1, cores / count);
+    vector<AVFrame*> pictures;
+    OwnedArray<CalibrationEncoder> encoders;
+    for(int i = 0; i<count; ++i)
+    {
+        CalibrationEncoder * encoder = new CalibrationEncoder(pictures, calibration_presets[i]);
+        encoders.add(encoder);
+        if(!encoder->Open(info, fmt, threads))
+            return false;
+    }
+    frames = (int64_t)(duration / encoders[0]->rc.fpsr);
+
+    double decode_fps = 0.0;
+    if(!get_calibration_pictures(timeline, encoders[0]->deleter.video_st->codec, rc->scale_flags, duration, pictures, decode_fps))
+    {
+        free_calibration_pictures(pictures);
+        return false;
+    }
+    for(int i = 0; i<count; ++i)
+        encoders[i]->startThread(THREAD_PRIORITY_ENCODE);
+    for(int i = 0; i<count; ++i)
+    {
+        encoders[i]->waitForThreadToExit(-1);
+        tuner.AddSample(encoders[i]->preset, encoders[i]->fps, (double)encoders[i]->bytes / pictures.size());
+    }
+    free_calibration_pictures(pictures);
+
+    /* the render is worth this many calibration encoders, segments decode
+       in parallel and the single encoder is limited by the codec threads */
+    int render_threads = (segments>1)?cores:jmin(cores, RENDER_MAX_CODEC_THREADS);
+    tuner.SetSpeed(decode_fps, (segments>1)?jmin(cores, segments):1, (double)render_threads / threads);
+    rc->preset = tuner.ChoosePreset(frames, rc->all_pass);
+    return rc->preset > 0;
+}
+
+// Writes the packets of one segment to a temporary or a checkpoint file
+// Packets of a segment are kept in its file with the timestamps in the time
+// base of the codec, the frame number of the output plus one. The stitch
+// rescales them to the stream of the output, which av_write_header may have
+// given another time base
+class SegmentWriterStage : public RenderStage
+{
+private:
+    RenderPipeline * pipeline;
+    File file;
+    // stream of the encoded packets, 0 if they come in the codec time base
+    AVStream * st;
+
+public:
+    volatile bool done;
+    SegmentWriterStage(RenderPipeline * pipeline, const File & file, AVStream * st):RenderStage("render segment thread", LABEL_RENDER_STAGE_MUX)
+    {
+        this->pipeline = pipeline;
+        this->file = file;
+        this->st = st;
+        done = false;
+    }
+    void run()
+    {
+        Begin();
+        // a segment interrupted before is written again from its start
+        file.deleteFile();
+        FileOutputStream * fs = file.createOutputStream();
+        if(!fs)
+        {
+            pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_WRITTING);
+            End();
+            return;
+        }
+        EncodedPacket * packet;
+        bool res = true;
+        while(res && Take(pipeline->packets, packet))
+        {
+            int64_t pts = packet->pts;
+            if(st && pts != AV_NOPTS_VALUE)
+                pts = av_rescale_q(pts, st->time_base, st->codec->time_base);
+            fs->writeInt64(pts);
+            fs->writeBool(packet->key);
+            fs->writeInt(packet->size);
+            res = fs->write(packet->data, packet->size);
+            delete packet;
+            if(res)
+                frames++;
+            else
+                pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_WRITTING);
+        }
+        fs->flush();
+        delete fs;
+        done = res && !pipeline->IsAborted();
+        End();
+    }
+};
+
+/* a unit of H.264 without the zero bytes which may follow it */
+static void add_nal_unit(vector<MemoryBlock> & units, const uint8_t * data, int length)
+{
+    while(length>0 && data[length - 1]==0)
+        length--;
+    if(length>0)
+        units.push_back(MemoryBlock(data, length));
+}
+
+/* units of an H.264 packet, nal_length_size - bytes of the length before
+   every unit as in mp4 and matroska, 0 for start codes */
+static void split_nal_units(const uint8_t * data, int size, int nal_length_size, vector<MemoryBlock> & units)
+{
+    if(nal_length_size>0)
+    {
+        int position = 0;
+        while(position + nal_length_size <= size)
+        {
+            int length = 0;
+            for(int i = 0; i<nal_length_size; ++i)
+                length = (length << 8) | data[position + i];
+            position += nal_length_size;
+            if(length<=0 || position + length > size)
+                break;
+            units.push_back(MemoryBlock(data + position, length));
+            position += length;
+        }
+        return;
+    }
+    int start = -1;
+    int i = 0;
+    while(i + 2 < size)
+    {
+        if(data[i]==0 && data[i + 1]==0 && data[i + 2]==1)
+        {
+            if(start>=0)
+                add_nal_unit(units, data + start, i - start);
+            i += 3;
+            start = i;
+        }
+        else
+            i++;
+    }
+    if(start>=0)
+        add_nal_unit(units, data + start, size - start);
+}
+
+static int get_nal_type(const MemoryBlock & unit)
+{
+    return (unit.getSize()>0)?((const uint8_t *)unit.getData())[0] & 0x1f:0;
+}
+
+/* 0 when the H.264 of the stream has start codes */
+static int get_nal_length_size(AVCodecContext * s)
+{
+    if(s->codec_id != CODEC_ID_H264 || s->extradata_size < 7 || s->extradata[0] != 1)
+        return 0;
+    return (s->extradata[4] & 3) + 1;
+}
+
+/* sequence and picture parameter sets of the stream headers, avcC of mp4
+   and matroska or units after start codes as x264 writes them */
+static void get_parameter_sets(const uint8_t * extradata, int size, vector<MemoryBlock> & sets)
+{
+    vector<MemoryBlock> units;
+    if(size >= 7 && extradata[0]==1)
+    {
+        int position = 5;
+        for(int list = 0; list<2 && position<size; ++list)
+        {
+            int count = extradata[position++] & ((list==0)?0x1f:0xff);
+            for(int i = 0; i<count && position + 2 <= size; ++i)
+            {
+                int length = (extradata[position] << 8) | extradata[position + 1];
+                position += 2;
+                if(position + length > size)
+                    break;
+                units.push_back(MemoryBlock(extradata + position, length));
+                position += length;
+            }
+        }
+    }
+    else if(size>0)
+        split_nal_units(extradata, size, 0, units);
+    for(vector<MemoryBlock>::iterator it = units.begin(); it!=units.end(); it++)
+    {
+        int type = get_nal_type(*it);
+        if(type==7 || type==8)
+            sets.push_back(*it);
+    }
+}
+
+/* the packet has an IDR picture, after which no frame refers to the ones
+   before it; an I picture of an open GOP is not enough to cut there */
+static bool is_idr_packet(const uint8_t * data, int size, int nal_length_size)
+{
+    vector<MemoryBlock> units;
+    split_nal_units(data, size, nal_length_size, units);
+    for(vector<MemoryBlock>::iterator it = units.begin(); it!=units.end(); it++)
+    {
+        if(get_nal_type(*it)==5)
+            return true;
+    }
+    return false;
+}
+
+/* the units with start codes before them */
+static MemoryBlock join_nal_units(const vector<MemoryBlock> & units)
+{
+    static const uint8_t start_code[4] = {0, 0, 0, 1};
+    MemoryBlock res;
+    for(vector<MemoryBlock>::const_iterator it = units.begin(); it!=units.end(); it++)
+    {
+        res.append(start_code, 4);
+        res.append(it->getData(), it->getSize());
+    }
+    return res;
+}
+
+// Copies the compressed packets of the source between two keyframes. Their
+// timestamps are output frames in the time base of the output codec, as the
+// ones of the encoded segments, the stitch rescales both to the stream.
+// H.264 is written with start codes as the encoder writes it and the
+// parameter sets of the encoder, which are the ones of the source, go
+// before every keyframe
+class CopyStage : public RenderStage
+{
+private:
+    RenderPipeline * pipeline;
+    String filename;
+    double start;
+    double end;
+    int64_t first;
+    int64_t count;
+    AVRational time_base;
+    MemoryBlock headers;
+
+    /* the packet in the arena with its units after start codes, 0 if there
+       is no memory */
+    uint8_t * ConvertPacket(AVPacket * packet, int nal_length_size, bool key, int & size)
+    {
+        vector<MemoryBlock> units;
+        split_nal_units(packet->data, packet->size, nal_length_size, units);
+        bool has_sets = false;
+        for(vector<MemoryBlock>::iterator it = units.begin(); it!=units.end(); it++)
+            has_sets = has_sets || get_nal_type(*it)==7;
+        MemoryBlock converted;
+        if(key && !has_sets)
+            converted = headers;
+        MemoryBlock joined = join_nal_units(units);
+        converted.append(joined.getData(), joined.getSize());
+        size = converted.getSize();
+        uint8_t * data = GetFrameArena().Alloc(size);
+        if(data)
+            memcpy(data, converted.getData(), size);
+        return data;
+    }
+
+public:
+    // start, end - movie seconds of the keyframes, first - output frame of the start keyframe,
+    // time_base - of the output codec, headers - parameter sets of the H.264 encoder with
+    // start codes, empty for the other codecs whose packets are copied as they are
+    CopyStage(RenderPipeline * pipeline, const String & filename, double start, double end, int64_t first, int64_t count, AVRational time_base, const MemoryBlock & headers):RenderStage("render copy thread", LABEL_RENDER_STAGE_COPY)
+    {
+        this->pipeline = pipeline;
+        this->filename = filename;
+        this->start = start;
+        this->end = end;
+        this->first = first;
+        this->count = count;
+        this->time_base = time_base;
+        this->headers = headers;
+    }
+    void run()
+    {
+        Begin();
+        Movie movie;
+        String load_filename = filename;
+        movie.Load(load_filename, true);
+        if(!movie.loaded)
+        {
+            pipeline->Fail(LABEL_TASK_TAB_ERROR_CANT_LOAD_FILE + filename);
+            End();
+            return;
+        }
+        double eps = 0.25 / movie.fps;
+        int nal_length_size = get_nal_length_size(movie.pCodecCtx);
+        int64_t start_pts = 0;
+        bool started = false;
+        bool res = true;
+        int64_t index = 0;
+        movie.SeekToSecond(start);
+        while(res && !threadShouldExit())
+        {
+            while(pipeline->paused && !threadShouldExit())
+                Idle(100);
+            AVPacket * packet = movie.ReadPacket();
+            if(!packet)
+                break;
+            double second = movie.ToSeconds(packet->dts - movie.pStream->start_time);
+            bool key = packet->flags & AV_PKT_FLAG_KEY;
+            if(key && headers.getSize()>0)
+                key = is_idr_packet(packet->data, packet->size, nal_length_size);
+            if(!started && key && second >= start - eps)
+            {
+                started = true;
+                if(packet->pts != AV_NOPTS_VALUE)
+                    start_pts = packet->pts;
+            }
+            if(started && key && second >= end - eps)
+            {
+                av_free_packet(packet);
+                delete packet;
+                break;
+            }
+            if(started)
+            {
+                /* frames before the start keyframe belong to the encoded part */
+                int64_t number = index;
+                if(packet->pts != AV_NOPTS_VALUE)
+                    number = av_rescale_q(packet->pts - start_pts, movie.pStream->time_base, time_base);
+                index++;
+                if(number >= 0 && number < count)
+                {
+                    EncodedPacket * encoded = new EncodedPacket();
+                    encoded->size = packet->size;
+                    if(headers.getSize()>0)
+                        encoded->data = ConvertPacket(packet, nal_length_size, key, encoded->size);
+                    else
+                    {
+                        encoded->data = GetFrameArena().Alloc(packet->size);
+                        if(encoded->data)
+                            memcpy(encoded->data, packet->data, packet->size);
+                    }
+                    if(!encoded->data)
+                    {
+                        delete encoded;
+                        pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_MEMORY);
+                        res = false;
+                    }
+                    else
+                    {
+                        encoded->key = key;
+                        encoded->pts = (packet->pts != AV_NOPTS_VALUE)?first + 1 + number:AV_NOPTS_VALUE;
+                        res = Give(pipeline->packets, encoded);
+                        if(res)
+                            frames++;
+                        else
+                            delete encoded;
+                    }
+                }
+            }
+            av_free_packet(packet);
+            delete packet;
+        }
+        pipeline->packets.Close();
+        End();
+    }
+};
+
+/* sources of the cloned timeline are opened by the thread which decodes them */
+static String load_movies(Timeline * timeline, int threads)
+{
+    for(vector<Timeline::Interval *>::iterator it = timeline->intervals.begin(); it!=timeline->intervals.end(); it++)
+    {
+        Movie * movie = (*it)->movie;
+        if(!movie->loaded)
+        {
+            movie->decoder_threads = jmax(1, threads / RENDER_DECODE_SHARE);
+            movie->Load(movie->filename,true);
+            if(!movie->loaded)
+                return LABEL_TASK_TAB_ERROR_CANT_LOAD_FILE + movie->filename;
+        }
+    }
+    timeline->RecalculateDuration();
+    return String::empty;
+}
+
+// Range of the output frames encoded by its own decoders and encoder, in
+// parallel with the other segments. Encoder starts with a keyframe, so
+// segments are joined without re-encoding. Segment of the smart render
+// copies the packets of the source instead
+class RenderSegment
+{
+public:
+    Timeline * timeline;
+    RenderContext rc;
+    CloseRender deleter;
+    RenderPipeline pipeline;
+    File file;
+    int64_t first;
+    int64_t count;
+    bool started;
+    DecodeStage * decode_stage;
+    EncodeStage * encode_stage;
+    CopyStage * copy_stage;
+    SegmentWriterStage * writer;
+
+    bool copy;
+    String copy_filename;
+    double copy_start;
+    double copy_end;
+    // of the output codec, the copied packets are numbered in it
+    AVRational copy_time_base;
+    // parameter sets of the H.264 encoder put before the copied keyframes
+    MemoryBlock copy_headers;
+    // segments of the smart render keep the stream headers with the keyframes
+    bool inband_headers;
+    // the file is a checkpoint kept until the whole render is finished
+    bool keep;
+    // taken from the checkpoint of an interrupted render
+    bool restored;
+    int64_t restored_frames;
+    bool journaled;
+
+    RenderSegment(int64_t first, int64_t count)
+    {
+        this->first = first;
+        this->count = count;
+        timeline = 0;
+        started = false;
+        decode_stage = 0;
+        encode_stage = 0;
+        copy_stage = 0;
+        writer = 0;
+        copy = false;
+        copy_start = copy_end = 0.0;
+        copy_time_base.num = 1;
+        copy_time_base.den = 25;
+        inband_headers = false;
+        keep = false;
+        restored = false;
+        restored_frames = 0;
+        journaled = false;
+        file = File::createTempFile(".segment");
+    }
+    ~RenderSegment()
+    {
+        pipeline.Stop();
+        if(!keep)
+            file.deleteFile();
+        if(timeline)
+            delete timeline;
+    }
+    void SetCheckpoint(const File & file)
+    {
+        this->file = file;
+        keep = true;
+    }
+    // the segment is not started, its file is stitched as it is
+    void Restore(const File & file, int64_t frames)
+    {
+        SetCheckpoint(file);
+        started = true;
+        restored = true;
+        journaled = true;
+        restored_frames = frames;
+    }
+    // threads - cores of the task given to this segment, preset - compression preset or 0 for the one of info
+    String Start(Timeline * source, const Movie::Info & info, AVOutputFormat * fmt, int threads, int preset)
+    {
+        started = true;
+        if(copy)
+        {
+            writer = new SegmentWriterStage(&pipeline, file, 0);
+            copy_stage = new CopyStage(&pipeline, copy_filename, copy_start, copy_end, first, count, copy_time_base, copy_headers);
+            pipeline.AddStage(copy_stage);
+            pipeline.AddStage(writer);
+            pipeline.Start();
+            return String::empty;
+        }
+
+        timeline = source->CloneIntervals();
+        String error = load_movies(timeline, threads);
+        if(error.isNotEmpty())
+            return error;
+
+        rc.threads = threads;
+        rc.preset = preset;
+        rc.srcW = 0;
+        rc.srcH = 0;
+        rc.dstW = 0;
+        rc.dstH = 0;
+        rc.geometry = 0;
+        rc.is_codec_x264 = false;
+        rc.inband_headers = inband_headers;
+        rc.error = false;
+        rc.all_pass = 1;
+        rc.current_pass = 1;
+
+        deleter.oc = avformat_alloc_context();
+        if (!deleter.oc)
+            return "Could not avformat_alloc_context";
+        deleter.oc->oformat = fmt;
+        deleter.video_st = add_video_stream(deleter.oc, info, &rc);
+        if(rc.error)
+            return rc.errorText;
+        open_video(deleter.oc, deleter.video_st, &rc);
+        if(rc.error)
+            return rc.errorText;
+        if(!pipeline.AllocFrames(deleter.video_st->codec))
+            return LABEL_SAVE_VIDEO_ERROR_ENCODING_ALLOC_PICTURE;
+
+        timeline->GotoSecondAndRead((double)first * rc.fpsr, false);
+        rc.pts = first + 1;
+        writer = new SegmentWriterStage(&pipeline, file, deleter.video_st);
+
+        decode_stage = new DecodeStage(&pipeline, timeline, rc.fpsr, first, count);
+        encode_stage = new EncodeStage(&pipeline, deleter.oc, deleter.video_st, &rc);
+        pipeline.AddStage(decode_stage);
+        pipeline.AddStage(new ScaleStage(&pipeline, deleter.video_st->codec, &rc));
+        pipeline.AddStage(encode_stage);
+        pipeline.AddStage(writer);
+        pipeline.Start();
+        return String::empty;
+    }
+    bool IsDone()
+    {
+        return restored || (writer && writer->done);
+    }
+    bool IsRunning()
+    {
+        return started && !IsDone() && pipeline.IsRunning();
+    }
+};
+
+class RenderSegments
+{
+public:
+    vector<RenderSegment*> list;
+    // compression preset of the segments started next, 0 - the one of the settings
+    int preset;
+    // segments running at once, 0 - one per core of the task
+    int parallel;
+    RenderSegments()
+    {
+        preset = 0;
+        parallel = 0;
+    }
+    ~RenderSegments()
+    {
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+            delete *it;
+    }
+    // segments are started in their order, no more than one per core of the
+    // task at once, the cores are divided between the segments running together
+    String StartNext(Timeline * source, const Movie::Info & info, AVOutputFormat * fmt, int cores)
+    {
+        int limit = jmax(1, (parallel>0)?jmin(cores, parallel):cores);
+        int threads = jmax(1, cores / jmin(limit, jmax(1, (int)list.size())));
+        int running = 0;
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+        {
+            if((*it)->IsRunning())
+                running++;
+        }
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end() && running<limit; it++)
+        {
+            if((*it)->started)
+                continue;
+            String error = (*it)->Start(source, info, fmt, threads, preset);
+            if(error.isNotEmpty())
+                return error;
+            running++;
+        }
+        return String::empty;
+    }
+    void SetPaused(bool paused)
+    {
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+            (*it)->pipeline.paused = paused;
+    }
+    int64_t GetEncodedFrames()
+    {
+        int64_t res = 0;
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+        {
+            if((*it)->encode_stage)
+                res += (*it)->encode_stage->frames;
+            if((*it)->copy_stage)
+                res += (*it)->copy_stage->frames;
+            res += (*it)->restored_frames;
+        }
+        return res;
+    }
+    int64_t GetRestoredFrames()
+    {
+        int64_t res = 0;
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+            res += (*it)->restored_frames;
+        return res;
+    }
+    // segments finished before are taken from the checkpoint, the others are
+    // written to it. Segment drained by a suspension is taken up to the frame
+    // it stopped at, the rest of it becomes a segment of its own
+    void Restore(RenderCheckpoint & checkpoint)
+    {
+        if(!checkpoint.IsEnabled())
+            return;
+        vector<RenderSegment*> restored;
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+        {
+            RenderSegment * segment = *it;
+            for(;;)
+            {
+                File file = checkpoint.GetSegmentFile(segment->first, segment->count);
+                bool complete = false;
+                int64_t frames = checkpoint.GetFinishedFrames(segment->first, segment->count, complete);
+                if(segment->count > 0 && frames >= segment->count)
+                    complete = true;
+                if(frames < 0 || (!complete && (frames == 0 || segment->copy)))
+                {
+                    segment->SetCheckpoint(file);
+                    restored.push_back(segment);
+                    break;
+                }
+                segment->Restore(file, frames);
+                restored.push_back(segment);
+                if(complete)
+                    break;
+                RenderSegment * rest = new RenderSegment(segment->first + frames, (segment->count < 0)?-1:segment->count - frames);
+                rest->inband_headers = segment->inband_headers;
+                segment = rest;
+            }
+        }
+        list = restored;
+    }
+    // finished and drained segments are written down in the journal of the checkpoint
+    void Checkpoint(RenderCheckpoint & checkpoint)
+    {
+        if(!checkpoint.IsEnabled())
+            return;
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+        {
+            if((*it)->journaled || !(*it)->IsDone())
+                continue;
+            (*it)->journaled = true;
+            RenderSegment * segment = *it;
+            bool complete = !segment->decode_stage || segment->decode_stage->complete;
+            int64_t frames = (segment->decode_stage)?segment->decode_stage->frames:segment->writer->frames;
+            // segment drained before its first frame is encoded again
+            if(complete || frames > 0)
+                checkpoint.AddFinished(segment->first, segment->count, frames, complete);
+        }
+    }
+    // running segments stop at the frame they have decoded and flush their
+    // encoders, so they can be kept in the checkpoint
+    void Drain(Thread * thread)
+    {
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+        {
+            if(!(*it)->IsRunning())
+                continue;
+            (*it)->pipeline.draining = true;
+            (*it)->pipeline.paused = false;
+        }
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+        {
+            while((*it)->IsRunning() && !(thread && thread->threadShouldExit()))
+                Thread::sleep(20);
+        }
+    }
+    String GetError()
+    {
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+        {
+            String error = (*it)->pipeline.GetError();
+            if(error.isNotEmpty())
+                return error;
+        }
+        return String::empty;
+    }
+    void SampleQueues(RenderTelemetry & telemetry)
+    {
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+        {
+            if((*it)->IsRunning() && !(*it)->copy)
+                (*it)->pipeline.SampleQueues(telemetry);
+        }
+    }
+    void ReportStages(RenderTelemetry & telemetry)
+    {
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+        {
+            if((*it)->started)
+                (*it)->pipeline.ReportStages(telemetry);
+        }
+    }
+    // stages with the same name are averaged over the started segments
+    String PrintUtilisation()
+    {
+        StringArray labels;
+        Array<double> sums;
+        Array<int> counts;
+        int started = 0;
+        for(vector<RenderSegment*>::iterator it = list.begin(); it!=list.end(); it++)
+        {
+            if(!(*it)->started)
+                continue;
+            started++;
+            for(int i = 0; i<(*it)->pipeline.GetStagesCount(); ++i)
+            {
+                RenderStage * stage = (*it)->pipeline.GetStage(i);
+                int index = labels.indexOf(stage->label);
+                if(index<0)
+                {
+                    index = labels.size();
+                    labels.add(stage->label);
+                    sums.add(0.0);
+                    counts.add(0);
+                }
+                sums.set(index, sums[index] + stage->GetUtilisation());
+                counts.set(index, counts[index] + 1);
+            }
+        }
+        if(!started)
+            return String::empty;
+        String res;
+        res<<started<<"/"<<(int)list.size()<<" x [";
+        for(int i = 0; i<labels.size(); ++i)
+        {
+            if(i>0)
+                res<<", ";
+            res<<labels[i]<<" "<<(int)(sums[i] * 100.0 / counts[i] + 0.5)<<"%";
+        }
+        res<<"]";
+        return res;
+    }
+};
+
+// Passes the packets of the finished segments to the muxer in their order
+class StitchStage : public RenderStage
+{
+private:
+    RenderPipeline * pipeline;
+    vector<RenderSegment*> & segments;
+    AVStream * st;
+
+    bool WaitFor(RenderSegment * segment)
+    {
+        while(!segment->IsDone())
+        {
+            if(threadShouldExit() || pipeline->IsAborted())
+                return false;
+            String error = segment->pipeline.GetError();
+            if(error.isNotEmpty())
+            {
+                pipeline->Fail(error);
+                return false;
+            }
+            Idle(50);
+        }
+        return true;
+    }
+    bool Stitch(RenderSegment * segment)
+    {
+        FileInputStream * in = segment->file.createInputStream();
+        if(!in)
+        {
+            pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_WRITTING);
+            return false;
+        }
+        bool res = true;
+        while(res && !in->isExhausted())
+        {
+            EncodedPacket * packet = new EncodedPacket();
+            packet->pts = in->readInt64();
+            // as the encoder does for the packets of one file
+            if(packet->pts != AV_NOPTS_VALUE)
+                packet->pts = av_rescale_q(packet->pts, st->codec->time_base, st->time_base);
+            packet->key = in->readBool();
+            packet->size = in->readInt();
+            packet->data = GetFrameArena().Alloc(packet->size);
+            if(!packet->data)
+            {
+                pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_MEMORY);
+                res = false;
+            }
+            else if(in->read(packet->data, packet->size) != packet->size)
+            {
+                pipeline->Fail(LABEL_SAVE_VIDEO_ERROR_WRITTING);
+                res = false;
+            }
+            else
+                res = Give(pipeline->packets, packet);
+            if(res)
+                frames++;
+            else
+                delete packet;
+        }
+        delete in;
+        if(!segment->keep)
+            segment->file.deleteFile();
+        return res;
+    }
+
+public:
+    // st - video stream of the output
+    StitchStage(RenderPipeline * pipeline, vector<RenderSegment*> & segments, AVStream * st):RenderStage("render stitch thread", LABEL_RENDER_STAGE_STITCH),segments(segments)
+    {
+        this->pipeline = pipeline;
+        this->st = st;
+    }
+    void run()
+    {
+        Begin();
+        bool res = true;
+        for(vector<RenderSegment*>::iterator it = segments.begin(); res && it!=segments.end(); it++)
+            res = WaitFor(*it) && Stitch(*it);
+        if(res)
+            pipeline->packets.Close();
+        End();
+    }
+};
+
+/* cores given to the task by the scheduler, all of them without a task */
+static int get_task_cores(task * t)
+{
+    return (t)?GetTaskCores(t):SystemStats::getNumCpus();
+}
+
+/* the timeline can be encoded by the separate encoders and joined */
+static bool can_split_into_segments(const Movie::Info & info, AVOutputFormat * fmt, RenderContext * rc)
+{
+    return info.videos.size()>0 && rc->all_pass==1 && !(fmt->flags & AVFMT_RAWPICTURE);
+}
+
+/* number of the segments rendered in parallel, 1 renders the whole timeline at once */
+static int get_segments_count(const Movie::Info & info, AVOutputFormat * fmt, RenderContext * rc, int64_t frames)
+{
+    if(!can_split_into_segments(info, fmt, rc))
+        return 1;
+    int segments = info.videos[0].segments;
+    if(segments<=0)
+        segments = SystemStats::getNumCpus();
+    // preset of an export with a deadline is changed between the segments
+    if(info.videos[0].deadline>0 && info.videos[0].codec_short == "libx264")
+        segments = jmax(segments, RENDER_DEADLINE_SEGMENTS);
+    // very short segments are mostly the start up of the decoders and encoders
+    int64_t min_frames = jmax(2 * info.videos[0].gop, RENDER_SEGMENT_MIN_FRAMES);
+    return (int)jlimit((int64_t)1, (int64_t)segments, frames / min_frames);
+}
+
+/* number of the segments the timeline is split into. With the checkpoints a
+   long timeline is split into more segments than are rendered at once, so
+   an interrupted render loses no more than a segment per encoder */
+static int get_parts_count(const Movie::Info & info, AVOutputFormat * fmt, RenderContext * rc, int64_t frames)
+{
+    int segments = get_segments_count(info, fmt, rc, frames);
+#if RENDER_CHECKPOINT
+    if(can_split_into_segments(info, fmt, rc))
+    {
+        int64_t min_frames = jmax(2 * info.videos[0].gop, RENDER_SEGMENT_MIN_FRAMES);
+        int64_t checkpoint_frames = jmax(min_frames, (int64_t)(RENDER_CHECKPOINT_SECONDS * info.videos[0].fps));
+        segments = (int)jmax((int64_t)segments, frames / checkpoint_frames);
+    }
+#endif
+    return segments;
+}
+
+/* everything the encoded packets of the segments depend on */
+static String get_checkpoint_signature(Timeline * timeline, const Movie::Info & info)
+{
+    const Movie::VideoInfo & video = info.videos[0];
+    String res;
+    res<<info.format_short<<"|"<<video.codec_short<<"|"<<video.codec_tag<<"|"<<video.width<<"x"<<video.height
+       <<"|"<<String(video.fps, 6)<<"|"<<(int)video.pix_fmt<<"|"<<video.bit_rate<<"|"<<(int)video.is_bitrate_or_crf
+       <<"|"<<video.gop<<"|"<<video.compressionPreset<<"|"<<video.segments<<"|"<<(int)video.smart_render
+       <<"|"<<video.scale_quality<<"|"<<video.deadline<<"|"<<video.chunk_duration;
+    for(vector<Timeline::Interval *>::iterator it = timeline->intervals.begin(); it!=timeline->intervals.end(); it++)
+    {
+        File source((*it)->movie->filename);
+        res<<"|"<<(*it)->movie->filename<<"|"<<String(source.getSize())<<"|"<<String(source.getLastModificationTime().toMilliseconds())
+           <<"|"<<String((*it)->start, 6)<<"|"<<String((*it)->end, 6);
+    }
+    return res;
+}
+
+/* first output frames of the segments, every segment begins with a new GOP */
+static vector<int64_t> split_into_segments(int64_t frames, int segments, int gop)
+{
+    vector<int64_t> res;
+    res.push_back(0);
+    for(int i = 1; i<segments; ++i)
+    {
+        int64_t start = frames * i / segments;
+        if(gop>0)
+            start = (start + gop / 2) / gop * gop;
+        if(start > res.back() && start < frames)
+            res.push_back(start);
+    }
+    return res;
+}
+
+// Part of an interval between two keyframes copied by the smart render
+class SmartCopy
+{
+public:
+    String filename;
+    // movie seconds of the keyframes
+    double start;
+    double end;
+    // output frames
+    int64_t first;
+    int64_t count;
+};
+
+bool _CompareSmartCopies(const SmartCopy & a, const SmartCopy & b)
+{
+    return a.first < b.first;
+}
+
+/* source stream has the parameters of the output and its packets can be
+   copied. The muxer takes the decoding order from the delay of the encoder,
+   the source must reorder its frames as much */
+static bool is_stream_compatible(Movie * movie, AVCodecContext * c, double fpsr)
+{
+    AVCodecContext * s = movie->pCodecCtx;
+    if(s->codec_id != c->codec_id || s->width != c->width || s->height != c->height || s->pix_fmt != c->pix_fmt)
+        return false;
+    if(s->has_b_frames != c->has_b_frames)
+        return false;
+    return movie->fps > 0.0 && fabs(1.0 / movie->fps - fpsr) < fpsr * 0.001;
+}
+
+/* stream headers of the output encoder. An encoder opened without the
+   global header is opened once more with it to get them */
+static bool get_encoder_headers(AVCodecContext * c, MemoryBlock & headers)
+{
+    if(c->extradata_size>0)
+    {
+        headers = MemoryBlock(c->extradata, c->extradata_size);
+        return true;
+    }
+    AVCodecContext * probe = avcodec_alloc_context();
+    if(!probe)
+        return false;
+    bool res = false;
+    if(avcodec_copy_context(probe, c)==0)
+    {
+        probe->flags |= CODEC_FLAG_GLOBAL_HEADER;
+        probe->thread_count = 1;
+        const ScopedLock myScopedLock (avcodec_critical);
+        if(avcodec_open(probe, c->codec)>=0)
+        {
+            headers = MemoryBlock(probe->extradata, probe->extradata_size);
+            res = true;
+            avcodec_close(probe);
+        }
+    }
+    av_freep(&probe->extradata);
+    av_freep(&probe->intra_matrix);
+    av_freep(&probe->inter_matrix);
+    av_freep(&probe->rc_override);
+    av_free(probe);
+    return res;
+}
+
+/* Finds the parts of the intervals from the first to the last keyframe in
+   them. A source is copied only when its packets can follow the encoded
+   ones in one stream: its headers are the ones of the output encoder, for
+   H.264 the same parameter sets and so the same profile and level, and
+   its copied parts start and end at IDR pictures. The parameter sets of the
+   encoder with start codes are returned in headers for the copy, empty for
+   the other codecs */
+static vector<SmartCopy> plan_smart_render(Timeline * timeline, AVCodecContext * c, double fpsr, MemoryBlock & headers)
+{
+    vector<SmartCopy> res;
+    headers.setSize(0);
+    MemoryBlock encoder_headers;
+    if(!get_encoder_headers(c, encoder_headers))
+        return res;
+    bool h264 = c->codec_id == CODEC_ID_H264;
+    vector<MemoryBlock> encoder_sets;
+    if(h264)
+    {
+        get_parameter_sets((const uint8_t *)encoder_headers.getData(), encoder_headers.getSize(), encoder_sets);
+        if(encoder_sets.empty())
+            return res;
+    }
+    int64_t min_frames = (int64_t)(1.0 / fpsr + 0.5);
+    for(vector<Timeline::Interval *>::iterator it = timeline->intervals.begin(); it!=timeline->intervals.end(); it++)
+    {
+        Timeline::Interval * interval = *it;
+        Movie movie;
+        String filename = interval->movie->filename;
+        movie.Load(filename, true);
+        if(!movie.loaded || !is_stream_compatible(&movie, c, fpsr))
+            continue;
+        AVCodecContext * s = movie.pCodecCtx;
+        if(!h264 && MemoryBlock(s->extradata, s->extradata_size) != encoder_headers)
+            continue;
+        // sets of a stream without global headers are taken from its first IDR picture
+        vector<MemoryBlock> source_sets;
+        if(h264)
+            get_parameter_sets(s->extradata, s->extradata_size, source_sets);
+        int nal_length_size = get_nal_length_size(s);
+
+        double eps = 0.25 / movie.fps;
+        bool to_end = interval->end >= movie.duration - 1.0 / movie.fps;
+        double key_start = -1.0;
+        double key_end = -1.0;
+        movie.SeekToSecond(interval->start);
+        for(;;)
+        {
+            AVPacket * packet = movie.ReadPacket();
+            if(!packet)
+                break;
+            double second = movie.ToSeconds(packet->dts - movie.pStream->start_time);
+            bool key = packet->flags & AV_PKT_FLAG_KEY;
+            if(key && h264)
+            {
+                key = is_idr_packet(packet->data, packet->size, nal_length_size);
+                if(key && source_sets.empty())
+                {
+                    vector<MemoryBlock> units;
+                    split_nal_units(packet->data, packet->size, nal_length_size, units);
+                    for(vector<MemoryBlock>::iterator unit = units.begin(); unit!=units.end(); unit++)
+                    {
+                        if(get_nal_type(*unit)==7 || get_nal_type(*unit)==8)
+                            source_sets.push_back(*unit);
+                    }
+                }
+            }
+            av_free_packet(packet);
+            delete packet;
+            if(second > interval->end + eps)
+                break;
+            if(!key || second < interval->start - eps)
+                continue;
+            if(key_start < 0.0)
+                key_start = second;
+            else
+                key_end = second;
+        }
+        if(key_start < 0.0 || source_sets != encoder_sets)
+            continue;
+        double end = interval->end;
+        if(!to_end)
+        {
+            if(key_end < 0.0)
+                continue;
+            end = key_end;
+        }
+
+        SmartCopy copy;
+        copy.filename = filename;
+        copy.start = key_start;
+        copy.end = (to_end)?movie.duration + 1.0:key_end;
+        copy.first = (int64_t)floor((interval->absolute_start + key_start - interval->start) / fpsr + 0.5);
+        copy.count = (int64_t)floor((interval->absolute_start + end - interval->start) / fpsr + 0.5) - copy.first;
+        if(copy.count < min_frames)
+            continue;
+        res.push_back(copy);
+    }
+    sort(res.begin(), res.end(), _CompareSmartCopies);
+    if(h264 && !res.empty())
+        headers = join_nal_units(encoder_sets);
+    return res;
+}
+
+/* output stream gets the headers of the copied packets */
+static void set_extradata(AVCodecContext * c, const MemoryBlock & extradata)
+{
+    av_freep(&c->extradata);
+    c->extradata = (uint8_t *)av_mallocz(extradata.getSize() + FF_INPUT_BUFFER_PADDING_SIZE);
+    if(!c->extradata)
+    {
+        c->extradata_size = 0;
+        return;
+    }
+    memcpy(c->extradata, extradata.getData(), extradata.getSize());
+    c->extradata_size = extradata.getSize();
+}
+
+static vector<AudioPart> get_audio_parts(Timeline * timeline)
+{
+    vector<AudioPart> res;
+    for(vector<Timeline::Interval *>::iterator it = timeline->intervals.begin(); it!=timeline->intervals.end(); it++)
+    {
+        AudioPart part;
+        part.filename = (*it)->movie->filename;
+        part.start = (*it)->start;
+        part.end = (*it)->end;
+        part.absolute_start = (*it)->absolute_start;
+        res.push_back(part);
+    }
+    sort(res.begin(), res.end(), _CompareAudioParts);
+    return res;
+}
+
+/* Sound packets are copied only when every source has the codec, rate and
+   channels of the output and the parts follow each other without gaps,
+   which would have to be encoded. With global stream headers the sources
+   must have the same headers, they are returned in extradata */
+static bool plan_audio_passthrough(const vector<AudioPart> & parts, AVCodecContext * c, AVOutputFormat * fmt, double duration, MemoryBlock & extradata)
+{
+    bool global_header = fmt->flags & AVFMT_GLOBALHEADER;
+    double position = 0.0;
+    for(vector<AudioPart>::const_iterator it = parts.begin(); it!=parts.end(); it++)
+    {
+        if(fabs(it->absolute_start - position) > 0.001)
+            return false;
+        position = it->GetAbsoluteEnd();
+
+        AudioReader reader;
+        if(!reader.Open(it->filename, c->sample_rate, c->channels))
+            return false;
+        AVCodecContext * s = reader.GetCodec();
+        if(s->codec_id != c->codec_id || s->sample_rate != c->sample_rate || s->channels != c->channels)
+            return false;
+        MemoryBlock headers(s->extradata, s->extradata_size);
+        if(it==parts.begin())
+            extradata = headers;
+        else if(global_header && headers != extradata)
+            return false;
+    }
+    return !parts.empty() && fabs(position - duration) < 0.001;
+}
+
+/* copied segments and the encoded ones between them, time_base - of the
+   output codec, headers - parameter sets put before the copied keyframes */
+static void add_smart_segments(RenderSegments & segments, const vector<SmartCopy> & copies, int64_t frames, const Movie::Info & info, AVOutputFormat * fmt, RenderContext * rc, AVRational time_base, const MemoryBlock & headers)
+{
+    bool inband_headers = fmt->flags & AVFMT_GLOBALHEADER;
+    int64_t position = 0;
+    for(int i = 0; i<=(int)copies.size(); ++i)
+    {
+        bool tail = i==(int)copies.size();
+        if(!tail && copies[i].first < position)
+            continue;
+        int64_t end = (tail)?frames:copies[i].first;
+        if(end > position)
+        {
+            vector<int64_t> starts = split_into_segments(end - position, get_parts_count(info, fmt, rc, end - position), info.videos[0].gop);
+            for(int j = 0; j<(int)starts.size(); ++j)
+            {
+                int64_t first = position + starts[j];
+                int64_t count = (j + 1<(int)starts.size())?starts[j + 1] - starts[j]:end - first;
+                // the last segment goes up to the end of the timeline
+                if(tail && j + 1==(int)starts.size())
+                    count = -1;
+                RenderSegment * segment = new RenderSegment(first, count);
+                segment->inband_headers = inband_headers;
+                segments.list.push_back(segment);
+            }
+        }
+        if(tail)
+            break;
+        RenderSegment * segment = new RenderSegment(copies[i].first, copies[i].count);
+        segment->copy = true;
+        segment->copy_filename = copies[i].filename;
+        segment->copy_start = copies[i].start;
+        segment->copy_end = copies[i].end;
+        segment->copy_time_base = time_base;
+        segment->copy_headers = headers;
+        segments.list.push_back(segment);
+        position = copies[i].first + copies[i].count;
+    }
+}
+
+String _PrintUtilisation(RenderSegments & segments, RenderPipeline & pipeline, OutputWriter * writer)
+{
+    String res = segments.PrintUtilisation();
+    if(res.isNotEmpty())
+        res<<", ";
+    return res + pipeline.PrintUtilisation() + ", " + writer->PrintThroughput();
+}
+
+/* preallocated size of the output file, 0 when the quality is constant */
+static int64 estimate_output_size(const Movie::Info & info, double duration)
+{
+    int64 bit_rate = 0;
+    if(info.videos.size()>0)
+    {
+        if(!info.videos[0].is_bitrate_or_crf)
+            return 0;
+        bit_rate += (int64)info.videos[0].bit_rate * 1000;
+    }
+    if(info.audios.size()>0)
+        bit_rate += (int64)info.audios[0].bit_rate * 1000;
+    return (int64)(bit_rate * duration / 8.0);
+}
+
+class RenditionSource;
+
+// Gives the frames of the shared decoder to the renditions
+class FanOutStage : public RenderStage
+{
+private:
+    RenditionSource * source;
+
+public:
+    FanOutStage(RenditionSource * source):RenderStage("render fan out thread", LABEL_RENDER_STAGE_FAN_OUT)
+    {
+        this->source = source;
+    }
+    void run();
+};
+
+// Decodes the timeline once for the renditions of a job. Every decoded
+// frame is given to the pipelines of all renditions sharing the decoder,
+// the last one to scale it returns it to the pool. Renditions of two passes
+// or of another frame rate decode the timeline on their own
+class RenditionSource
+{
+private:
+    CriticalSection critical;
+    Timeline * source;
+    // copy of the timeline decoded for the renditions
+    Timeline * timeline;
+    vector<RenderPipeline*> consumers;
+    vector<bool> shared;
+    // shares the decoder, but has neither attached nor finished yet
+    vector<bool> waiting;
+    vector<double> progress;
+    vector<String> utilisation;
+    double fpsr;
+    bool started;
+
+    /* decoding starts when every rendition sharing it is attached or has
+       failed before. Called with critical held */
+    void StartIfReady()
+    {
+        if(started)
+            return;
+        bool attached = false;
+        for(int i = 0; i<(int)consumers.size(); ++i)
+        {
+            if(waiting[i])
+                return;
+            if(consumers[i])
+                attached = true;
+        }
+        started = true;
+        if(!attached)
+            return;
+        timeline->GotoSecondAndRead(0.0,false);
+        pipeline.AddStage(new DecodeStage(&pipeline, timeline, fpsr));
+        pipeline.AddStage(new FanOutStage(this));
+        pipeline.Start();
+    }
+
+public:
+    RenderPipeline pipeline;
+
+    RenditionSource(Timeline * source, const vector<Movie::Info> & infos)
+    {
+        this->source = source;
+        timeline = 0;
+        fpsr = 0.0;
+        started = false;
+        double fps = 0.0;
+        for(vector<Movie::Info>::const_iterator it = infos.begin(); it!=infos.end(); it++)
+        {
+            bool share = it->videos.size()>0 && it->videos[0].pass<=1 && (fps<=0.0 || fabs(it->videos[0].fps - fps) < 0.001);
+            if(share && fps<=0.0)
+                fps = it->videos[0].fps;
+            shared.push_back(share);
+            waiting.push_back(share);
+            consumers.push_back(0);
+            progress.push_back(0.0);
+            utilisation.push_back(String::empty);
+        }
+        pipeline.AllocDecodedFrames();
+    }
+    ~RenditionSource()
+    {
+        pipeline.Stop();
+        if(timeline)
+            delete timeline;
+    }
+    String Load(int threads)
+    {
+        timeline = source->CloneIntervals();
+        return load_movies(timeline, threads);
+    }
+    int GetCount()
+    {
+        return (int)shared.size();
+    }
+    bool IsShared(int rendition)
+    {
+        return shared[rendition];
+    }
+    // cores of the task are divided between the renditions
+    int GetThreads(task * t)
+    {
+        return jmax(1, get_task_cores(t) / GetCount());
+    }
+    // consumer - pipeline of the rendition without a decode stage
+    void Attach(int rendition, RenderPipeline * consumer, double fpsr)
+    {
+        const ScopedLock myScopedLock (critical);
+        if(!waiting[rendition])
+            return;
+        waiting[rendition] = false;
+        consumers[rendition] = consumer;
+        if(this->fpsr <= 0.0)
+            this->fpsr = fpsr;
+        StartIfReady();
+    }
+    // the rendition is finished or has failed, its frames go back to the pool
+    void Detach(int rendition)
+    {
+        RenderPipeline * consumer;
+        {
+            const ScopedLock myScopedLock (critical);
+            consumer = consumers[rendition];
+        }
+        // wakes up the fan out waiting for room in the queue of the rendition
+        if(consumer)
+            consumer->Stop();
+        {
+            const ScopedLock myScopedLock (critical);
+            consumers[rendition] = 0;
+            waiting[rendition] = false;
+            StartIfReady();
+        }
+        DecodedFrame * frame;
+        while(consumer && consumer->decoded.TakeRest(frame))
+            consumer->ReleaseDecoded(frame);
+    }
+    // false if there are no renditions left
+    bool Deliver(DecodedFrame * frame, RenderStage * stage)
+    {
+        const ScopedLock myScopedLock (critical);
+        int count = 0;
+        for(int i = 0; i<(int)consumers.size(); ++i)
+        {
+            if(consumers[i])
+                count++;
+        }
+        if(!count)
+        {
+            pipeline.decoded_free.Push(frame);
+            return false;
+        }
+        frame->owner = &pipeline;
+        frame->references = count;
+        for(int i = 0; i<(int)consumers.size(); ++i)
+        {
+            // the rendition is stopping, Detach takes it away
+            if(consumers[i] && !stage->Give(consumers[i]->decoded, frame))
+                pipeline.ReleaseDecoded(frame);
+        }
+        return true;
+    }
+    void CloseConsumers()
+    {
+        const ScopedLock myScopedLock (critical);
+        for(int i = 0; i<(int)consumers.size(); ++i)
+        {
+            if(consumers[i])
+                consumers[i]->decoded.Close();
+        }
+    }
+    void SetProgress(int rendition, double value)
+    {
+        const ScopedLock myScopedLock (critical);
+        progress[rendition] = value;
+    }
+    void SetUtilisation(int rendition, const String & text)
+    {
+        const ScopedLock myScopedLock (critical);
+        utilisation[rendition] = text;
+    }
+    double GetProgress()
+    {
+        const ScopedLock myScopedLock (critical);
+        double res = 0.0;
+        for(int i = 0; i<(int)progress.size(); ++i)
+            res += progress[i];
+        return res / jmax(1, (int)progress.size());
+    }
+    String PrintUtilisation()
+    {
+        const ScopedLock myScopedLock (critical);
+        String res = pipeline.PrintUtilisation();
+        for(int i = 0; i<(int)utilisation.size(); ++i)
+        {
+            if(utilisation[i].isNotEmpty())
+                res<<" | "<<(i + 1)<<": "<<utilisation[i];
+        }
+        return res;
+    }
+};
+
+void FanOutStage::run()
+{
+    Begin();
+    DecodedFrame * frame;
+    while(Take(source->pipeline.decoded, frame))
+    {
+        if(!source->Deliver(frame, this))
+            break;
+        frames++;
+    }
+    source->CloseConsumers();
+    End();
+}
+
+// Takes the rendition away from the shared decoder before its pipeline is destroyed
+class RenditionDetach
+{
+private:
+    RenditionSource * source;
+    int rendition;
+
+public:
+    RenditionDetach(RenditionSource * source, int rendition)
+    {
+        this->source = source;
+        this->rendition = rendition;
+    }
+    ~RenditionDetach()
+    {
+        if(source)
+            source->Detach(rendition);
+    }
+};
+
+// Renders one rendition of the job
+class RenditionThread : public Thread
+{
+private:
+    Timeline * timeline;
+    Movie::Info info;
+    task * t;
+    RenditionSource * source;
+    int rendition;
+
+public:
+    String result;
+    RenditionThread(Timeline * timeline, const Movie::Info & info, task * t, RenditionSource * source, int rendition):Thread("render rendition thread"),info(info)
+    {
+        this->timeline = timeline;
+        this->t = t;
+        this->source = source;
+        this->rendition = rendition;
+    }
+    void run()
+    {
+        result = timeline->RenderOutput(info, this, 0, t, source, rendition);
+        // a rendition which failed before attaching does not hold the others
+        source->Detach(rendition);
+    }
+};
+
+/* pictures and samples are written as they are for an encoder outside of
+   the editor. The stream can't be taken back, so a suspended render only
+   pauses its pipeline and a stopped one starts again from the beginning */
+static String render_raw(Timeline * timeline, const Movie::Info & info, Thread * thread, void (* reportProgress)(task*,double), task* t, RenditionSource * source, int rendition)
+{
+    bool shared = source && source->IsShared(rendition);
+    RenderContext rc;
+    RenderTelemetry telemetry;
+    RawOutput video_output;
+    RenderPipeline pipeline;
+    RenditionDetach detach((shared)?source:0, rendition);
+    RawVideoStage * video_stage = 0;
+    RawAudioStage * audio_stage = 0;
+
+    if(info.videos.size()>0)
+    {
+        const Movie::VideoInfo & video = info.videos[0];
+        // planes of 4:2:0 need the even size
+        int width = video.width & ~1;
+        int height = video.height & ~1;
+        AVRational fps = av_d2q(video.fps, 65535);
+        if(width<=0 || height<=0 || fps.num<=0 || fps.den<=0)
+            return "Invalid output format parameters";
+        rc.fpsr = (double)fps.den / (double)fps.num;
+        rc.scale_flags = GetScaleFlags(video.scale_quality);
+        if(!shared)
+            timeline->GotoSecondAndRead(0.0,false);
+        if(!pipeline.AllocFrames(width, height, PIX_FMT_YUV420P))
+            return LABEL_SAVE_VIDEO_ERROR_ENCODING_ALLOC_PICTURE;
+        if(!shared)
+            pipeline.AddStage(new DecodeStage(&pipeline, timeline, rc.fpsr));
+        pipeline.AddStage(new ScaleStage(&pipeline, width, height, PIX_FMT_YUV420P, &rc));
+        video_stage = new RawVideoStage(&pipeline, &video_output, info.filename, GetY4mHeader(width, height, fps), width, height);
+        pipeline.AddStage(video_stage);
+    }
+    String audio_filename = GetRawAudioFilename(info);
+    if(info.audios.size()>0 && audio_filename.isNotEmpty())
+    {
+        const Movie::AudioInfo & audio = info.audios[0];
+        if(!pipeline.audio.Allocate(audio.sample_rate * audio.channels * RENDER_AUDIO_BUFFER))
+            return LABEL_SAVE_VIDEO_ERROR_MEMORY;
+        pipeline.AddStage(new AudioDecodeStage(&pipeline, get_audio_parts(timeline), timeline->duration, audio.sample_rate, audio.channels));
+        audio_stage = new RawAudioStage(&pipeline, audio_filename, audio.sample_rate, audio.channels);
+        pipeline.AddStage(audio_stage);
+    }
+    if(!video_stage && !audio_stage)
+        return "Invalid output format parameters";
+    pipeline.Start();
+    if(shared && video_stage)
+        source->Attach(rendition, &pipeline, rc.fpsr);
+    telemetry.BeginPass(1);
+
+    while(pipeline.IsRunning())
+    {
+        if(thread && thread->threadShouldExit())
+        {
+            pipeline.Stop();
+            return LABEL_SAVE_VIDEO_SUSPENDED;
+        }
+        pipeline.paused = t && t->state == task::Suspended;
+
+        int64_t frames = (video_stage)?video_stage->frames:0;
+        telemetry.SetProgress(frames, video_output.GetBytesWritten());
+        if(t && !source)
+            ReportTaskFrames(t, frames, video_output.GetBytesWritten());
+        pipeline.SampleQueues(telemetry);
+        if((reportProgress || source) && t && video_stage && timeline->duration > 0.0)
+        {
+            double progress = (double)frames * rc.fpsr / timeline->duration;
+            if(source)
+                source->SetProgress(rendition, progress);
+            else
+                reportProgress(t, progress);
+        }
+        if(t)
+        {
+            String utilisation = telemetry.Print() + ", " + pipeline.PrintUtilisation();
+            if(source)
+                source->SetUtilisation(rendition, utilisation);
+            else
+                ReportTaskUtilisation(t, utilisation);
+        }
+        Thread::sleep(100);
+    }
+    pipeline.Stop();
+    String pipeline_error = pipeline.GetError();
+    if(pipeline_error.isNotEmpty())
+        return pipeline_error;
+    pipeline.ReportStages(telemetry);
+    telemetry.EndPass();
+    return String::empty;
+}
+
+String Timeline::RenderRenditions(const vector<Movie::Info> & infos, Thread * thread, void (* reportProgress)(task*,double), task* t)
+{
+    RenditionSource source(this, infos);
+    String error = source.Load(get_task_cores(t));
+    if(error.isNotEmpty())
+        return error;
+
+    // renditions which decode on their own get their own copies of the timeline
+    OwnedArray<Timeline> timelines;
+    OwnedArray<RenditionThread> threads;
+    for(int i = 0; i<(int)infos.size(); ++i)
+    {
+        Timeline * timeline = this;
+        if(!source.IsShared(i))
+        {
+            timeline = CloneIntervals();
+            timelines.add(timeline);
+            error = load_movies(timeline, source.GetThreads(t));
+            if(error.isNotEmpty())
+                return error;
+        }
+        threads.add(new RenditionThread(timeline, infos[i], t, &source, i));
+    }
+    for(int i = 0; i<threads.size(); ++i)
+        threads[i]->startThread(THREAD_PRIORITY_ENCODE);
+
+    bool stopped = false;
+    for(;;)
+    {
+        bool running = false;
+        for(int i = 0; i<threads.size(); ++i)
+        {
+            if(threads[i]->isThreadRunning())
+                running = true;
+        }
+        if(!running)
+            break;
+        if(!stopped && thread && thread->threadShouldExit())
+        {
+            for(int i = 0; i<threads.size(); ++i)
+                threads[i]->signalThreadShouldExit();
+            stopped = true;
+        }
+        if(reportProgress && t)
+            reportProgress(t, source.GetProgress());
+        if(t)
+            ReportTaskUtilisation(t, source.PrintUtilisation());
+        Thread::sleep(100);
+    }
+    if(stopped)
+        return LABEL_SAVE_VIDEO_SUSPENDED;
+    for(int i = 0; i<threads.size(); ++i)
+    {
+        if(threads[i]->result.isNotEmpty())
+            return infos[i].filename + ": " + threads[i]->result;
+    }
+    return String::empty;
+}
+
+String Timeline::Render(const Movie::Info & info, Thread * thread, void (* reportProgress)(task*,double),task* t)
+{
+    return RenderOutput(info, thread, reportProgress, t, 0, 0);
+}
+
+String Timeline::RenderOutput(const Movie::Info & info, Thread * thread, void (* reportProgress)(task*,double), task* t, RenditionSource * source, int rendition)
+{
+    if(IsRawOutput(info))
+        return render_raw(this, info, thread, reportProgress, t, source, rendition);
+    bool shared = source && source->IsShared(rendition);
 
     bool video_enabled = info.videos.size()>0;
     RenderContext rc,*rcp = &rc;
@@ -1317,18 +4079,37 @@ String Timeline::Render(const Movie::Info & info, Thread * thread, void (* repor
     rcp->srcH = 0;
     rcp->dstW = 0;
     rcp->dstH = 0;
+    rcp->geometry = 0;
 
-    rcp->pass_info=String::empty;
+    rcp->pass_stats = 0;
+    rcp->frame_cache = 0;
+    TwoPassStats pass_stats;
+    FrameCache frame_cache;
     rcp->is_codec_x264 = false;
+    rcp->inband_headers = false;
     rcp->error = false;
 
 
     rcp->all_pass = (video_enabled)?info.videos[0].pass:1;
+    rcp->preset = 0;
+    PresetTuner tuner;
+    RenderTelemetry telemetry;
+    FrameArena::PeakWatch memory_watch(GetFrameArena());
+    if(video_enabled && info.videos[0].deadline>0 && info.videos[0].codec_short == "libx264" && !source)
+        tuner.Start(info.videos[0].deadline);
     for(rcp->current_pass=1; rcp->current_pass<=rcp->all_pass; ++rcp->current_pass)
     {
         CloseRender deleter;
 
         bool audio_enabled = info.audios.size()>0 && rcp->all_pass==rcp->current_pass;
+        bool first_of_two = rcp->all_pass>1 && rcp->current_pass==1;
+        rcp->frame_cache = 0;
+        if(first_of_two)
+        {
+            if(!pass_stats.StartWriting())
+                return LABEL_SAVE_VIDEO_ERROR_PASS_STATS;
+            rcp->pass_stats = &pass_stats;
+        }
 
         rcp->pts = 1;
 
@@ -1336,9 +4117,6 @@ String Timeline::Render(const Movie::Info & info, Thread * thread, void (* repor
         AVOutputFormat *fmt;
 
 
-        double audio_pts, video_pts;
-        int i;
-
         const char * c_string_filename = info.filename.toCString();
         fmt = av_guess_format(info.format_short.toCString(), NULL, NULL);
         if (!fmt)
@@ -1355,16 +4133,32 @@ String Timeline::Render(const Movie::Info & info, Thread * thread, void (* repor
         snprintf(deleter.oc->filename, sizeof(deleter.oc->filename), "%s", c_string_filename);
         deleter.video_st = NULL;
         deleter.audio_st = NULL;
+        if (video_enabled && tuner.IsEnabled() && rcp->current_pass==1)
+        {
+            if(t)
+                ReportTaskUtilisation(t, LABEL_RENDER_STAGE_CALIBRATION);
+            int64_t frames = 0;
+            int cores = get_task_cores(t);
+            int segments_count = get_segments_count(info, fmt, rcp, (int64_t)(duration * info.videos[0].fps));
+            // without the measures the preset of the settings is used
+            if(!calibrate_presets(this, info, fmt, rcp, duration, cores, segments_count, tuner, frames))
+                rcp->preset = 0;
+            if(thread && thread->threadShouldExit())
+                return LABEL_SAVE_VIDEO_SUSPENDED;
+        }
         if (video_enabled)
         {
-            GotoSecondAndRead(0.0,false);
+            // the timeline of the shared decoder is read by the other renditions
+            if(!shared)
+                GotoSecondAndRead(0.0,false);
+            rcp->threads = (source)?source->GetThreads(t):get_task_cores(t);
             deleter.video_st = add_video_stream(deleter.oc, info, rcp);
             if(rcp->error)
                 return rcp->errorText;
         }
         if (fmt->audio_codec != CODEC_ID_NONE && audio_enabled)
         {
-            deleter.audio_st = add_audio_stream(deleter.oc, fmt->audio_codec, info, rcp);
+            deleter.audio_st = add_audio_stream(deleter.oc, fmt, info, rcp);
             if(rcp->error)
                 return rcp->errorText;
         }
@@ -1386,7 +4180,33 @@ String Timeline::Render(const Movie::Info & info, Thread * thread, void (* repor
                 return rcp->errorText;
         }
 
-        File f(info.filename);
+        int64_t frames = (deleter.video_st)?(int64_t)(duration / rcp->fpsr):0;
+        if(first_of_two && info.videos[0].pass_cache)
+        {
+            AVCodecContext * c = deleter.video_st->codec;
+            if(FrameCache::HasRoom(frames, c->width, c->height) && frame_cache.StartWriting(c->width, c->height))
+                rcp->frame_cache = &frame_cache;
+        }
+        vector<SmartCopy> copies;
+        MemoryBlock copy_headers;
+        // the output keeps the headers of its encoder, the copied sources have the same
+        if(deleter.video_st && info.videos[0].smart_render && rcp->all_pass==1 && !(fmt->flags & AVFMT_RAWPICTURE) && !source)
+            copies = plan_smart_render(this, deleter.video_st->codec, rcp->fpsr, copy_headers);
+        vector<AudioPart> audio_parts;
+        bool audio_passthrough = false;
+        if(deleter.audio_st)
+        {
+            MemoryBlock extradata;
+            audio_parts = get_audio_parts(this);
+            audio_passthrough = plan_audio_passthrough(audio_parts, deleter.audio_st->codec, fmt, duration, extradata);
+            if(audio_passthrough && (fmt->flags & AVFMT_GLOBALHEADER))
+                set_extradata(deleter.audio_st->codec, extradata);
+        }
+
+        // the segmented export writes its first chunk, the last pass cuts the next ones
+        bool chunked = deleter.video_st && rcp->chunk_frames>0;
+        bool cut = chunked && rcp->current_pass==rcp->all_pass;
+        File f((chunked)?GetChunkFile(info.filename, 0):File(info.filename));
         if(f.exists())
         {
             if(!f.deleteFile())
@@ -1402,8 +4222,15 @@ String Timeline::Render(const Movie::Info & info, Thread * thread, void (* repor
 
 
 
-        deleter.fs = f.createOutputStream();
+        deleter.writer = new OutputWriter();
+        // the first chunk of the segmented export holds one chunk of the movie
+        double estimated_duration = (chunked)?jmin(duration, (double)info.videos[0].chunk_duration):duration;
+        if(!deleter.writer->Open(f, RENDER_OUTPUT_DIRECT, estimate_output_size(info, estimated_duration)))
+            return LABEL_SAVE_VIDEO_ERROR_WRITTING;
         int lSize = 32768;
+        ChunkWriter chunks(&deleter, info.filename, lSize, rcp->chunk_frames, rcp->fpsr);
+        if(cut && !chunks.Open())
+            return LABEL_SAVE_VIDEO_ERROR_WRITTING;
         try
         {
             deleter.ByteIOCtx = new ByteIOContext();
@@ -1424,7 +4251,7 @@ String Timeline::Render(const Movie::Info & info, Thread * thread, void (* repor
             return LABEL_SAVE_VIDEO_ERROR_MEMORY;
         }
 
-        init_put_byte(deleter.ByteIOCtx, deleter.pDataBuffer, lSize, 1, deleter.fs, NULL, _WritePacket, _SeekWithOutputStream);
+        init_put_byte(deleter.ByteIOCtx, deleter.pDataBuffer, lSize, 1, deleter.writer, NULL, _WritePacket, _SeekWithOutputStream);
         deleter.oc->pb = deleter.ByteIOCtx;
 
         if(av_write_header(deleter.oc))
@@ -1432,74 +4259,189 @@ String Timeline::Render(const Movie::Info & info, Thread * thread, void (* repor
             return LABEL_SAVE_VIDEO_ERROR_HEADER;
         }
 
-        for(;;)
+        // segments are stopped after the stitch stage which reads them
+        RenderSegments segments;
+        RenderPipeline pipeline;
+        RenditionDetach detach((shared)?source:0, rendition);
+        EncodeStage * encode_stage = 0;
+        // renditions are not split, the other renditions take the cores
+        int parts_count = (source)?1:get_parts_count(info, fmt, rcp, frames);
+        if(!copies.empty())
+            add_smart_segments(segments, copies, frames, info, fmt, rcp, deleter.video_st->codec->time_base, copy_headers);
+        else if(parts_count>1)
         {
-            if(thread && thread->threadShouldExit())
-                return LABEL_SAVE_VIDEO_SUSPENDED;
-
-            if(t && t->state == task::Suspended)
+            segments.parallel = get_segments_count(info, fmt, rcp, frames);
+            vector<int64_t> starts = split_into_segments(frames, parts_count, info.videos[0].gop);
+            for(int i = 0; i<(int)starts.size(); ++i)
             {
-                Thread::getCurrentThread()->sleep(1000);
-                continue;
+                int64_t count = (i + 1<(int)starts.size())?starts[i + 1] - starts[i]:-1;
+                RenderSegment * segment = new RenderSegment(starts[i], count);
+                // segments of different presets can't share the stream headers
+                segment->inband_headers = tuner.IsEnabled() && (fmt->flags & AVFMT_GLOBALHEADER);
+                segments.list.push_back(segment);
+            }
+        }
+        segments.preset = rcp->preset;
+        RenderCheckpoint checkpoint;
+#if RENDER_CHECKPOINT
+        if(!segments.list.empty())
+        {
+            // without the checkpoint the segments are rendered to the temporary files
+            if(checkpoint.Open(File(info.filename), get_checkpoint_signature(this, info)))
+                segments.Restore(checkpoint);
+            int64_t restored = segments.GetRestoredFrames();
+            if(restored>0 && tuner.IsEnabled() && rcp->preset>0)
+                segments.preset = tuner.ChoosePreset(jmax((int64_t)0, frames - restored), 1);
+        }
+#endif
+        if(!segments.list.empty())
+        {
+            String segment_error = segments.StartNext(this, info, fmt, get_task_cores(t));
+            if(segment_error.isNotEmpty())
+                return segment_error;
+            pipeline.AddStage(new StitchStage(&pipeline, segments.list, deleter.video_st));
+        }
+        else if(deleter.video_st)
+        {
+            if(!pipeline.AllocFrames(deleter.video_st->codec))
+                return LABEL_SAVE_VIDEO_ERROR_ENCODING_ALLOC_PICTURE;
+            encode_stage = new EncodeStage(&pipeline, deleter.oc, deleter.video_st, rcp);
+            if(rcp->all_pass>1 && rcp->current_pass==2 && frame_cache.StartReading())
+                pipeline.AddStage(new CacheStage(&pipeline, &frame_cache));
+            else
+            {
+                if(!shared)
+                    pipeline.AddStage(new DecodeStage(&pipeline, this, rcp->fpsr));
+                pipeline.AddStage(new ScaleStage(&pipeline, deleter.video_st->codec, rcp));
             }
+            pipeline.AddStage(encode_stage);
+        }
+        else
+            pipeline.packets.Close();
+        if(deleter.audio_st)
+        {
+            AVCodecContext * audio_codec = deleter.audio_st->codec;
+            if(!pipeline.audio.Allocate(audio_codec->sample_rate * audio_codec->channels * RENDER_AUDIO_BUFFER))
+                return LABEL_SAVE_VIDEO_ERROR_MEMORY;
+            pipeline.AddStage(new AudioDecodeStage(&pipeline, audio_parts, duration, deleter.audio_st, audio_passthrough));
+        }
+        pipeline.AddStage(new MuxStage(&pipeline, deleter.oc, deleter.video_st, deleter.audio_st, audio_passthrough, info, this, rcp, (cut)?&chunks:0));
+        pipeline.Start();
+        if(shared && encode_stage)
+            source->Attach(rendition, &pipeline, rcp->fpsr);
+        telemetry.BeginPass(rcp->current_pass);
 
-            if(reportProgress && t && rcp->pts % 10 == 0)
+        while(pipeline.IsRunning())
+        {
+            if(thread && thread->threadShouldExit())
             {
-                double pos = ((double)rcp->pts * (double)deleter.video_st->r_frame_rate.num / (double)deleter.video_st->r_frame_rate.den);
-                if(rcp->all_pass==1)
-                    reportProgress(t, pos / duration);
-                else if(rcp->current_pass==2)
-                    reportProgress(t, (pos + duration) / (2.0 * duration));
-                else
-                    reportProgress(t, (pos) / (2.0 * duration));
+                pipeline.Stop();
+                segments.Checkpoint(checkpoint);
+                return LABEL_SAVE_VIDEO_SUSPENDED;
+            }
+            // suspended render with a checkpoint releases everything, the
+            // task starts it again from the checkpoint when it is resumed
+            if(t && t->state == task::Suspended && checkpoint.IsEnabled())
+            {
+                segments.Drain(thread);
+                pipeline.Stop();
+                segments.Checkpoint(checkpoint);
+                return LABEL_SAVE_VIDEO_SUSPENDED;
             }
 
+            pipeline.paused = t && t->state == task::Suspended;
+            segments.SetPaused(pipeline.paused);
 
-            /* compute current audio and video time */
-            if (deleter.audio_st)
-                audio_pts = (double)deleter.audio_st->pts.val * deleter.audio_st->time_base.num / deleter.audio_st->time_base.den;
-            else
-                audio_pts = 0.0;
+            if(tuner.IsEnabled() && rcp->preset>0 && !segments.list.empty())
+                segments.preset = tuner.Update(segments.GetEncodedFrames() - segments.GetRestoredFrames());
+            segments.Checkpoint(checkpoint);
 
-            if (deleter.video_st)
-                video_pts = (double)deleter.video_st->pts.val * deleter.video_st->time_base.num / deleter.video_st->time_base.den;
-            else
-                video_pts = 0.0;
+            // cores are taken again, the scheduler changes them as other tasks start and stop
+            String segments_error = segments.StartNext(this, info, fmt, get_task_cores(t));
+            if(segments_error.isEmpty())
+                segments_error = segments.GetError();
+            if(segments_error.isNotEmpty())
+            {
+                pipeline.Stop();
+                return segments_error;
+            }
 
-            /*if ((!audio_st || audio_pts >= STREAM_DURATION) &&
-                (!video_st || video_pts >= STREAM_DURATION))
-                break;*/
-            if(rcp->end_writing)
-                break;
+            int64_t encoded = (encode_stage)?encode_stage->frames:segments.GetEncodedFrames();
+            telemetry.SetProgress(encoded, deleter.writer->GetBytesWritten());
+            if(t && !source)
+                ReportTaskFrames(t, encoded, deleter.writer->GetBytesWritten());
+            if(segments.list.empty())
+                pipeline.SampleQueues(telemetry);
+            else
+                segments.SampleQueues(telemetry);
 
-            /* write interleaved audio and video frames */
-            if (!deleter.video_st || (deleter.video_st && deleter.audio_st && audio_pts < video_pts))
+            if((reportProgress || source) && t && (encode_stage || !segments.list.empty()))
             {
-
-                write_audio_frame(deleter.oc, deleter.audio_st,info,this, rcp);
-                if(rcp->error)
-                {
-                    return rcp->errorText;
-                }
+                double pos = (double)encoded * rcp->fpsr;
+                double progress = pos / duration;
+                if(rcp->current_pass==2)
+                    progress = (pos + duration) / (2.0 * duration);
+                else if(rcp->all_pass>1)
+                    progress = (pos) / (2.0 * duration);
+                if(source)
+                    source->SetProgress(rendition, progress);
+                else
+                    reportProgress(t, progress);
             }
-            else
+            if(t)
             {
-                write_video_frame(deleter.oc, deleter.video_st,info,this, rcp);
-                if(rcp->error)
-                {
-                    return rcp->errorText;
-                }
+                String utilisation = telemetry.Print() + ", " + _PrintUtilisation(segments, pipeline, deleter.writer);
+                if(tuner.IsEnabled() && rcp->preset>0)
+                    utilisation = tuner.Print() + ", " + utilisation;
+                if(source)
+                    source->SetUtilisation(rendition, utilisation);
+                else
+                    ReportTaskUtilisation(t, utilisation);
             }
+
+            Thread::sleep(100);
         }
+        pipeline.Stop();
+        segments.Checkpoint(checkpoint);
+        String pipeline_error = pipeline.GetError();
+        if(pipeline_error.isNotEmpty())
+            return pipeline_error;
 
         if(av_write_trailer(deleter.oc))
         {
             return LABEL_SAVE_VIDEO_ERROR_TRAILER;
         }
+        if(!deleter.writer->Close())
+            return LABEL_SAVE_VIDEO_ERROR_WRITTING;
+        if(cut && !chunks.Finish(duration))
+            return LABEL_SAVE_VIDEO_ERROR_WRITTING;
+        checkpoint.Remove();
+        pipeline.ReportStages(telemetry);
+        segments.ReportStages(telemetry);
+        telemetry.AddStage("output", LABEL_RENDER_STAGE_OUTPUT, deleter.writer->GetWriteMillis(), deleter.writer->GetRunningMillis(), 0);
+        telemetry.SetProgress((encode_stage)?encode_stage->frames:segments.GetEncodedFrames(), deleter.writer->GetBytesWritten());
+        telemetry.EndPass();
+        if(source)
+            source->SetUtilisation(rendition, telemetry.Print() + ", " + _PrintUtilisation(segments, pipeline, deleter.writer));
+        else if(t)
+            ReportTaskUtilisation(t, telemetry.Print() + ", " + _PrintUtilisation(segments, pipeline, deleter.writer));
+        if(first_of_two)
+        {
+            if(!pass_stats.FinishWriting())
+                return LABEL_SAVE_VIDEO_ERROR_PASS_STATS;
+            // without the cache the second pass decodes the timeline again
+            frame_cache.FinishWriting();
+        }
 
 
         rcp->Dispose();
     }
+#if RENDER_REPORT
+    /* the report is not worth failing the finished render */
+    File output(info.filename);
+    telemetry.SetMemoryPeak(memory_watch.GetPeak());
+    telemetry.WriteReport(output.getParentDirectory().getChildFile(output.getFileNameWithoutExtension() + ".render.json"), info.filename);
+#endif
     return String::empty;
 }
 
@@ -0,0 +1,374 @@
+#include "config.h"
+#include "audioSource.h"
+#include "frameArena.h"
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AUDIO_SOURCE_SSE2
+#endif
+
+int _ReadPacket(void* cookie, uint8_t* buffer, int bufferSize);
+int64_t _Seek(void* cookie, int64_t offset, int whence);
+
+void ConvertFloatToS16(const float * src, int16_t * dst, int count)
+{
+    int i = 0;
+#ifdef AUDIO_SOURCE_SSE2
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+    const __m128 max = _mm_set1_ps(32767.0f);
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), min), max);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), min), max);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+#endif
+    for(; i < count; ++i)
+    {
+        float v = jlimit(-32768.0f, 32767.0f, src[i] * 32768.0f);
+        dst[i] = (int16_t)floorf(v + 0.5f);
+    }
+}
+
+void RemixS16(const int16_t * src, int src_channels, int16_t * dst, int dst_channels, int frames)
+{
+    for(int i = 0; i<frames; ++i, src += src_channels, dst += dst_channels)
+    {
+        if(dst_channels == 1)
+        {
+            int sum = 0;
+            for(int j = 0; j<src_channels; ++j)
+                sum += src[j];
+            dst[0] = (int16_t)(sum / src_channels);
+        }
+        else if(src_channels == 1)
+        {
+            for(int j = 0; j<dst_channels; ++j)
+                dst[j] = src[0];
+        }
+        else if(src_channels >= 6 && dst_channels == 2)
+        {
+            /* front left, front right, center, low frequency, back left, back right */
+            int center = src[2] * 181 / 256;
+            dst[0] = (int16_t)jlimit(-32768, 32767, src[0] + center + src[4] * 181 / 256);
+            dst[1] = (int16_t)jlimit(-32768, 32767, src[1] + center + src[5] * 181 / 256);
+        }
+        else
+        {
+            for(int j = 0; j<dst_channels; ++j)
+                dst[j] = (j<src_channels)?src[j]:0;
+        }
+    }
+}
+
+static bool _Reserve(int16_t *& buffer, int & size, int samples)
+{
+    if(size >= samples)
+        return true;
+    GetFrameArena().Free(buffer);
+    buffer = (int16_t *)GetFrameArena().Alloc(samples * sizeof(int16_t));
+    size = (buffer)?samples:0;
+    return buffer != 0;
+}
+
+AudioReader::AudioReader()
+{
+    fs = 0;
+    pDataBuffer = 0;
+    ByteIOCtx = 0;
+    pFormatCtx = 0;
+    pCodecCtx = 0;
+    codec_opened = false;
+    audioStream = -1;
+    resample = 0;
+    has_packet = false;
+    pending.size = 0;
+    decoded = 0;
+    converted = 0;
+    converted_size = 0;
+    remixed = 0;
+    remixed_size = 0;
+    resampled = 0;
+    resampled_size = 0;
+    next_second = 0.0;
+}
+
+AudioReader::~AudioReader()
+{
+    Close();
+}
+
+bool AudioReader::Open(const String & filename, int out_rate, int out_channels)
+{
+    Close();
+    this->filename = filename;
+    this->out_rate = out_rate;
+    this->out_channels = out_channels;
+
+    File f(filename);
+    if(!f.existsAsFile())
+        return false;
+    fs = f.createInputStream();
+    if(!fs)
+        return false;
+    pDataBuffer = new unsigned char[lSize];
+    fs->read(pDataBuffer,lSize);
+    fs->setPosition(0);
+
+    AVProbeData probeData;
+    probeData.buf = pDataBuffer;
+    probeData.buf_size = lSize;
+    probeData.filename = "";
+    AVInputFormat* pAVInputFormat = av_probe_input_format(&probeData,1);
+    if(!pAVInputFormat)
+        return false;
+
+    ByteIOCtx = new ByteIOContext();
+    if(init_put_byte(ByteIOCtx, pDataBuffer, lSize, 0, fs, _ReadPacket, NULL, _Seek) < 0)
+        return false;
+    if(av_open_input_stream(&pFormatCtx, ByteIOCtx, "", pAVInputFormat, NULL) < 0)
+    {
+        pFormatCtx = 0;
+        return false;
+    }
+    if(av_find_stream_info(pFormatCtx)<0)
+        return false;
+
+    for(unsigned int i=0; i<pFormatCtx->nb_streams; i++)
+        if(pFormatCtx->streams[i]->codec->codec_type==CODEC_TYPE_AUDIO)
+        {
+            audioStream=i;
+            break;
+        }
+    if(audioStream==-1)
+        return false;
+
+    pCodecCtx = pFormatCtx->streams[audioStream]->codec;
+    if(pCodecCtx->channels<=0 || pCodecCtx->sample_rate<=0)
+        return false;
+    AVCodec * pCodec = avcodec_find_decoder(pCodecCtx->codec_id);
+    if(!pCodec)
+        return false;
+    {
+        const ScopedLock myScopedLock (avcodec_critical);
+        if(avcodec_open(pCodecCtx, pCodec)<0)
+            return false;
+        codec_opened = true;
+    }
+
+    decoded = (int16_t *)GetFrameArena().Alloc(AVCODEC_MAX_AUDIO_FRAME_SIZE);
+    if(!decoded)
+        return false;
+    /* channels are remixed before, so the resampler gets the output layout */
+    if(pCodecCtx->sample_rate != out_rate)
+    {
+        resample = av_audio_resample_init(out_channels, out_channels, out_rate, pCodecCtx->sample_rate, AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S16, 16, 10, 0, 0.8);
+        if(!resample)
+            return false;
+    }
+    next_second = 0.0;
+    return true;
+}
+
+void AudioReader::FreePacket()
+{
+    if(has_packet)
+        av_free_packet(&packet);
+    has_packet = false;
+    pending.size = 0;
+}
+
+void AudioReader::Close()
+{
+    FreePacket();
+    if(resample)
+        audio_resample_close(resample);
+    resample = 0;
+    {
+        const ScopedLock myScopedLock (avcodec_critical);
+        if(codec_opened)
+            avcodec_close(pCodecCtx);
+        codec_opened = false;
+        if(pFormatCtx)
+            av_close_input_stream(pFormatCtx);
+        pFormatCtx = 0;
+    }
+    pCodecCtx = 0;
+    audioStream = -1;
+    if(ByteIOCtx)
+        delete ByteIOCtx;
+    ByteIOCtx = 0;
+    if(pDataBuffer)
+        delete [] pDataBuffer;
+    pDataBuffer = 0;
+    if(fs)
+        delete fs;
+    fs = 0;
+
+    GetFrameArena().Free(decoded);
+    decoded = 0;
+    GetFrameArena().Free(converted);
+    converted = 0;
+    converted_size = 0;
+    GetFrameArena().Free(remixed);
+    remixed = 0;
+    remixed_size = 0;
+    GetFrameArena().Free(resampled);
+    resampled = 0;
+    resampled_size = 0;
+}
+
+bool AudioReader::IsOpened()
+{
+    return decoded != 0;
+}
+
+AVCodecContext * AudioReader::GetCodec()
+{
+    return (IsOpened())?pCodecCtx:0;
+}
+
+double AudioReader::ToSeconds(int64_t timestamp)
+{
+    AVStream * st = pFormatCtx->streams[audioStream];
+    if(st->start_time != AV_NOPTS_VALUE)
+        timestamp -= st->start_time;
+    return (double)timestamp * st->time_base.num / st->time_base.den;
+}
+
+bool AudioReader::Seek(double second)
+{
+    if(!IsOpened())
+        return false;
+    FreePacket();
+    AVStream * st = pFormatCtx->streams[audioStream];
+    int64_t timestamp = (int64_t)(second * st->time_base.den / st->time_base.num);
+    if(st->start_time != AV_NOPTS_VALUE)
+        timestamp += st->start_time;
+    int res = av_seek_frame(pFormatCtx, audioStream, timestamp, AVSEEK_FLAG_BACKWARD);
+    avcodec_flush_buffers(pCodecCtx);
+    // corrected by the timestamp of the next packet
+    next_second = second;
+    return res>=0;
+}
+
+int AudioReader::Convert(int bytes, int16_t ** samples)
+{
+    int channels = pCodecCtx->channels;
+    int count = bytes / (av_get_bits_per_sample_format(pCodecCtx->sample_fmt) / 8);
+    int frames = count / channels;
+    const int16_t * res = decoded;
+
+    if(pCodecCtx->sample_fmt != AV_SAMPLE_FMT_S16)
+    {
+        if(!_Reserve(converted, converted_size, count))
+            return -1;
+        switch(pCodecCtx->sample_fmt)
+        {
+        case AV_SAMPLE_FMT_U8:
+            for(int i = 0; i<count; ++i)
+                converted[i] = (int16_t)((((const uint8_t *)decoded)[i] - 128) << 8);
+            break;
+        case AV_SAMPLE_FMT_S32:
+            for(int i = 0; i<count; ++i)
+                converted[i] = (int16_t)(((const int32_t *)decoded)[i] >> 16);
+            break;
+        case AV_SAMPLE_FMT_FLT:
+            ConvertFloatToS16((const float *)decoded, converted, count);
+            break;
+        case AV_SAMPLE_FMT_DBL:
+            for(int i = 0; i<count; ++i)
+                converted[i] = (int16_t)floor(jlimit(-32768.0, 32767.0, ((const double *)decoded)[i] * 32768.0) + 0.5);
+            break;
+        default:
+            return -1;
+        }
+        res = converted;
+    }
+
+    if(channels != out_channels)
+    {
+        if(!_Reserve(remixed, remixed_size, frames * out_channels))
+            return -1;
+        RemixS16(res, channels, remixed, out_channels, frames);
+        res = remixed;
+    }
+
+    if(resample)
+    {
+        int max_frames = (int)((int64_t)frames * out_rate / pCodecCtx->sample_rate) + 32;
+        if(!_Reserve(resampled, resampled_size, max_frames * out_channels))
+            return -1;
+        frames = audio_resample(resample, (short *)resampled, (short *)res, frames);
+        res = resampled;
+    }
+
+    *samples = (int16_t *)res;
+    return frames;
+}
+
+int AudioReader::Decode(int16_t ** samples, double & second)
+{
+    if(!IsOpened())
+        return -1;
+    for(;;)
+    {
+        if(pending.size <= 0)
+        {
+            FreePacket();
+            if(av_read_frame(pFormatCtx, &packet) < 0)
+                return -1;
+            has_packet = true;
+            if(packet.stream_index != audioStream)
+                continue;
+            pending = packet;
+            int64_t timestamp = (packet.pts != AV_NOPTS_VALUE)?packet.pts:packet.dts;
+            if(timestamp != AV_NOPTS_VALUE)
+                next_second = ToSeconds(timestamp);
+        }
+
+        int size = AVCODEC_MAX_AUDIO_FRAME_SIZE;
+        int used = avcodec_decode_audio3(pCodecCtx, decoded, &size, &pending);
+        if(used < 0)
+        {
+            // broken packet is skipped
+            pending.size = 0;
+            continue;
+        }
+        pending.data += used;
+        pending.size -= used;
+        if(size <= 0)
+            continue;
+
+        second = next_second;
+        int bytes_per_frame = av_get_bits_per_sample_format(pCodecCtx->sample_fmt) / 8 * pCodecCtx->channels;
+        next_second += (double)(size / bytes_per_frame) / pCodecCtx->sample_rate;
+        return Convert(size, samples);
+    }
+}
+
+AVPacket * AudioReader::ReadPacket(double & second)
+{
+    if(!IsOpened())
+        return 0;
+    FreePacket();
+    AVPacket * res = new AVPacket();
+    while(av_read_frame(pFormatCtx, res) >= 0)
+    {
+        if(res->stream_index == audioStream)
+        {
+            int64_t timestamp = (res->pts != AV_NOPTS_VALUE)?res->pts:res->dts;
+            if(timestamp != AV_NOPTS_VALUE)
+                next_second = ToSeconds(timestamp);
+            second = next_second;
+            if(res->duration > 0)
+                next_second += ToSeconds(res->duration) - ToSeconds(0);
+            return res;
+        }
+        av_free_packet(res);
+    }
+    delete res;
+    return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef AUDIO_SOURCE_H
+#define AUDIO_SOURCE_H
+#include "movie.h"
+
+// 32 bit float samples to 16 bit with saturation, eight at once where SSE2 is available
+void ConvertFloatToS16(const float * src, int16_t * dst, int count);
+// interleaved 16 bit samples from one channel layout to another, 5.1 is mixed down
+void RemixS16(const int16_t * src, int src_channels, int16_t * dst, int dst_channels, int frames);
+
+// First audio stream of a source file, decoded to 16 bit samples with the
+// rate and channels of the output stream. Packets may also be read as they
+// are, when the output has the same codec and parameters
+class AudioReader
+{
+    private:
+    static const long lSize = 32768;
+    FileInputStream * fs;
+    unsigned char * pDataBuffer;
+    ByteIOContext * ByteIOCtx;
+    AVFormatContext * pFormatCtx;
+    AVCodecContext * pCodecCtx;
+    bool codec_opened;
+    int audioStream;
+    ReSampleContext * resample;
+    int out_rate;
+    int out_channels;
+
+    AVPacket packet;
+    bool has_packet;
+    // rest of the packet which is not decoded yet
+    AVPacket pending;
+    // source second of the next decoded sample
+    double next_second;
+
+    int16_t * decoded;
+    int16_t * converted;
+    int converted_size;
+    int16_t * remixed;
+    int remixed_size;
+    int16_t * resampled;
+    int resampled_size;
+
+    double ToSeconds(int64_t timestamp);
+    int Convert(int bytes, int16_t ** samples);
+    void FreePacket();
+
+    public:
+    String filename;
+    AudioReader();
+    ~AudioReader();
+    bool Open(const String & filename, int out_rate, int out_channels);
+    void Close();
+    bool IsOpened();
+    AVCodecContext * GetCodec();
+    bool Seek(double second);
+    // samples of the next decoded frames, returns the number of frames or -1 at the end of the file
+    int Decode(int16_t ** samples, double & second);
+    // next packet of the stream without decoding, 0 at the end of the file
+    AVPacket * ReadPacket(double & second);
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "config.h"
+#include "chunkPlaylist.h"
+
+bool ChunkPlaylist::Open(const String & output)
+{
+    file = File(output).withFileExtension(RENDER_CHUNK_PLAYLIST);
+    names.clear();
+    durations.clear();
+    return Write(false);
+}
+
+bool ChunkPlaylist::Add(const File & chunk, double seconds)
+{
+    names.add(chunk.getFileName());
+    durations.add(jmax(0.0, seconds));
+    return Write(false);
+}
+
+bool ChunkPlaylist::Finish()
+{
+    return Write(true);
+}
+
+/* the playlist is replaced at once, a reader never sees a half written one */
+bool ChunkPlaylist::Write(bool finished)
+{
+    double target = 1.0;
+    for(int i = 0; i<durations.size(); ++i)
+        target = jmax(target, durations[i]);
+
+    String text;
+    text<<"#EXTM3U\n";
+    text<<"#EXT-X-VERSION:3\n";
+    text<<"#EXT-X-TARGETDURATION:"<<(int)ceil(target)<<"\n";
+    text<<"#EXT-X-MEDIA-SEQUENCE:0\n";
+    text<<"#EXT-X-PLAYLIST-TYPE:"<<((finished)?"VOD":"EVENT")<<"\n";
+    for(int i = 0; i<names.size(); ++i)
+    {
+        text<<"#EXTINF:"<<String(durations[i], 3)<<",\n";
+        text<<names[i]<<"\n";
+    }
+    if(finished)
+        text<<"#EXT-X-ENDLIST\n";
+
+    TemporaryFile temp(file);
+    if(!temp.getFile().replaceWithText(text))
+        return false;
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+File GetChunkFile(const String & output, int index)
+{
+    File file(output);
+    String number = String(index);
+    while(number.length() < 5)
+        number = "0" + number;
+    return file.getSiblingFile(file.getFileNameWithoutExtension() + "_" + number + file.getFileExtension());
+}
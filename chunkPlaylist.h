@@ -0,0 +1,28 @@
+#ifndef CHUNK_PLAYLIST_H
+#define CHUNK_PLAYLIST_H
+#include "juce/juce.h"
+
+// Index of the chunk files of a segmented export, written as an HLS
+// playlist next to them. It is written again after every finished chunk, so
+// a chunk can be taken as soon as it is listed. The end is marked when the
+// render has finished, a failed render keeps the chunks listed before
+class ChunkPlaylist
+{
+    private:
+    File file;
+    StringArray names;
+    Array<double> durations;
+
+    bool Write(bool finished);
+
+    public:
+    // output - file name given to the render
+    bool Open(const String & output);
+    bool Add(const File & chunk, double seconds);
+    bool Finish();
+};
+
+// chunk number index of the output, "<name>_00012.<ext>"
+File GetChunkFile(const String & output, int index);
+
+#endif
@@ -3,5 +3,81 @@
 #define __STDC_CONSTANT_MACROS
 #define THREAD_PRIORITY_ENCODE 7
 #define THREAD_PRIORITY_PREVIEW 5
+#define THREAD_PRIORITY_SEEK 6
+#define THREAD_PRIORITY_REVERSE 6
+
+// megabytes of decoded frames kept ahead by reverse playback
+#define REVERSE_PLAYBACK_MEMORY 256
+
+// frames waiting between two stages of the render pipeline
+#define RENDER_PIPELINE_QUEUE 4
+// shortest part of the timeline rendered in parallel, in frames
+#define RENDER_SEGMENT_MIN_FRAMES 250
+// seconds of decoded sound kept ahead of the mux
+#define RENDER_AUDIO_BUFFER 2
+// copied sound packets waiting for the mux, they are much shorter than frames
+#define RENDER_AUDIO_PACKETS 64
+// buffer of the file with the pictures of the first pass, in bytes
+#define RENDER_FRAME_CACHE_BUFFER (1 << 20)
+// each of the two buffers of the output file, in bytes
+#define RENDER_OUTPUT_BUFFER (4 << 20)
+// alignment of the output buffers and of the O_DIRECT writes
+#define RENDER_OUTPUT_ALIGN 4096
+// output file is written around the page cache where the system allows it
+#define RENDER_OUTPUT_DIRECT 0
+// scaling contexts kept by every scaling thread of the render
+#define RENDER_SCALER_CACHE 8
+// frames scaled with every quality to measure its speed
+#define SCALE_BENCHMARK_FRAMES 30
+#define SCALE_BENCHMARK_WIDTH 1280
+#define SCALE_BENCHMARK_HEIGHT 720
+// most threads of one encoder or decoder, more of them are refused by the codecs
+#define RENDER_MAX_CODEC_THREADS 16
+// decoders of the render get this part of the cores given to the encoder
+#define RENDER_DECODE_SHARE 4
+// export with a deadline encodes this many samples of the timeline with every tried preset
+#define RENDER_CALIBRATION_SAMPLES 3
+// frames in every sample
+#define RENDER_CALIBRATION_FRAMES 20
+// part of the time left to the deadline the forecast of the render may take
+#define RENDER_DEADLINE_MARGIN 0.9
+// seconds between the checks of the render speed against the deadline
+#define RENDER_DEADLINE_CHECK 10
+// export with a deadline is split at least into this many segments, the preset changes between them
+#define RENDER_DEADLINE_SEGMENTS 8
+// measures of the finished render are written next to the output file
+#define RENDER_REPORT 1
+// finished segments are kept next to the output, an interrupted render goes on from them
+#define RENDER_CHECKPOINT 1
+// a segment of the checkpointed render is no longer than this
+#define RENDER_CHECKPOINT_SECONDS 60
+// milliseconds between the progress lines of the command line renderer
+#define RENDER_CLI_PROGRESS_INTERVAL 500
+// megabytes of the freed picture and packet buffers kept for the next renders
+#define RENDER_ARENA_CACHE 256
+// big buffers of the renders ask the system for huge pages where it gives them
+#define RENDER_ARENA_HUGE_PAGES 0
+// simulated renders of the buffer benchmark and packets of every one
+#define ARENA_BENCHMARK_PASSES 20
+#define ARENA_BENCHMARK_PACKETS 200
+// extension of the playlist of the chunk files of a segmented export
+#define RENDER_CHUNK_PLAYLIST "m3u8"
+// part of the physical memory the renders started by the queue may take
+#define RENDER_SCHEDULER_MEMORY 0.7
+// pixels of the x264 picture one core keeps up with
+#define RENDER_SCHEDULER_CORE_PIXELS (640 * 360)
+// pictures kept by the x264 lookahead and references, by the other encoders and by a decoder
+#define RENDER_SCHEDULER_X264_FRAMES 60
+#define RENDER_SCHEDULER_ENCODER_FRAMES 4
+#define RENDER_SCHEDULER_DECODER_FRAMES 16
+// times a task waiting for room is passed over by smaller ones before the queue waits for it
+#define RENDER_SCHEDULER_PASSES 3
+// jobs of the render queue are kept in the data directory of the user and come back after a restart
+#define RENDER_QUEUE_JOURNAL 1
+#define RENDER_QUEUE_JOURNAL_FILE "video_editor/render_queue.journal"
+// records appended to the journal of the queue before it is written again with the jobs left
+#define RENDER_QUEUE_JOURNAL_COMPACT 200
+// bytes of the load of the stages published with the progress of a task
+#define RENDER_PROGRESS_TEXT 512
 
 #endif
@@ -4,6 +4,11 @@
 #include "capabilities.h"
 #include "tasks.h"
 #include "encodeVideo.h"
+#include "scalerCache.h"
+
+/* heights of the smaller renditions of the export, in the order they are added */
+static const int rendition_heights[] = {720, 480, 360};
+
 encodeVideo::encodeVideo (MainComponent* mainWindow):DocumentWindow(LABEL_SAVE_VIDEO,Colours::whitesmoke,DocumentWindow::closeButton)
 {
     setTitleBarHeight (20);
@@ -315,6 +320,42 @@ encodeVideoComponent::encodeVideoComponent (MainComponent* mainWindow)
     passList->setTextWhenNothingSelected (String::empty);
     passList->addListener (this);
 
+    addChildComponent (segmentsList = new ComboBox ());
+    segmentsList->setEditableText (false);
+    segmentsList->setJustificationType (Justification::centredLeft);
+    segmentsList->setTextWhenNothingSelected (String::empty);
+    segmentsList->addListener (this);
+
+    addChildComponent (smartRender = new ToggleButton (LABEL_VIDEO_SAVE_SMART_RENDER));
+    smartRender->setToggleState (false, false);
+
+    addChildComponent (passCache = new ToggleButton (LABEL_VIDEO_SAVE_PASS_CACHE));
+    passCache->setToggleState (false, false);
+
+    addChildComponent (scaleQuality = new ComboBox ());
+    scaleQuality->setEditableText (false);
+    scaleQuality->setJustificationType (Justification::centredLeft);
+    scaleQuality->setTextWhenNothingSelected (String::empty);
+    scaleQuality->addListener (this);
+
+    addChildComponent (deadlineList = new ComboBox ());
+    deadlineList->setEditableText (false);
+    deadlineList->setJustificationType (Justification::centredLeft);
+    deadlineList->setTextWhenNothingSelected (String::empty);
+    deadlineList->addListener (this);
+
+    addChildComponent (renditionsList = new ComboBox ());
+    renditionsList->setEditableText (false);
+    renditionsList->setJustificationType (Justification::centredLeft);
+    renditionsList->setTextWhenNothingSelected (String::empty);
+    renditionsList->addListener (this);
+
+    addChildComponent (chunksList = new ComboBox ());
+    chunksList->setEditableText (false);
+    chunksList->setJustificationType (Justification::centredLeft);
+    chunksList->setTextWhenNothingSelected (String::empty);
+    chunksList->addListener (this);
+
 
     addAndMakeVisible (qualityList = new ComboBox ());
     qualityList->setEditableText (false);
@@ -508,6 +549,39 @@ encodeVideoComponent::encodeVideoComponent (MainComponent* mainWindow)
     passList->addItem(LABEL_VIDEO_SAVE_PASS_ONE,1);
     passList->addItem(LABEL_VIDEO_SAVE_PASS_TWO,2);
 
+    /* id is the number of segments + 1 */
+    segmentsList->addItem(LABEL_VIDEO_SAVE_SEGMENTS_AUTO + " (" + String(SystemStats::getNumCpus()) + ")",1);
+    segmentsList->addItem(LABEL_VIDEO_SAVE_SEGMENTS_OFF,2);
+    for(int segments = 2; segments<=16; segments*=2)
+        segmentsList->addItem(String(segments),segments + 1);
+
+    /* id is the ScaleQuality + 1 */
+    for(int quality = 0; quality<SCALE_QUALITY_COUNT; ++quality)
+        scaleQuality->addItem(GetScaleQualityName(quality),quality + 1);
+
+    /* id is the number of minutes + 1 */
+    deadlineList->addItem(LABEL_VIDEO_SAVE_DEADLINE_OFF,1);
+    const int deadlines[] = {5, 10, 15, 20, 30, 45, 60, 90, 120, 180, 240, 360, 480};
+    for(int i = 0; i<(int)(sizeof(deadlines) / sizeof(deadlines[0])); ++i)
+        deadlineList->addItem(String(deadlines[i]) + " " + LABEL_VIDEO_SAVE_DEADLINE_MINUTES,deadlines[i] + 1);
+
+    /* id is the number of the renditions + 1 */
+    renditionsList->addItem(LABEL_VIDEO_SAVE_RENDITIONS_OFF,1);
+    String heights;
+    for(int i = 0; i<(int)(sizeof(rendition_heights) / sizeof(rendition_heights[0])); ++i)
+    {
+        if(i>0)
+            heights += ", ";
+        heights += String(rendition_heights[i]) + "p";
+        renditionsList->addItem(heights,i + 2);
+    }
+
+    /* id is the number of seconds of a chunk + 1 */
+    chunksList->addItem(LABEL_VIDEO_SAVE_CHUNKS_OFF,1);
+    const int chunks[] = {2, 4, 6, 10, 30, 60};
+    for(int i = 0; i<(int)(sizeof(chunks) / sizeof(chunks[0])); ++i)
+        chunksList->addItem(String(chunks[i]) + " " + LABEL_SECONDS,chunks[i] + 1);
+
     /* ~display all formats and codecs */
     Movie::Info *movie_info = timeline->intervals.front()->movie->GetMovieInfo();
     selectByMovieInfo(movie_info);
@@ -534,6 +608,11 @@ void encodeVideoComponent::selectByMovieInfo(Movie::Info * info)
     gop->setText(String(""),false);
     fps->setText(String(video_info.fps),false);
     passList->setSelectedItemIndex(0);
+    segmentsList->setSelectedId(2);
+    scaleQuality->setSelectedId(SCALE_QUALITY_BICUBIC + 1);
+    deadlineList->setSelectedId(1);
+    renditionsList->setSelectedId(1);
+    chunksList->setSelectedId(1);
 
     /* ~select video codec */
     /* select audio codec */
@@ -548,7 +627,7 @@ void encodeVideoComponent::selectByMovieInfo(Movie::Info * info)
         }
     }
     audioCodec->setSelectedItemIndex(index);
-    audioSampleRate->setText(String("441"));
+    audioSampleRate->setText(String("44100"));
     audioBitrate->setText(String("64"));
     channels->setText(String("2"));
 
@@ -574,6 +653,12 @@ Movie::Info encodeVideoComponent::GetMovieInfo()
         video_info.is_bitrate_or_crf = rateControl->getSelectedId()==1;
 
         video_info.pass = (video_info.is_bitrate_or_crf)?passList->getSelectedId():1;
+        video_info.segments = segmentsList->getSelectedId() - 1;
+        video_info.smart_render = smartRender->getToggleState();
+        video_info.pass_cache = passCache->getToggleState();
+        video_info.scale_quality = scaleQuality->getSelectedId() - 1;
+        video_info.deadline = (deadlineList->getSelectedId() - 1) * 60;
+        video_info.chunk_duration = chunksList->getSelectedId() - 1;
         if(vc.hasCompressionPreset())
             video_info.compressionPreset = compressionPreset->getSelectedId();
 
@@ -595,12 +680,47 @@ Movie::Info encodeVideoComponent::GetMovieInfo()
 }
 
 
+/* smaller renditions keep the aspect ratio of the output, the bit rate is
+   scaled by the number of pixels and the quality stays the same */
+vector<Movie::Info> encodeVideoComponent::GetRenditions()
+{
+    Movie::Info info = GetMovieInfo();
+    vector<Movie::Info> res(1, info);
+    if(info.videos.size()==0 || info.videos[0].height<=0)
+        return res;
+    const Movie::VideoInfo & video = info.videos[0];
+    File file(info.filename);
+    for(int i = 0; i<renditionsList->getSelectedId() - 1; ++i)
+    {
+        int height = rendition_heights[i];
+        if(height == video.height)
+            continue;
+        Movie::Info rendition(info);
+        Movie::VideoInfo & rendition_video = rendition.videos[0];
+        rendition_video.height = height;
+        rendition_video.width = (video.width * height / video.height + 1) / 2 * 2;
+        if(video.is_bitrate_or_crf)
+            rendition_video.bit_rate = jmax(1, (int)((int64)video.bit_rate * rendition_video.width * height / ((int64)video.width * video.height)));
+        rendition.filename = file.getSiblingFile(file.getFileNameWithoutExtension() + "_" + String(height) + "p" + file.getFileExtension()).getFullPathName();
+        res.push_back(rendition);
+    }
+    return res;
+}
+
+
 encodeVideoComponent::~encodeVideoComponent()
 {
     deleteAndZero (format);
     deleteAndZero (advancedMode);
     deleteAndZero (resolutionList);
     deleteAndZero (passList);
+    deleteAndZero (segmentsList);
+    deleteAndZero (smartRender);
+    deleteAndZero (passCache);
+    deleteAndZero (scaleQuality);
+    deleteAndZero (deadlineList);
+    deleteAndZero (renditionsList);
+    deleteAndZero (chunksList);
     deleteAndZero (qualityList);
     deleteAndZero (path);
     deleteAndZero (groupComponent);
@@ -725,6 +845,31 @@ void encodeVideoComponent::paint (Graphics& g)
                           0, 324+ upDetailed+160 + add, 148-20, 30,2,
                           Justification::centredRight, true);
 
+    if(isAdvancedMode)
+        g.drawFittedText (LABEL_VIDEO_SAVE_SEGMENTS,
+                          0, 324+ upDetailed+160+40 + add, 148-20, 30,2,
+                          Justification::centredRight, true);
+
+    if(isAdvancedMode)
+        g.drawFittedText (LABEL_VIDEO_SAVE_SCALE_QUALITY,
+                          0, 324+ upDetailed+160+160 + add, 148-20, 30,2,
+                          Justification::centredRight, true);
+
+    if(isAdvancedMode)
+        g.drawFittedText (LABEL_VIDEO_SAVE_DEADLINE,
+                          0, 324+ upDetailed+160+200 + add, 148-20, 30,2,
+                          Justification::centredRight, true);
+
+    if(isAdvancedMode)
+        g.drawFittedText (LABEL_VIDEO_SAVE_RENDITIONS,
+                          0, 324+ upDetailed+160+240 + add, 148-20, 30,2,
+                          Justification::centredRight, true);
+
+    if(isAdvancedMode)
+        g.drawFittedText (LABEL_VIDEO_SAVE_CHUNKS,
+                          0, 324+ upDetailed+160+280 + add, 148-20, 30,2,
+                          Justification::centredRight, true);
+
     if(isAdvancedMode)
         g.drawFittedText (LABEL_VIDEO_GOP,
                           0, 284+ upDetailed+160 + add, 148-20, 30,2,
@@ -794,10 +939,10 @@ void encodeVideoComponent::resized()
 {
     format->setBounds (232, 48, 540, 24);
     path->setBounds (232, 8, 540, 24);
-    int group_height = 224+120+40 + 40;
+    int group_height = 224+120+40 + 40 + 80 + 40 + 40 + 40 + 40 + 40;
     if(!isAdvancedMode)
     {
-        group_height -= 200 + 40;
+        group_height -= 480 + 40;
     }
     int add = 0;
     if(hasCompressionPreset)
@@ -818,6 +963,13 @@ void encodeVideoComponent::resized()
     qualityList->setBounds (200-48, 128+ upDetailed+80, 232, 24);
     advancedMode->setBounds (200-48, 128+ upDetailed+120 + add, 232, 24);
     passList->setBounds (200-48, 288+ upDetailed+160+40+ add, 232, 24);
+    segmentsList->setBounds (200-48, 288+ upDetailed+160+80+ add, 232, 24);
+    smartRender->setBounds (16+20, 288+ upDetailed+160+120+ add, 348, 24);
+    passCache->setBounds (16+20, 288+ upDetailed+160+160+ add, 348, 24);
+    scaleQuality->setBounds (200-48, 288+ upDetailed+160+200+ add, 232, 24);
+    deadlineList->setBounds (200-48, 288+ upDetailed+160+240+ add, 232, 24);
+    renditionsList->setBounds (200-48, 288+ upDetailed+160+280+ add, 232, 24);
+    chunksList->setBounds (200-48, 288+ upDetailed+160+320+ add, 232, 24);
     enableAudio->setBounds (400+20, 104+ upDetailed-40, 360, 40);
     groupComponent2->setBounds (400, 104+ upDetailed, 380, 184);
     audioCodec->setBounds (535-20, 128+ upDetailed, 252, 24);
@@ -1220,8 +1372,7 @@ void encodeVideoComponent::buttonClicked (Button* buttonThatWasClicked)
             return;
         }
 
-        Movie::Info info = GetMovieInfo();
-        AddEncodingTask(timeline,info);
+        AddEncodingTask(timeline,GetRenditions());
 
         if(!mainWindow->tasks->isVisible)
             mainWindow->tasks->add();
@@ -1253,6 +1404,13 @@ void encodeVideoComponent::buttonClicked (Button* buttonThatWasClicked)
             gop->setEnabled(true);
             advancedMode->setEnabled(true);
             passList->setEnabled(true);
+            segmentsList->setEnabled(true);
+            smartRender->setEnabled(true);
+            passCache->setEnabled(true);
+            scaleQuality->setEnabled(true);
+            deadlineList->setEnabled(true);
+            renditionsList->setEnabled(true);
+            chunksList->setEnabled(true);
             rateControl->setEnabled(true);
             qualityList->setEnabled(true);
             compressionPreset->setEnabled(true);
@@ -1270,6 +1428,13 @@ void encodeVideoComponent::buttonClicked (Button* buttonThatWasClicked)
             rateControl->setEnabled(false);
             advancedMode->setEnabled(false);
             passList->setEnabled(false);
+            segmentsList->setEnabled(false);
+            smartRender->setEnabled(false);
+            passCache->setEnabled(false);
+            scaleQuality->setEnabled(false);
+            deadlineList->setEnabled(false);
+            renditionsList->setEnabled(false);
+            chunksList->setEnabled(false);
             qualityList->setEnabled(false);
             compressionPreset->setEnabled(false);
             resolutionList->setEnabled(false);
@@ -1323,6 +1488,13 @@ void encodeVideoComponent::buttonClicked (Button* buttonThatWasClicked)
         videoWidth->setVisible(isAdvancedMode);
         videoHeight->setVisible(isAdvancedMode);
         passList->setVisible(isAdvancedMode);
+        segmentsList->setVisible(isAdvancedMode);
+        smartRender->setVisible(isAdvancedMode);
+        passCache->setVisible(isAdvancedMode);
+        scaleQuality->setVisible(isAdvancedMode);
+        deadlineList->setVisible(isAdvancedMode);
+        renditionsList->setVisible(isAdvancedMode);
+        chunksList->setVisible(isAdvancedMode);
         int new_height = getHeight();
         int new_height_parent = getParentComponent()->getHeight();
         if(isAdvancedMode)
@@ -1332,8 +1504,8 @@ void encodeVideoComponent::buttonClicked (Button* buttonThatWasClicked)
                 new_height+=40;
                 new_height_parent+=40;
             }
-            new_height+=200;
-            new_height_parent+=200;
+            new_height+=480;
+            new_height_parent+=480;
         }
         else
         {
@@ -1342,8 +1514,8 @@ void encodeVideoComponent::buttonClicked (Button* buttonThatWasClicked)
                 new_height-=40;
                 new_height_parent-=40;
             }
-            new_height-=200;
-            new_height_parent-=200;
+            new_height-=480;
+            new_height_parent-=480;
         }
         setSize(getWidth(),new_height);
         getParentComponent()->setSize(getParentComponent()->getWidth(),new_height_parent);
@@ -59,6 +59,8 @@ public:
     bool isPreviewVisible;
     MainComponent* mainWindow;
     Movie::Info GetMovieInfo();
+    // the output and its smaller renditions, rendered by one task
+    vector<Movie::Info> GetRenditions();
     bool needUpdateFileName;
 private:
 
@@ -66,6 +68,13 @@ private:
     ComboBox* videoCodec;
 
     ComboBox* passList;
+    ComboBox* segmentsList;
+    ToggleButton* smartRender;
+    ToggleButton* passCache;
+    ComboBox* scaleQuality;
+    ComboBox* deadlineList;
+    ComboBox* renditionsList;
+    ComboBox* chunksList;
 
     ToggleButton* advancedMode;
 
@@ -0,0 +1,309 @@
+#include "config.h"
+#include "frameArena.h"
+#include "localization.h"
+#include <algorithm>
+#if RENDER_ARENA_HUGE_PAGES && JUCE_LINUX
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+using namespace localization;
+
+// the buffer is preceded by its class and by the way it was taken, the
+// header keeps the alignment of av_malloc
+#define ARENA_HEADER 32
+#define ARENA_MIN_SHIFT 10
+#define ARENA_CLASSES 72
+#define ARENA_HUGE_PAGE (2 * 1024 * 1024)
+
+enum BlockKind
+{
+    BLOCK_AV_MALLOC = 0,
+    BLOCK_HUGE_PAGES = 1
+};
+
+FrameArena::FrameArena()
+{
+    free_blocks.resize(ARENA_CLASSES);
+    in_use = 0;
+    cached = 0;
+    peak = 0;
+    system_allocs = 0;
+    reused = 0;
+}
+
+FrameArena::~FrameArena()
+{
+    Trim();
+}
+
+/* class 4*n+s is 2^(n+10) * (1 + s/4) bytes, -1 if the size is too big to be kept */
+int FrameArena::GetClass(int size)
+{
+    for(int size_class = 0; size_class<ARENA_CLASSES; ++size_class)
+    {
+        if(GetClassSize(size_class) >= size)
+            return size_class;
+    }
+    return -1;
+}
+
+int FrameArena::GetClassSize(int size_class)
+{
+    int shift = ARENA_MIN_SHIFT + size_class / 4;
+    return (1 << shift) + (size_class % 4) * (1 << (shift - 2));
+}
+
+uint8_t * FrameArena::AllocBlock(int size, int size_class)
+{
+    uint8_t * block = 0;
+    int kind = BLOCK_AV_MALLOC;
+#if RENDER_ARENA_HUGE_PAGES && JUCE_LINUX && defined(MADV_HUGEPAGE)
+    if(size >= ARENA_HUGE_PAGE)
+    {
+        void * aligned = 0;
+        if(posix_memalign(&aligned, ARENA_HUGE_PAGE, size + ARENA_HEADER) == 0)
+        {
+            madvise(aligned, size + ARENA_HEADER, MADV_HUGEPAGE);
+            block = (uint8_t *)aligned;
+            kind = BLOCK_HUGE_PAGES;
+        }
+    }
+#endif
+    if(!block)
+        block = (uint8_t *)av_malloc(size + ARENA_HEADER);
+    if(!block)
+        return 0;
+    int * header = (int *)block;
+    header[0] = size_class;
+    header[1] = kind;
+    header[2] = size;
+    return block + ARENA_HEADER;
+}
+
+void FrameArena::FreeBlock(uint8_t * data)
+{
+    uint8_t * block = data - ARENA_HEADER;
+#if RENDER_ARENA_HUGE_PAGES && JUCE_LINUX && defined(MADV_HUGEPAGE)
+    if(((int *)block)[1] == BLOCK_HUGE_PAGES)
+    {
+        free(block);
+        return;
+    }
+#endif
+    av_free(block);
+}
+
+uint8_t * FrameArena::Alloc(int size)
+{
+    if(size <= 0)
+        return 0;
+    int size_class = GetClass(size);
+    int block_size = (size_class>=0)?GetClassSize(size_class):size;
+    {
+        const ScopedLock myScopedLock (critical);
+        in_use += block_size;
+        if(size_class>=0 && !free_blocks[size_class].empty())
+        {
+            uint8_t * data = free_blocks[size_class].back();
+            free_blocks[size_class].pop_back();
+            cached -= block_size;
+            reused++;
+            return data;
+        }
+        system_allocs++;
+        peak = jmax(peak, in_use + cached);
+        for(vector<PeakWatch*>::iterator it = watches.begin(); it!=watches.end(); it++)
+            (*it)->peak = jmax((*it)->peak, in_use + cached);
+    }
+    uint8_t * data = AllocBlock(block_size, size_class);
+    if(!data)
+    {
+        const ScopedLock myScopedLock (critical);
+        in_use -= block_size;
+    }
+    return data;
+}
+
+void FrameArena::Free(void * data)
+{
+    if(!data)
+        return;
+    const int * header = (const int *)((uint8_t *)data - ARENA_HEADER);
+    int size_class = header[0];
+    int block_size = header[2];
+    {
+        const ScopedLock myScopedLock (critical);
+        in_use -= block_size;
+        // buffers above the limit go back to the system
+        if(size_class>=0 && cached + block_size <= (int64)RENDER_ARENA_CACHE * 1024 * 1024)
+        {
+            free_blocks[size_class].push_back((uint8_t *)data);
+            cached += block_size;
+            return;
+        }
+    }
+    FreeBlock((uint8_t *)data);
+}
+
+bool FrameArena::AllocPicture(AVPicture * picture, PixelFormat pix_fmt, int width, int height)
+{
+    int size = avpicture_get_size(pix_fmt, width, height);
+    uint8_t * data = (size>0)?Alloc(size):0;
+    if(!data)
+    {
+        memset(picture, 0, sizeof(AVPicture));
+        return false;
+    }
+    avpicture_fill(picture, data, pix_fmt, width, height);
+    return true;
+}
+
+void FrameArena::FreePicture(AVPicture * picture)
+{
+    Free(picture->data[0]);
+    memset(picture, 0, sizeof(AVPicture));
+}
+
+void FrameArena::Trim()
+{
+    vector<uint8_t*> blocks;
+    {
+        const ScopedLock myScopedLock (critical);
+        for(vector<vector<uint8_t*> >::iterator it = free_blocks.begin(); it!=free_blocks.end(); it++)
+        {
+            blocks.insert(blocks.end(), it->begin(), it->end());
+            it->clear();
+        }
+        cached = 0;
+    }
+    for(vector<uint8_t*>::iterator it = blocks.begin(); it!=blocks.end(); it++)
+        FreeBlock(*it);
+}
+
+int64 FrameArena::GetPeak()
+{
+    const ScopedLock myScopedLock (critical);
+    return peak;
+}
+
+FrameArena::PeakWatch::PeakWatch(FrameArena & arena):arena(arena)
+{
+    const ScopedLock myScopedLock (arena.critical);
+    peak = arena.in_use + arena.cached;
+    arena.watches.push_back(this);
+}
+
+FrameArena::PeakWatch::~PeakWatch()
+{
+    const ScopedLock myScopedLock (arena.critical);
+    arena.watches.erase(find(arena.watches.begin(), arena.watches.end(), this));
+}
+
+int64 FrameArena::PeakWatch::GetPeak()
+{
+    const ScopedLock myScopedLock (arena.critical);
+    return peak;
+}
+
+int64 FrameArena::GetSystemAllocs()
+{
+    const ScopedLock myScopedLock (critical);
+    return system_allocs;
+}
+
+int64 FrameArena::GetReused()
+{
+    const ScopedLock myScopedLock (critical);
+    return reused;
+}
+
+FrameArena & GetFrameArena()
+{
+    static FrameArena arena;
+    return arena;
+}
+
+/* a pass takes the pictures of the pipeline and the buffer of the encoder,
+   then a stream of packets of which a queue is held at once. Every buffer
+   is written once as the codecs do */
+static uint8_t * bench_alloc(FrameArena * arena, int size, int64 & in_use, int64 & peak)
+{
+    uint8_t * buffer = (arena)?arena->Alloc(size):(uint8_t *)av_malloc(size);
+    if(!buffer)
+        return 0;
+    memset(buffer, 1, size);
+    in_use += size;
+    peak = jmax(peak, in_use);
+    return buffer;
+}
+
+static void bench_free(FrameArena * arena, uint8_t * buffer, int size, int64 & in_use)
+{
+    if(!buffer)
+        return;
+    if(arena)
+        arena->Free(buffer);
+    else
+        av_free(buffer);
+    in_use -= size;
+}
+
+static double run_arena_pass(FrameArena * arena, int width, int height, int64 & in_use, int64 & peak)
+{
+    double before = Time::getMillisecondCounterHiRes();
+    int picture_size = avpicture_get_size(PIX_FMT_YUV420P, width, height);
+    int outbuf_size = 6 * width * height + 200;
+    int packet_size = jmax(1, picture_size / 20);
+
+    vector<uint8_t*> pictures;
+    for(int i = 0; i<2 * (RENDER_PIPELINE_QUEUE + 2); ++i)
+        pictures.push_back(bench_alloc(arena, picture_size, in_use, peak));
+    uint8_t * outbuf = bench_alloc(arena, outbuf_size, in_use, peak);
+
+    vector<uint8_t*> packets;
+    vector<int> sizes;
+    for(int i = 0; i<ARENA_BENCHMARK_PACKETS; ++i)
+    {
+        int size = packet_size + (i * 7919) % packet_size;
+        packets.push_back(bench_alloc(arena, size, in_use, peak));
+        sizes.push_back(size);
+        if((int)packets.size() > RENDER_PIPELINE_QUEUE)
+        {
+            bench_free(arena, packets.front(), sizes.front(), in_use);
+            packets.erase(packets.begin());
+            sizes.erase(sizes.begin());
+        }
+    }
+
+    for(int i = 0; i<(int)packets.size(); ++i)
+        bench_free(arena, packets[i], sizes[i], in_use);
+    bench_free(arena, outbuf, outbuf_size, in_use);
+    for(vector<uint8_t*>::iterator it = pictures.begin(); it!=pictures.end(); it++)
+        bench_free(arena, *it, picture_size, in_use);
+    return Time::getMillisecondCounterHiRes() - before;
+}
+
+String BenchmarkFrameArena(int width, int height)
+{
+    String res = LABEL_ARENA_BENCHMARK + " " + String(width) + "x" + String(height) + ", " + String(ARENA_BENCHMARK_PASSES) + " " + LABEL_ARENA_BENCHMARK_PASSES + "\n";
+
+    int64 in_use = 0;
+    int64 peak = 0;
+    double millis = 0.0;
+    for(int i = 0; i<ARENA_BENCHMARK_PASSES; ++i)
+        millis += run_arena_pass(0, width, height, in_use, peak);
+    res += LABEL_ARENA_BENCHMARK_SYSTEM + ": " + String(millis / ARENA_BENCHMARK_PASSES, 2) + " " + LABEL_MINI_SECONDS;
+    res += ", " + LABEL_ARENA_BENCHMARK_PEAK + " " + String((double)peak / (1024.0 * 1024.0), 1) + " " + LABEL_MEGABYTES + "\n";
+
+    // an arena of its own, the one of the renders is not disturbed
+    FrameArena arena;
+    in_use = 0;
+    peak = 0;
+    millis = 0.0;
+    for(int i = 0; i<ARENA_BENCHMARK_PASSES; ++i)
+        millis += run_arena_pass(&arena, width, height, in_use, peak);
+    res += LABEL_ARENA_BENCHMARK_ARENA + ": " + String(millis / ARENA_BENCHMARK_PASSES, 2) + " " + LABEL_MINI_SECONDS;
+    res += ", " + LABEL_ARENA_BENCHMARK_PEAK + " " + String((double)arena.GetPeak() / (1024.0 * 1024.0), 1) + " " + LABEL_MEGABYTES;
+    res += ", " + LABEL_ARENA_BENCHMARK_REUSED + " " + String(arena.GetReused()) + "/" + String(arena.GetReused() + arena.GetSystemAllocs()) + "\n";
+    return res;
+}
@@ -0,0 +1,68 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+#include "movie.h"
+
+// Buffers of the pictures, samples and packets of all the renders of the
+// process. Sizes are rounded up to classes, four of them per doubling. A
+// released buffer is kept for the next request of its class instead of
+// going back to the system, so the renders running at once or one after
+// another reuse the same memory
+class FrameArena
+{
+    public:
+    // most bytes the arena took from the system while the watch lives, the
+    // renders running at the same time are counted too
+    class PeakWatch
+    {
+        private:
+        FrameArena & arena;
+        int64 peak;
+        friend class FrameArena;
+
+        public:
+        PeakWatch(FrameArena & arena);
+        ~PeakWatch();
+        int64 GetPeak();
+    };
+
+    private:
+    CriticalSection critical;
+    // free buffers of every class
+    vector<vector<uint8_t*> > free_blocks;
+    int64 in_use;
+    int64 cached;
+    int64 peak;
+    int64 system_allocs;
+    int64 reused;
+    vector<PeakWatch*> watches;
+
+    static int GetClass(int size);
+    static int GetClassSize(int size_class);
+    static uint8_t * AllocBlock(int size, int size_class);
+    static void FreeBlock(uint8_t * block);
+
+    public:
+    FrameArena();
+    ~FrameArena();
+    // aligned as av_malloc, 0 if there is no memory
+    uint8_t * Alloc(int size);
+    void Free(void * data);
+    // planes of the picture in one buffer of the arena
+    bool AllocPicture(AVPicture * picture, PixelFormat pix_fmt, int width, int height);
+    void FreePicture(AVPicture * picture);
+    // the kept buffers go back to the system
+    void Trim();
+    // most bytes taken from the system at once, in use and kept, since the
+    // start of the process
+    int64 GetPeak();
+    int64 GetSystemAllocs();
+    int64 GetReused();
+};
+
+FrameArena & GetFrameArena();
+
+// time and memory of the buffers of a few renders of the output size taken
+// from the system and from the arena
+String BenchmarkFrameArena(int width, int height);
+
+#endif
@@ -33,6 +33,24 @@ String FILE_NOT_SAVED = T("Запись не удалась");
 
 String LABEL_PLAY = T("Воспроизвести");
 String LABEL_PAUSE = T("Пауза");
+String LABEL_PLAY_REVERSE = T("Воспроизвести назад");
+String MENU_SHUTTLE = T("Перемотка");
+String LABEL_SHUTTLE_FORWARD = T("Быстрее вперёд");
+String LABEL_SHUTTLE_REVERSE = T("Быстрее назад");
+String LABEL_SHUTTLE_FORWARD_SLOW = T("Медленнее вперёд");
+String LABEL_SHUTTLE_REVERSE_SLOW = T("Медленнее назад");
+String LABEL_SHUTTLE_STOP = T("Остановить");
+String MENU_PLAYBACK_STATISTICS = T("Статистика воспроизведения");
+String MENU_EXPORT_PLAYBACK_STATISTICS = T("Сохранить статистику воспроизведения");
+String MENU_SCALE_BENCHMARK = T("Скорость масштабирования");
+String DIALOG_CHOOSE_STATISTICS_TO_SAVE = T("Сохранить статистику воспроизведения");
+String LABEL_FRAMES_PRESENTED = T("показано кадров");
+String LABEL_FRAMES_LATE = T("показано с опозданием");
+String LABEL_FRAMES_DROPPED = T("пропущено кадров");
+String LABEL_FRAMES_DECODED = T("декодировано кадров");
+String LABEL_DECODE_TIME = T("Время декодирования кадра, мсек.");
+String LABEL_DECODE_TIME_AVERAGE = T("среднее время декодирования");
+String LABEL_DECODE_TIME_MAX = T("максимальное время декодирования");
 
 String LABEL_STOP = T("Остановить");
 String LABEL_NEXT_FRAME = T("+1 кадр");
@@ -182,6 +200,7 @@ String LABEL_TASK_TAB_TYPE_PANORAMA = T("Панорама");
 String LABEL_TASK_TAB_DESCRPTION = T("Имя файла");
 String LABEL_TASK_TAB_TIME_LEFT = T("Осталось");
 String LABEL_TASK_TAB_PROGRESS = T("Сатус");
+String LABEL_TASK_TAB_CORES = T("Ядра");
 String LABEL_SAVE_VIDEO_SUSPENDED = T("Сохранение прервано");
 
 String LABEL_TASK_TAB_ERROR_CANT_LOAD_FILE = T("Ошибка. Невозможно загрузить файл ");
@@ -208,4 +227,56 @@ String LABEL_SAVE_VIDEO_ERROR_OPEN_AUDIO_CODEC = T("Невозможно отк
 String LABEL_SAVE_VIDEO_ERROR_OPEN_VIDEO_CODEC = T("Невозможно открыть видео кодек");
 
 String LABEL_SAVE_VIDEO_PAUSED = T("Остановлено");
+String LABEL_RENDER_STAGE_DECODE = T("декодирование");
+String LABEL_RENDER_STAGE_SCALE = T("масштабирование");
+String LABEL_RENDER_STAGE_ENCODE = T("кодирование");
+String LABEL_RENDER_STAGE_MUX = T("запись");
+String LABEL_RENDER_STAGE_STITCH = T("сшивка");
+String LABEL_RENDER_STAGE_COPY = T("копирование");
+String LABEL_RENDER_STAGE_AUDIO = T("звук");
+String LABEL_RENDER_STAGE_CACHE = T("кадры первого прохода");
+String LABEL_RENDER_STAGE_OUTPUT = T("вывод");
+String LABEL_MEGABYTES_PER_SECOND = T("МБ/с");
+String LABEL_VIDEO_SAVE_SEGMENTS = T("Параллельные части");
+String LABEL_VIDEO_SAVE_SEGMENTS_AUTO = T("по числу ядер");
+String LABEL_VIDEO_SAVE_SEGMENTS_OFF = T("1 - выключено");
+String LABEL_VIDEO_SAVE_SMART_RENDER = T("Копировать совпадающие части без перекодирования");
+String LABEL_VIDEO_SAVE_PASS_CACHE = T("Сохранять кадры первого прохода на диск");
+String LABEL_SAVE_VIDEO_ERROR_PASS_STATS = T("Ошибка записи статистики первого прохода");
+String LABEL_SAVE_VIDEO_ERROR_FRAME_CACHE = T("Ошибка чтения кадров первого прохода");
+String LABEL_VIDEO_SAVE_SCALE_QUALITY = T("Масштабирование");
+String LABEL_SCALE_QUALITY_FAST_BILINEAR = T("быстрое билинейное - черновик");
+String LABEL_SCALE_QUALITY_BILINEAR = T("билинейное");
+String LABEL_SCALE_QUALITY_BICUBIC = T("бикубическое");
+String LABEL_SCALE_QUALITY_LANCZOS = T("Ланцош - наилучшее");
+String LABEL_MILLISECONDS_PER_FRAME = T("мсек./кадр");
+String LABEL_SCALE_BENCHMARK_CONTEXT = T("создание контекста");
+String LABEL_VIDEO_SAVE_DEADLINE = T("Закончить за");
+String LABEL_VIDEO_SAVE_DEADLINE_OFF = T("без ограничения");
+String LABEL_VIDEO_SAVE_DEADLINE_MINUTES = T("мин.");
+String LABEL_DEADLINE_PRESET = T("пресет");
+String LABEL_DEADLINE_FORECAST = T("прогноз");
+String LABEL_MEGABYTES = T("МБ");
+String LABEL_RENDER_STAGE_CALIBRATION = T("подбор пресета");
+String LABEL_FRAMES_PER_SECOND = T("к/с");
+String LABEL_RENDER_QUEUES = T("очереди");
+String LABEL_RENDER_STAGE_FAN_OUT = T("раздача кадров");
+String LABEL_VIDEO_SAVE_RENDITIONS = T("Ещё размеры");
+String LABEL_VIDEO_SAVE_RENDITIONS_OFF = T("нет");
+String LABEL_ARENA_BENCHMARK = T("Буферы рендера");
+String LABEL_ARENA_BENCHMARK_PASSES = T("проходов");
+String LABEL_ARENA_BENCHMARK_SYSTEM = T("от системы");
+String LABEL_ARENA_BENCHMARK_ARENA = T("из пула");
+String LABEL_ARENA_BENCHMARK_PEAK = T("пик памяти");
+String LABEL_ARENA_BENCHMARK_REUSED = T("повторно");
+String LABEL_VIDEO_SAVE_CHUNKS = T("Нарезать по");
+String LABEL_VIDEO_SAVE_CHUNKS_OFF = T("одним файлом");
+String LABEL_TASK_TAB_PRIORITY = T("Приоритет");
+String LABEL_TASK_PRIORITY_LOW = T("низкий");
+String LABEL_TASK_PRIORITY_NORMAL = T("обычный");
+String LABEL_TASK_PRIORITY_HIGH = T("высокий");
+String LABEL_TASK_TAB_MOVE_UP = T("Выше");
+String LABEL_TASK_TAB_MOVE_DOWN = T("Ниже");
+String LABEL_TASK_TAB_MOVE_TOP = T("В начало очереди");
+String LABEL_TASK_TAB_MOVE_BOTTOM = T("В конец очереди");
 }
@@ -36,6 +36,24 @@ extern String FILE_NOT_SAVED;
 
 extern String LABEL_PLAY;
 extern String LABEL_PAUSE;
+extern String LABEL_PLAY_REVERSE;
+extern String MENU_SHUTTLE;
+extern String LABEL_SHUTTLE_FORWARD;
+extern String LABEL_SHUTTLE_REVERSE;
+extern String LABEL_SHUTTLE_FORWARD_SLOW;
+extern String LABEL_SHUTTLE_REVERSE_SLOW;
+extern String LABEL_SHUTTLE_STOP;
+extern String MENU_PLAYBACK_STATISTICS;
+extern String MENU_EXPORT_PLAYBACK_STATISTICS;
+extern String MENU_SCALE_BENCHMARK;
+extern String DIALOG_CHOOSE_STATISTICS_TO_SAVE;
+extern String LABEL_FRAMES_PRESENTED;
+extern String LABEL_FRAMES_LATE;
+extern String LABEL_FRAMES_DROPPED;
+extern String LABEL_FRAMES_DECODED;
+extern String LABEL_DECODE_TIME;
+extern String LABEL_DECODE_TIME_AVERAGE;
+extern String LABEL_DECODE_TIME_MAX;
 
 extern String LABEL_STOP;
 extern String LABEL_NEXT_FRAME;
@@ -183,6 +201,7 @@ extern String LABEL_TASK_TAB_TYPE_PANORAMA;
 extern String LABEL_TASK_TAB_DESCRPTION;
 extern String LABEL_TASK_TAB_PROGRESS;
 extern String LABEL_TASK_TAB_TIME_LEFT;
+extern String LABEL_TASK_TAB_CORES;
 
 
 extern String LABEL_SAVE_VIDEO_SUSPENDED;
@@ -210,6 +229,58 @@ extern String LABEL_SAVE_VIDEO_ERROR_ENCODING_ALLOC_PICTURE;
 extern String LABEL_SAVE_VIDEO_ERROR_OPEN_AUDIO_CODEC;
 extern String LABEL_SAVE_VIDEO_PAUSED;
 extern String LABEL_SAVE_VIDEO_ERROR_OPEN_VIDEO_CODEC;
+extern String LABEL_RENDER_STAGE_DECODE;
+extern String LABEL_RENDER_STAGE_SCALE;
+extern String LABEL_RENDER_STAGE_ENCODE;
+extern String LABEL_RENDER_STAGE_MUX;
+extern String LABEL_RENDER_STAGE_STITCH;
+extern String LABEL_RENDER_STAGE_COPY;
+extern String LABEL_RENDER_STAGE_AUDIO;
+extern String LABEL_RENDER_STAGE_CACHE;
+extern String LABEL_RENDER_STAGE_OUTPUT;
+extern String LABEL_MEGABYTES_PER_SECOND;
+extern String LABEL_VIDEO_SAVE_SEGMENTS;
+extern String LABEL_VIDEO_SAVE_SEGMENTS_AUTO;
+extern String LABEL_VIDEO_SAVE_SEGMENTS_OFF;
+extern String LABEL_VIDEO_SAVE_SMART_RENDER;
+extern String LABEL_VIDEO_SAVE_PASS_CACHE;
+extern String LABEL_SAVE_VIDEO_ERROR_PASS_STATS;
+extern String LABEL_SAVE_VIDEO_ERROR_FRAME_CACHE;
+extern String LABEL_VIDEO_SAVE_SCALE_QUALITY;
+extern String LABEL_SCALE_QUALITY_FAST_BILINEAR;
+extern String LABEL_SCALE_QUALITY_BILINEAR;
+extern String LABEL_SCALE_QUALITY_BICUBIC;
+extern String LABEL_SCALE_QUALITY_LANCZOS;
+extern String LABEL_MILLISECONDS_PER_FRAME;
+extern String LABEL_SCALE_BENCHMARK_CONTEXT;
+extern String LABEL_VIDEO_SAVE_DEADLINE;
+extern String LABEL_VIDEO_SAVE_DEADLINE_OFF;
+extern String LABEL_VIDEO_SAVE_DEADLINE_MINUTES;
+extern String LABEL_DEADLINE_PRESET;
+extern String LABEL_DEADLINE_FORECAST;
+extern String LABEL_MEGABYTES;
+extern String LABEL_RENDER_STAGE_CALIBRATION;
+extern String LABEL_FRAMES_PER_SECOND;
+extern String LABEL_RENDER_QUEUES;
+extern String LABEL_RENDER_STAGE_FAN_OUT;
+extern String LABEL_VIDEO_SAVE_RENDITIONS;
+extern String LABEL_VIDEO_SAVE_RENDITIONS_OFF;
+extern String LABEL_ARENA_BENCHMARK;
+extern String LABEL_ARENA_BENCHMARK_PASSES;
+extern String LABEL_ARENA_BENCHMARK_SYSTEM;
+extern String LABEL_ARENA_BENCHMARK_ARENA;
+extern String LABEL_ARENA_BENCHMARK_PEAK;
+extern String LABEL_ARENA_BENCHMARK_REUSED;
+extern String LABEL_VIDEO_SAVE_CHUNKS;
+extern String LABEL_VIDEO_SAVE_CHUNKS_OFF;
+extern String LABEL_TASK_TAB_PRIORITY;
+extern String LABEL_TASK_PRIORITY_LOW;
+extern String LABEL_TASK_PRIORITY_NORMAL;
+extern String LABEL_TASK_PRIORITY_HIGH;
+extern String LABEL_TASK_TAB_MOVE_UP;
+extern String LABEL_TASK_TAB_MOVE_DOWN;
+extern String LABEL_TASK_TAB_MOVE_TOP;
+extern String LABEL_TASK_TAB_MOVE_BOTTOM;
 }
 
 
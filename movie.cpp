@@ -2,14 +2,18 @@
 #include "movie.h"
 #include "localization.h"
 #include "toolbox.h"
+#include "seekWorker.h"
 using namespace localization;
 Movie::Movie()
 {
     loaded = false;
+    abort_request = false;
+    worker = 0;
     image = new Image();
     bitmapData = 0;
     image_preview=new Image();
     info = 0;
+    decoder_threads = 1;
 };
 CriticalSection avcodec_critical;
 
@@ -120,6 +124,8 @@ bool Movie::Load(String &filename, bool soft)
     // Open codec
     {
         const ScopedLock myScopedLock (avcodec_critical);
+        if(decoder_threads>1)
+            avcodec_thread_init(pCodecCtx, decoder_threads);
         if(avcodec_open(pCodecCtx, pCodec)<0)
             return false; // Could not open codec
     }
@@ -187,6 +193,7 @@ Image * Movie::GeneratePreview()
     Image * res = new Image();
     int preview_width = 128;
     int preview_height = 96;
+    const ScopedLock image_lock (image_critical);
     *res = image->rescaled(preview_width,preview_height);
     return res;
 }
@@ -204,6 +211,11 @@ double Movie::ToSeconds(int internals)
 
 void Movie::Dispose()
 {
+    if(worker)
+    {
+        delete worker;
+        worker = 0;
+    }
     const ScopedLock myScopedLock (avcodec_critical);
     if(loaded)
     {
@@ -230,15 +242,21 @@ void Movie::Dispose()
         delete ByteIOCtx;
         if(info)
             delete info;
+        info = 0;
     }
 
 
-    if(image)
-        delete image;
-
-    //delete image_preview;
-    if(bitmapData)
-        delete bitmapData;
+    {
+        const ScopedLock image_lock (image_critical);
+        if(image)
+            delete image;
+        image = 0;
+
+        //delete image_preview;
+        if(bitmapData)
+            delete bitmapData;
+        bitmapData = 0;
+    }
 
     loaded = false;
 }
@@ -263,6 +281,11 @@ bool Movie::SeekToInternal(int frame)
     return false;
 }
 
+bool Movie::SeekToSecond(double dest)
+{
+    return SeekToInternal(ToInternalTime(dest));
+}
+
 int Movie::FindKeyFrame(double back, double dest, bool accurate)
 {
     int keyframe = -1;
@@ -277,7 +300,7 @@ int Movie::FindKeyFrame(double back, double dest, bool accurate)
     if(!res)return false;
 
     bool eof = false;
-    while(!eof)
+    while(!eof && !abort_request)
     {
         AVPacket* packet = ReadFrame();
         if(packet)
@@ -331,7 +354,7 @@ bool Movie::GotoSecondAndRead(double dest,bool decode, bool accurate)
     int found = -1;
 
     double back = 0.0;
-    while(found<0 && back<100.0)
+    while(found<0 && back<100.0 && !abort_request)
     {
         if(back>dest)
         {
@@ -352,6 +375,9 @@ bool Movie::GotoSecondAndRead(double dest,bool decode, bool accurate)
         DecodeFrame();
     }
 
+    if(abort_request)
+        return false;
+
     return (found>=0)?true:GotoSecondAndRead(0.);
 }
 
@@ -385,6 +411,19 @@ AVPacket* Movie::ReadFrame()
     return 0;
 }
 
+AVPacket* Movie::ReadPacket()
+{
+    AVPacket* packet=new AVPacket();
+    while ( av_read_frame( pFormatCtx, packet ) >= 0 )
+    {
+        if ( packet->stream_index == videoStream )
+            return packet;
+        av_free_packet(packet);
+    }
+    delete packet;
+    return 0;
+}
+
 bool Movie::ReadAndDecodeFrame()
 {
     AVPacket* packet = ReadFrame();
@@ -409,6 +448,21 @@ bool Movie::SkipFrame()
     return false;
 }
 
+bool Movie::DropFrame()
+{
+    AVPacket* packet = ReadPacket();
+    if(!packet)
+        return false;
+    int frameFinished = 0;
+    pCodecCtx->skip_frame = AVDISCARD_NONREF;
+    avcodec_decode_video2( pCodecCtx, pFrame, &frameFinished, packet);
+    pCodecCtx->skip_frame = AVDISCARD_DEFAULT;
+    current = ToSeconds(packet->dts - pStream->start_time);
+    av_free_packet(packet);
+    delete packet;
+    return true;
+}
+
 bool Movie::GoBack(int frames)
 {
     double frame = 1.0 / fps;
@@ -418,16 +472,23 @@ bool Movie::GoBack(int frames)
     if(guess<0.0)
         guess = 0.0;
     GotoSecondAndRead(guess,false);
-    while(desired - current > eps )
+    while(desired - current > eps && !abort_request)
     {
-        SkipFrame();
+        if(!SkipFrame())
+            break;
     }
-    return true;
+    return !abort_request;
 }
 
 void Movie::DecodeFrame()
 {
-    if(image->getHeight() != pCodecCtx->height || image->getWidth() != pCodecCtx->width)
+    ShowPicture((AVPicture *)pFrame);
+}
+
+void Movie::ShowPicture(AVPicture * picture)
+{
+    const ScopedLock image_lock (image_critical);
+    if(!image || image->getHeight() != pCodecCtx->height || image->getWidth() != pCodecCtx->width)
     {
         delete image;
         image = new Image(Image::RGB,pCodecCtx->width,pCodecCtx->height,true);
@@ -437,11 +498,34 @@ void Movie::DecodeFrame()
 
 
 
-    sws_scale (img_convert_ctx, pFrame->data, pFrame->linesize, 0, pCodecCtx->height,&bitmapData->data,pFrameRGB->linesize);
+    sws_scale (img_convert_ctx, picture->data, picture->linesize, 0, pCodecCtx->height,&bitmapData->data,pFrameRGB->linesize);
 
 
 }
 
+int Movie::PostRequest(SeekRequest * request)
+{
+    if(!worker)
+        worker = new SeekWorker(this);
+    return worker->Post(request);
+}
+
+bool Movie::CancelRequest(int id)
+{
+    return worker && worker->Cancel(id);
+}
+
+void Movie::CancelRequests(bool wait)
+{
+    if(worker)
+        worker->CancelAll(wait);
+}
+
+bool Movie::IsRequestPending()
+{
+    return worker && !worker->IsIdle();
+}
+
 Movie::Info* Movie::GetMovieInfo()
 {
     if(!loaded)return 0;
@@ -12,6 +12,8 @@ extern "C" {
 
 #include <vector>
 using namespace std;
+class SeekWorker;
+class SeekRequest;
 class Movie
 {
 private:
@@ -44,6 +46,9 @@ public:
 
     Image *image_preview;
     Image::BitmapData *bitmapData;
+    // image is reallocated and scaled into by the thread decoding the movie
+    // while the message thread paints it, both hold this lock
+    CriticalSection image_critical;
 
     double duration;
     double current;
@@ -58,6 +63,9 @@ public:
 
     double file_size;
 
+    // threads of the decoder, set before Load
+    int decoder_threads;
+
     Movie();
 
     int ToInternalTime(double seconds);
@@ -67,14 +75,29 @@ public:
     void Dispose();
     ~Movie();
     AVPacket* ReadFrame();
+    // next packet of the video stream, not decoded
+    AVPacket* ReadPacket();
     bool SkipFrame();
+    // passes the next frame, it is not decoded if no other frame refers to it.
+    // Picture of the movie is not the one of this frame then
+    bool DropFrame();
     void DecodeFrame();
+    void ShowPicture(AVPicture * picture);
+    bool SeekToSecond(double dest);
     bool ReadAndDecodeFrame();
     bool GotoRatioAndRead(double ratio,bool decode = true, bool accurate = true);
     bool GotoSecondAndRead(double dest,bool decode = true, bool accurate = true);
     bool GoBack(int frames);
     Image * GeneratePreview();
 
+    // Asynchronous requests, executed on the movie's own seek thread
+    volatile bool abort_request;
+    SeekWorker * worker;
+    int PostRequest(SeekRequest * request);
+    bool CancelRequest(int id);
+    void CancelRequests(bool wait = true);
+    bool IsRequestPending();
+
     class VideoInfo
     {
         public:
@@ -92,12 +115,30 @@ public:
         int gop;
         int compressionPreset;
         int pass;
-        VideoInfo(){}
+        // parts of the timeline encoded in parallel, 0 - one per processor core
+        int segments;
+        // parts of the sources matching the output are copied without re-encoding
+        bool smart_render;
+        // scaled pictures of the first pass are kept on disk for the second one
+        bool pass_cache;
+        // ScaleQuality of the pictures scaled to the output size
+        int scale_quality;
+        // seconds the export has to be finished in, the preset is chosen for it; 0 - no deadline
+        int deadline;
+        // seconds of the chunk files the output is cut into at the keyframes; 0 - one file
+        int chunk_duration;
+        VideoInfo(){pix_fmt = PIX_FMT_NONE;segments = 1;smart_render = false;pass_cache = false;scale_quality = 2;deadline = 0;chunk_duration = 0;}
         VideoInfo(const VideoInfo& copy_info)
         {
             this->is_bitrate_or_crf = copy_info.is_bitrate_or_crf;
             this->compressionPreset = copy_info.compressionPreset;
             this->pass = copy_info.pass;
+            this->segments = copy_info.segments;
+            this->smart_render = copy_info.smart_render;
+            this->pass_cache = copy_info.pass_cache;
+            this->scale_quality = copy_info.scale_quality;
+            this->deadline = copy_info.deadline;
+            this->chunk_duration = copy_info.chunk_duration;
             this->bit_rate = copy_info.bit_rate;
             this->gop = copy_info.gop;
             this->codec_tag = copy_info.codec_tag;
@@ -0,0 +1,328 @@
+#include "config.h"
+#include "outputWriter.h"
+#include "movie.h"
+#include "localization.h"
+#if JUCE_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+using namespace localization;
+
+OutputWriter::OutputWriter():Thread("render output thread")
+{
+    for(int i = 0; i<2; ++i)
+    {
+        blocks[i].memory = 0;
+        blocks[i].data = 0;
+        blocks[i].offset = 0;
+        blocks[i].filled = 0;
+    }
+    current = 0;
+    writing = 0;
+    position = 0;
+    size = 0;
+    failed = false;
+    opened = false;
+    bytes_written = 0;
+    write_millis = 0.0;
+    start_millis = 0.0;
+#if JUCE_LINUX
+    fd = -1;
+    direct_fd = -1;
+#else
+    fs = 0;
+#endif
+}
+
+OutputWriter::~OutputWriter()
+{
+    Close();
+    for(int i = 0; i<2; ++i)
+        delete [] blocks[i].memory;
+}
+
+bool OutputWriter::Open(const File & file, bool direct, int64 preallocate)
+{
+    for(int i = 0; i<2; ++i)
+    {
+        try
+        {
+            blocks[i].memory = new char[RENDER_OUTPUT_BUFFER + RENDER_OUTPUT_ALIGN];
+        }
+        catch(std::bad_alloc& ex)
+        {
+            return false;
+        }
+        // O_DIRECT wants the memory aligned as well as the offsets
+        blocks[i].data = blocks[i].memory + (RENDER_OUTPUT_ALIGN - (pointer_sized_int)blocks[i].memory % RENDER_OUTPUT_ALIGN) % RENDER_OUTPUT_ALIGN;
+    }
+
+    if(!OpenFile(file, direct, preallocate))
+        return false;
+
+    opened = true;
+    start_millis = Time::getMillisecondCounterHiRes();
+    startThread(THREAD_PRIORITY_ENCODE);
+    return true;
+}
+
+bool OutputWriter::OpenFile(const File & file, bool direct, int64 preallocate)
+{
+#if JUCE_LINUX
+    String path = file.getFullPathName();
+    fd = open(path.toUTF8(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        return false;
+    if(direct)
+        direct_fd = open(path.toUTF8(), O_WRONLY | O_DIRECT);
+    // blocks of the file are reserved, its size is not changed; the ones
+    // after the written bytes are given back when the file is closed
+    if(preallocate > 0)
+        fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, preallocate);
+#else
+    fs = file.createOutputStream();
+    if(!fs)
+        return false;
+#endif
+    return true;
+}
+
+void OutputWriter::CloseFile()
+{
+#if JUCE_LINUX
+    if(direct_fd >= 0)
+        close(direct_fd);
+    direct_fd = -1;
+    if(fd >= 0 && ftruncate(fd, size) != 0)
+        failed = true;
+    if(fd >= 0 && close(fd) != 0)
+        failed = true;
+    fd = -1;
+#else
+    if(fs)
+    {
+        fs->flush();
+        delete fs;
+    }
+    fs = 0;
+#endif
+}
+
+bool OutputWriter::Write(const void * data, int length)
+{
+    const char * source = (const char *)data;
+    while(length > 0)
+    {
+        Block & block = blocks[current];
+        int at = (int)(position - block.offset);
+        int part = jmin(length, RENDER_OUTPUT_BUFFER - at);
+        if(part <= 0)
+        {
+            if(!Submit())
+                return false;
+            continue;
+        }
+        memcpy(block.data + at, source, part);
+        source += part;
+        length -= part;
+        position += part;
+        block.filled = jmax(block.filled, at + part);
+        size = jmax(size, position);
+    }
+    return !failed;
+}
+
+int64 OutputWriter::Seek(int64 offset, int whence)
+{
+    int64 target = offset;
+    switch(whence)
+    {
+    case AVSEEK_SIZE:
+        return size;
+    case SEEK_CUR:
+        target = position + offset;
+        break;
+    case SEEK_END:
+        target = size + offset;
+        break;
+    }
+    if(target < 0)
+        return -1;
+
+    /* inside of the buffered data the position only moves */
+    Block & block = blocks[current];
+    if(target >= block.offset && target <= block.offset + block.filled)
+    {
+        position = target;
+        return target;
+    }
+    if(!Submit())
+        return -1;
+    position = target;
+    blocks[current].offset = target;
+    return target;
+}
+
+bool OutputWriter::Submit()
+{
+    Block & block = blocks[current];
+    if(block.filled == 0)
+    {
+        block.offset = position;
+        return !failed;
+    }
+    WaitWritten();
+    {
+        const ScopedLock myScopedLock (critical);
+        writing = &block;
+    }
+    submitted.signal();
+    current = 1 - current;
+    blocks[current].offset = position;
+    blocks[current].filled = 0;
+    return !failed;
+}
+
+void OutputWriter::WaitWritten()
+{
+    for(;;)
+    {
+        {
+            const ScopedLock myScopedLock (critical);
+            if(!writing || !isThreadRunning())
+                return;
+        }
+        written.wait(100);
+    }
+}
+
+bool OutputWriter::WriteBlock(const char * data, int64 offset, int length)
+{
+#if JUCE_LINUX
+    /* aligned part goes around the page cache, the tail and the unaligned
+       seek-back writes of the muxer through the usual descriptor */
+    if(direct_fd >= 0 && offset % RENDER_OUTPUT_ALIGN == 0)
+    {
+        int aligned = length - length % RENDER_OUTPUT_ALIGN;
+        if(aligned > 0 && pwrite(direct_fd, data, aligned, offset) == aligned)
+        {
+            data += aligned;
+            offset += aligned;
+            length -= aligned;
+        }
+    }
+    while(length > 0)
+    {
+        ssize_t res = pwrite(fd, data, length, offset);
+        if(res < 0 && errno == EINTR)
+            continue;
+        if(res <= 0)
+            return false;
+        data += res;
+        offset += res;
+        length -= (int)res;
+    }
+    return true;
+#else
+    return fs->setPosition(offset) && fs->write(data, length);
+#endif
+}
+
+void OutputWriter::run()
+{
+    while(!threadShouldExit())
+    {
+        Block * block;
+        {
+            const ScopedLock myScopedLock (critical);
+            block = writing;
+        }
+        if(!block)
+        {
+            submitted.wait(100);
+            continue;
+        }
+        double before = Time::getMillisecondCounterHiRes();
+        if(!WriteBlock(block->data, block->offset, block->filled))
+            failed = true;
+        {
+            const ScopedLock myScopedLock (critical);
+            write_millis += Time::getMillisecondCounterHiRes() - before;
+            bytes_written += block->filled;
+            writing = 0;
+        }
+        written.signal();
+    }
+}
+
+bool OutputWriter::Close()
+{
+    if(opened)
+    {
+        opened = false;
+        Submit();
+        WaitWritten();
+        signalThreadShouldExit();
+        submitted.signal();
+        waitForThreadToExit(-1);
+    }
+    CloseFile();
+    return !failed;
+}
+
+bool OutputWriter::Next(const File & file, bool direct, int64 preallocate)
+{
+    if(!opened)
+        return false;
+    // the writer thread has nothing left of the finished file
+    Submit();
+    WaitWritten();
+    CloseFile();
+    if(failed)
+        return false;
+    position = 0;
+    size = 0;
+    blocks[current].offset = 0;
+    blocks[current].filled = 0;
+    return OpenFile(file, direct, preallocate);
+}
+
+double OutputWriter::GetThroughput()
+{
+    const ScopedLock myScopedLock (critical);
+    if(write_millis <= 0.0)
+        return 0.0;
+    return (double)bytes_written / (1024.0 * 1024.0) / (write_millis / 1000.0);
+}
+
+double OutputWriter::GetUtilisation()
+{
+    const ScopedLock myScopedLock (critical);
+    double running = Time::getMillisecondCounterHiRes() - start_millis;
+    if(running <= 0.0)
+        return 0.0;
+    return jlimit(0.0, 1.0, write_millis / running);
+}
+
+int64 OutputWriter::GetBytesWritten()
+{
+    const ScopedLock myScopedLock (critical);
+    return bytes_written;
+}
+
+double OutputWriter::GetWriteMillis()
+{
+    const ScopedLock myScopedLock (critical);
+    return write_millis;
+}
+
+double OutputWriter::GetRunningMillis()
+{
+    return Time::getMillisecondCounterHiRes() - start_millis;
+}
+
+String OutputWriter::PrintThroughput()
+{
+    return LABEL_RENDER_STAGE_OUTPUT + " " + String((int)(GetUtilisation() * 100.0 + 0.5)) + "% " + String(GetThroughput(), 1) + " " + LABEL_MEGABYTES_PER_SECOND;
+}
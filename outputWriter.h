@@ -0,0 +1,77 @@
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+#include "juce/juce.h"
+
+// Output file of the render. The muxer writes into a large aligned buffer
+// and a full buffer goes to the writer thread while the other one is filled.
+// Every buffer remembers its offset in the file, so the seek-back writes of
+// the headers and the trailers land where the muxer wants them
+class OutputWriter : public Thread
+{
+    private:
+    class Block
+    {
+        public:
+        char * memory;
+        char * data;
+        int64 offset;
+        int filled;
+    };
+    Block blocks[2];
+    // block filled by the muxer
+    int current;
+    // block given to the writer thread, 0 when it is free
+    Block * writing;
+    CriticalSection critical;
+    WaitableEvent submitted;
+    WaitableEvent written;
+    int64 position;
+    int64 size;
+    bool failed;
+    bool opened;
+
+    int64 bytes_written;
+    double write_millis;
+    double start_millis;
+
+#if JUCE_LINUX
+    int fd;
+    // descriptor opened with O_DIRECT for the aligned parts, -1 if not used
+    int direct_fd;
+#else
+    FileOutputStream * fs;
+#endif
+
+    bool Submit();
+    void WaitWritten();
+    bool WriteBlock(const char * data, int64 offset, int length);
+    bool OpenFile(const File & file, bool direct, int64 preallocate);
+    void CloseFile();
+
+    public:
+    OutputWriter();
+    ~OutputWriter();
+    // preallocate - expected size of the file in bytes, 0 if unknown
+    bool Open(const File & file, bool direct, int64 preallocate);
+    bool Write(const void * data, int length);
+    // whence as in ByteIOContext, AVSEEK_SIZE returns the size of the file
+    int64 Seek(int64 offset, int whence);
+    // writes the rest and closes the file, false if any write has failed
+    bool Close();
+    // the file is finished as by Close and the writes go on to the next one
+    // from its start, the measures count both
+    bool Next(const File & file, bool direct, int64 preallocate);
+
+    // megabytes per second while the writer thread was writing
+    double GetThroughput();
+    // part of the time the writer thread was writing, from 0 to 1
+    double GetUtilisation();
+    String PrintThroughput();
+    int64 GetBytesWritten();
+    double GetWriteMillis();
+    double GetRunningMillis();
+
+    void run();
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "config.h"
+#include "playbackClock.h"
+#include "localization.h"
+using namespace localization;
+
+PlaybackClock::PlaybackClock()
+{
+    start_millis = -1.0;
+    start_second = 0.0;
+    speed = 1.0;
+    tolerance = 0.02;
+    Reset();
+}
+
+void PlaybackClock::Start(double second, double speed, double fps)
+{
+    start_millis = Time::getMillisecondCounterHiRes();
+    start_second = second;
+    this->speed = speed;
+    tolerance = 0.5 / fps;
+}
+
+void PlaybackClock::Stop()
+{
+    start_millis = -1.0;
+}
+
+bool PlaybackClock::IsStarted()
+{
+    return start_millis >= 0.0;
+}
+
+double PlaybackClock::GetSecond()
+{
+    if(!IsStarted())
+        return start_second;
+    return start_second + speed * (Time::getMillisecondCounterHiRes() - start_millis) / 1000.0;
+}
+
+double PlaybackClock::GetMillis(double second)
+{
+    return start_millis + (second - start_second) / speed * 1000.0;
+}
+
+void PlaybackClock::Reset()
+{
+    const ScopedLock myScopedLock (critical);
+    presented = 0;
+    late = 0;
+    dropped = 0;
+    for(int i = 0; i<HistogramSize; ++i)
+        histogram[i] = 0;
+    decoded = 0;
+    decode_millis = 0.0;
+    decode_max = 0.0;
+}
+
+void PlaybackClock::FramePresented(double second)
+{
+    double behind = (GetSecond() - second) * ((speed>0.0)?1.0:-1.0);
+    const ScopedLock myScopedLock (critical);
+    presented++;
+    if(behind > tolerance)
+        late++;
+}
+
+void PlaybackClock::FramesDropped(int count)
+{
+    const ScopedLock myScopedLock (critical);
+    dropped += count;
+}
+
+void PlaybackClock::AddDecodeTime(double millis)
+{
+    int bucket = 0;
+    while(bucket < HistogramSize - 1 && millis >= GetBucketStart(bucket + 1))
+        bucket++;
+
+    const ScopedLock myScopedLock (critical);
+    histogram[bucket]++;
+    decoded++;
+    decode_millis += millis;
+    if(millis > decode_max)
+        decode_max = millis;
+}
+
+double PlaybackClock::GetBucketStart(int bucket)
+{
+    if(bucket==0)
+        return 0.0;
+    return (double)(1 << (bucket - 1));
+}
+
+String PlaybackClock::PrintStatistics()
+{
+    const ScopedLock myScopedLock (critical);
+    String text;
+    text<<"["<<LABEL_FRAMES_PRESENTED<<"] "<<presented<<"\n";
+    text<<"["<<LABEL_FRAMES_LATE<<"] "<<late<<"\n";
+    text<<"["<<LABEL_FRAMES_DROPPED<<"] "<<dropped<<"\n";
+    text<<"["<<LABEL_FRAMES_DECODED<<"] "<<(int)decoded<<"\n";
+    if(decoded)
+    {
+        text<<"["<<LABEL_DECODE_TIME_AVERAGE<<"] "<<String(decode_millis / decoded, 2)<<" "<<LABEL_MINI_SECONDS<<"\n";
+        text<<"["<<LABEL_DECODE_TIME_MAX<<"] "<<String(decode_max, 2)<<" "<<LABEL_MINI_SECONDS<<"\n";
+    }
+    text<<"\n"<<LABEL_DECODE_TIME<<"\n";
+
+    int64 max_count = 1;
+    for(int i = 0; i<HistogramSize; ++i)
+        max_count = jmax(max_count, histogram[i]);
+    for(int i = 0; i<HistogramSize; ++i)
+    {
+        String range;
+        if(i == HistogramSize - 1)
+            range<<">= "<<(int)GetBucketStart(i);
+        else
+            range<<(int)GetBucketStart(i)<<" - "<<(int)GetBucketStart(i + 1);
+        text<<"   "<<range.paddedRight(' ', 10)<<String((int)histogram[i]).paddedLeft(' ', 8)<<"  ";
+        text<<String::repeatedString("|", (int)(histogram[i] * 40 / max_count))<<"\n";
+    }
+    return text;
+}
+
+bool PlaybackClock::ExportStatistics(const File & file)
+{
+    String text;
+    {
+        const ScopedLock myScopedLock (critical);
+        text<<"presented;"<<presented<<"\n";
+        text<<"late;"<<late<<"\n";
+        text<<"dropped;"<<dropped<<"\n";
+        text<<"decoded;"<<(int)decoded<<"\n";
+        text<<"decode_ms_total;"<<String(decode_millis, 3)<<"\n";
+        text<<"decode_ms_max;"<<String(decode_max, 3)<<"\n";
+        text<<"bucket_ms_from;bucket_ms_to;frames\n";
+        for(int i = 0; i<HistogramSize; ++i)
+        {
+            text<<(int)GetBucketStart(i)<<";";
+            if(i < HistogramSize - 1)
+                text<<(int)GetBucketStart(i + 1);
+            text<<";"<<(int)histogram[i]<<"\n";
+        }
+    }
+    if(file.existsAsFile() && !file.deleteFile())
+        return false;
+    return file.replaceWithText(text);
+}
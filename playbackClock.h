@@ -0,0 +1,53 @@
+#ifndef PLAYBACK_CLOCK_H
+#define PLAYBACK_CLOCK_H
+#include "juce/juce.h"
+
+// Master clock of the playback. Position is computed from the monotonic
+// millisecond counter, so slow decoding never shifts the timeline: frames
+// which are late are skipped and counted instead.
+class PlaybackClock
+{
+    private:
+    CriticalSection critical;
+    double start_millis;
+    double start_second;
+    double speed;
+    // half of the frame duration
+    double tolerance;
+
+    public:
+    enum
+    {
+        // decode time buckets: <1, <2, <4 ... <256, >=256 milliseconds
+        HistogramSize = 10
+    };
+    int presented;
+    int late;
+    int dropped;
+    int64 histogram[HistogramSize];
+    int64 decoded;
+    double decode_millis;
+    double decode_max;
+
+    PlaybackClock();
+    void Start(double second, double speed, double fps);
+    void Stop();
+    bool IsStarted();
+    // timeline second which has to be shown now
+    double GetSecond();
+    // value of the millisecond counter when the timeline second has to be shown
+    double GetMillis(double second);
+
+    void Reset();
+    // frame of the timeline second was shown, it is late if the clock has passed it
+    void FramePresented(double second);
+    void FramesDropped(int count);
+    // may be called from decoding threads
+    void AddDecodeTime(double millis);
+
+    static double GetBucketStart(int bucket);
+    String PrintStatistics();
+    bool ExportStatistics(const File & file);
+};
+
+#endif
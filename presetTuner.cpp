@@ -0,0 +1,168 @@
+#include "config.h"
+#include "presetTuner.h"
+#include "localization.h"
+#include "toolbox.h"
+using namespace localization;
+
+String GetCompressionPresetName(int preset)
+{
+    switch(preset)
+    {
+    case 1:
+        return LABEL_VIDEO_SAVE_COMPRESSION_PLACEBO;
+    case 2:
+        return LABEL_VIDEO_SAVE_COMPRESSION_VERYSLOW;
+    case 3:
+        return LABEL_VIDEO_SAVE_COMPRESSION_SLOWER;
+    case 4:
+        return LABEL_VIDEO_SAVE_COMPRESSION_SLOW;
+    case 5:
+        return LABEL_VIDEO_SAVE_COMPRESSION_MEDIUM;
+    case 6:
+        return LABEL_VIDEO_SAVE_COMPRESSION_FAST;
+    case 7:
+        return LABEL_VIDEO_SAVE_COMPRESSION_FASTER;
+    case 8:
+        return LABEL_VIDEO_SAVE_COMPRESSION_VERYFAST;
+    case 9:
+        return LABEL_VIDEO_SAVE_COMPRESSION_SUPERFAST;
+    default:
+        return LABEL_VIDEO_SAVE_COMPRESSION_ULTRAFAST;
+    }
+}
+
+PresetTuner::PresetTuner()
+{
+    deadline = 0.0;
+    start_millis = 0.0;
+    decode_fps = 0.0;
+    decoders = 1;
+    encoders = 1.0;
+    correction = 1.0;
+    preset = -1;
+    frames = 0;
+    forecast = 0.0;
+    window_frames = 0;
+    window_millis = 0.0;
+}
+
+void PresetTuner::Start(double deadline)
+{
+    this->deadline = deadline;
+    start_millis = Time::getMillisecondCounterHiRes();
+}
+
+bool PresetTuner::IsEnabled()
+{
+    return deadline > 0.0;
+}
+
+void PresetTuner::AddSample(int preset, double fps, double bytes_per_frame)
+{
+    if(fps <= 0.0)
+        return;
+    Sample sample;
+    sample.preset = preset;
+    sample.fps = fps;
+    sample.bytes_per_frame = bytes_per_frame;
+    samples.push_back(sample);
+}
+
+void PresetTuner::SetSpeed(double decode_fps, int decoders, double encoders)
+{
+    this->decode_fps = decode_fps;
+    this->decoders = jmax(1, decoders);
+    this->encoders = jmax(1.0, encoders);
+}
+
+const PresetTuner::Sample * PresetTuner::Find(int preset)
+{
+    for(vector<Sample>::iterator it = samples.begin(); it!=samples.end(); it++)
+    {
+        if(it->preset == preset)
+            return &(*it);
+    }
+    return 0;
+}
+
+double PresetTuner::GetFps(const Sample & sample)
+{
+    double fps = sample.fps * encoders;
+    // pictures are not encoded faster than they are decoded
+    if(decode_fps > 0.0)
+        fps = jmin(fps, decode_fps * decoders);
+    return fps * correction;
+}
+
+double PresetTuner::GetElapsed()
+{
+    return (Time::getMillisecondCounterHiRes() - start_millis) / 1000.0;
+}
+
+/* slowest preset, the one which compresses best, whose forecast fits into
+   the time left. First pass of two goes about as fast as the fastest preset */
+int PresetTuner::Choose(int64 frames_left, int passes)
+{
+    if(samples.empty())
+        return preset;
+    const Sample * fastest = &samples[0];
+    for(vector<Sample>::iterator it = samples.begin(); it!=samples.end(); it++)
+    {
+        if(it->preset > fastest->preset)
+            fastest = &(*it);
+    }
+    double first_pass = (passes > 1)?(double)frames_left / GetFps(*fastest):0.0;
+    double time_left = (deadline - GetElapsed()) * RENDER_DEADLINE_MARGIN;
+
+    const Sample * chosen = fastest;
+    for(vector<Sample>::iterator it = samples.begin(); it!=samples.end(); it++)
+    {
+        if(it->preset >= chosen->preset)
+            continue;
+        if(first_pass + (double)frames_left / GetFps(*it) <= time_left)
+            chosen = &(*it);
+    }
+    forecast = GetElapsed() + first_pass + (double)frames_left / GetFps(*chosen);
+    return chosen->preset;
+}
+
+int PresetTuner::ChoosePreset(int64 frames, int passes)
+{
+    this->frames = frames;
+    preset = Choose(frames, passes);
+    window_frames = 0;
+    window_millis = Time::getMillisecondCounterHiRes();
+    return preset;
+}
+
+int PresetTuner::Update(int64 done)
+{
+    const Sample * current = Find(preset);
+    double now = Time::getMillisecondCounterHiRes();
+    if(!current || now - window_millis < RENDER_DEADLINE_CHECK * 1000.0 || done <= window_frames)
+        return preset;
+
+    /* speed since the last check against the forecast one */
+    double fps = (double)(done - window_frames) * 1000.0 / (now - window_millis);
+    correction = jlimit(0.1, 10.0, correction * fps / GetFps(*current));
+    window_frames = done;
+    window_millis = now;
+
+    preset = Choose(jmax((int64)0, frames - done), 1);
+    return preset;
+}
+
+int PresetTuner::GetPreset()
+{
+    return preset;
+}
+
+String PresetTuner::Print()
+{
+    String res = LABEL_DEADLINE_PRESET + " " + GetCompressionPresetName(preset);
+    res += ", " + LABEL_DEADLINE_FORECAST + " " + toolbox::format_duration(forecast) + " / " + toolbox::format_duration(deadline);
+    const Sample * current = Find(preset);
+    if(current)
+        res += ", ~" + String((int)(current->bytes_per_frame * frames / (1024.0 * 1024.0) + 0.5)) + " " + LABEL_MEGABYTES;
+    return res;
+}
@@ -0,0 +1,63 @@
+#ifndef PRESET_TUNER_H
+#define PRESET_TUNER_H
+#include "juce/juce.h"
+#include <vector>
+using namespace std;
+
+// Compression preset of an export that has to be finished in time. Samples
+// of the timeline are encoded with a few presets first, the slowest preset
+// whose forecast still meets the deadline is taken. Speed of the render is
+// checked as it goes, when it drifts away from the measured one the preset
+// of the parts not started yet is chosen again
+class PresetTuner
+{
+    private:
+    class Sample
+    {
+        public:
+        int preset;
+        // frames per second of one calibration encoder
+        double fps;
+        double bytes_per_frame;
+    };
+    vector<Sample> samples;
+    // seconds given to the export, 0 if there is no deadline
+    double deadline;
+    double start_millis;
+    double decode_fps;
+    int decoders;
+    double encoders;
+    // measured speed of the render against the forecast one
+    double correction;
+    int preset;
+    int64 frames;
+    double forecast;
+    int64 window_frames;
+    double window_millis;
+
+    const Sample * Find(int preset);
+    double GetFps(const Sample & sample);
+    double GetElapsed();
+    int Choose(int64 frames_left, int passes);
+
+    public:
+    PresetTuner();
+    // starts the clock of the deadline in seconds
+    void Start(double deadline);
+    bool IsEnabled();
+    void AddSample(int preset, double fps, double bytes_per_frame);
+    // decode_fps - pictures per second of one decoder, decoders - decoders
+    // working at once, encoders - how many calibration encoders the whole
+    // render is worth
+    void SetSpeed(double decode_fps, int decoders, double encoders);
+    // preset for the whole timeline, passes - 1 or 2
+    int ChoosePreset(int64 frames, int passes);
+    // done - frames already encoded, the preset for the parts not started yet
+    int Update(int64 done);
+    int GetPreset();
+    String Print();
+};
+
+String GetCompressionPresetName(int preset);
+
+#endif
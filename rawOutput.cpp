@@ -0,0 +1,230 @@
+#include "config.h"
+#include "rawOutput.h"
+#include <stdio.h>
+#if JUCE_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/uio.h>
+#endif
+#if JUCE_WINDOWS
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+RawOutput::RawOutput()
+{
+#if JUCE_LINUX
+    fd = -1;
+#else
+    file = 0;
+#endif
+    is_stdout = false;
+    failed = false;
+    bytes_written = 0;
+    write_micros = 0;
+    start_millis = 0.0;
+}
+
+RawOutput::~RawOutput()
+{
+    Close();
+}
+
+bool RawOutput::Open(const String & filename, Thread * thread)
+{
+    is_stdout = filename == "-";
+    failed = false;
+    bytes_written = 0;
+    write_micros = 0;
+    start_millis = Time::getMillisecondCounterHiRes();
+#if JUCE_LINUX
+    if(is_stdout)
+    {
+        fd = STDOUT_FILENO;
+        return true;
+    }
+    // without the reader the pipe is not opened, the writes block after it
+    fd = open(filename.toUTF8(), O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 0644);
+    while(fd < 0 && errno == ENXIO && !(thread && thread->threadShouldExit()))
+    {
+        Thread::sleep(50);
+        fd = open(filename.toUTF8(), O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 0644);
+    }
+    if(fd >= 0)
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    return fd >= 0;
+#else
+    if(is_stdout)
+    {
+#if JUCE_WINDOWS
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        file = stdout;
+    }
+    else
+        file = fopen(filename.toUTF8(), "wb");
+    // without the buffer of the library the planes go to the system as they are
+    if(file)
+        setvbuf(file, 0, _IONBF, 0);
+    return file != 0;
+#endif
+}
+
+/* parts are written with one call where the system allows it, a partial
+   write of a pipe goes on from where it stopped. SIGPIPE is blocked for the
+   thread while it writes and taken back after EPIPE, the handling of the
+   process is left as it is */
+bool RawOutput::WriteParts(const void ** parts, const int * lengths, int count)
+{
+    if(failed)
+        return false;
+    double before = Time::getMillisecondCounterHiRes();
+#if JUCE_LINUX
+    struct iovec vectors[8];
+    int vector_count = 0;
+    for(int i = 0; i<count && i<8; ++i)
+    {
+        vectors[vector_count].iov_base = (void *)parts[i];
+        vectors[vector_count].iov_len = lengths[i];
+        if(lengths[i] > 0)
+            vector_count++;
+    }
+    sigset_t pipe_signal, old_signals;
+    sigemptyset(&pipe_signal);
+    sigaddset(&pipe_signal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_signal, &old_signals);
+    struct iovec * current = vectors;
+    while(vector_count > 0)
+    {
+        ssize_t written = writev(fd, current, vector_count);
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno == EPIPE)
+            {
+                struct timespec no_wait = {0, 0};
+                sigtimedwait(&pipe_signal, 0, &no_wait);
+            }
+            failed = true;
+            break;
+        }
+        bytes_written += written;
+        while(vector_count > 0 && written >= (ssize_t)current->iov_len)
+        {
+            written -= current->iov_len;
+            current++;
+            vector_count--;
+        }
+        if(vector_count > 0)
+        {
+            current->iov_base = (char *)current->iov_base + written;
+            current->iov_len -= written;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old_signals, 0);
+#else
+    for(int i = 0; i<count && !failed; ++i)
+    {
+        if(lengths[i] > 0 && fwrite(parts[i], 1, lengths[i], file) != (size_t)lengths[i])
+            failed = true;
+        else
+            bytes_written += lengths[i];
+    }
+#endif
+    write_micros += (int64)((Time::getMillisecondCounterHiRes() - before) * 1000.0);
+    return !failed;
+}
+
+bool RawOutput::Write(const void * data, int length)
+{
+    return WriteParts(&data, &length, 1);
+}
+
+bool RawOutput::WritePicture(const AVPicture * picture, int width, int height)
+{
+    static const char frame_header[] = "FRAME\n";
+    const void * parts[4];
+    int lengths[4];
+    parts[0] = frame_header;
+    lengths[0] = sizeof(frame_header) - 1;
+    bool contiguous = true;
+    for(int plane = 0; plane<3; ++plane)
+    {
+        int plane_width = (plane==0)?width:width / 2;
+        int plane_height = (plane==0)?height:height / 2;
+        parts[plane + 1] = picture->data[plane];
+        lengths[plane + 1] = plane_width * plane_height;
+        if(picture->linesize[plane] != plane_width)
+            contiguous = false;
+    }
+    if(contiguous)
+        return WriteParts(parts, lengths, 4);
+
+    // rows with padding are written one by one
+    if(!Write(frame_header, lengths[0]))
+        return false;
+    for(int plane = 0; plane<3; ++plane)
+    {
+        int plane_width = (plane==0)?width:width / 2;
+        int plane_height = (plane==0)?height:height / 2;
+        for(int row = 0; row<plane_height; ++row)
+        {
+            if(!Write(picture->data[plane] + row * picture->linesize[plane], plane_width))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool RawOutput::Close()
+{
+#if JUCE_LINUX
+    if(fd >= 0 && !is_stdout && close(fd) != 0)
+        failed = true;
+    fd = -1;
+#else
+    if(file && !is_stdout && fclose(file) != 0)
+        failed = true;
+    else if(file && is_stdout)
+        fflush(file);
+    file = 0;
+#endif
+    return !failed;
+}
+
+int64 RawOutput::GetBytesWritten()
+{
+    return bytes_written.get();
+}
+
+double RawOutput::GetWriteMillis()
+{
+    return (double)write_micros.get() / 1000.0;
+}
+
+double RawOutput::GetRunningMillis()
+{
+    return Time::getMillisecondCounterHiRes() - start_millis;
+}
+
+bool IsRawOutput(const Movie::Info & info)
+{
+    return info.format_short == "y4m";
+}
+
+String GetRawAudioFilename(const Movie::Info & info)
+{
+    if(info.filename == "-")
+        return String::empty;
+    return File(info.filename).withFileExtension("pcm").getFullPathName();
+}
+
+String GetY4mHeader(int width, int height, AVRational fps)
+{
+    return "YUV4MPEG2 W" + String(width) + " H" + String(height) + " F" + String(fps.num) + ":" + String(fps.den) + " Ip A1:1 C420jpeg\n";
+}
@@ -0,0 +1,50 @@
+#ifndef RAW_OUTPUT_H
+#define RAW_OUTPUT_H
+#include "movie.h"
+
+// Uncompressed output for the encoders outside of the editor: pictures as a
+// YUV4MPEG2 stream and sound as interleaved 16 bit samples, written to a
+// file, a named pipe or the standard output. Planes of the pictures are
+// written from where they are. A write blocks while the reader is behind,
+// so the stage writing waits and the queues before it stop the decoders.
+// A reader gone away fails the write, SIGPIPE is not raised for it
+class RawOutput
+{
+    private:
+#if JUCE_LINUX
+    int fd;
+#else
+    FILE * file;
+#endif
+    bool is_stdout;
+    bool failed;
+    // written by the thread writing, read by the render for its progress
+    Atomic<int64> bytes_written;
+    Atomic<int64> write_micros;
+    double start_millis;
+
+    bool WriteParts(const void ** parts, const int * lengths, int count);
+
+    public:
+    RawOutput();
+    ~RawOutput();
+    // "-" is the standard output. A named pipe waits for its reader until
+    // the thread is asked to exit
+    bool Open(const String & filename, Thread * thread = 0);
+    bool Write(const void * data, int length);
+    // frame of the YUV4MPEG2 stream, the picture is 4:2:0
+    bool WritePicture(const AVPicture * picture, int width, int height);
+    bool Close();
+
+    int64 GetBytesWritten();
+    double GetWriteMillis();
+    double GetRunningMillis();
+};
+
+// the output is the YUV4MPEG2 stream instead of a file of libavformat
+bool IsRawOutput(const Movie::Info & info);
+// samples go next to the pictures with the .pcm extension, empty for the standard output
+String GetRawAudioFilename(const Movie::Info & info);
+String GetY4mHeader(int width, int height, AVRational fps);
+
+#endif
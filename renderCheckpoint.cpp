@@ -0,0 +1,110 @@
+#include "config.h"
+#include "renderCheckpoint.h"
+
+RenderCheckpoint::RenderCheckpoint()
+{
+    enabled = false;
+}
+
+/* journal starts with the signature, then a line per finished segment:
+   first frame, frames count, frames written, size of the file and 1 if the
+   segment is complete or 0 if it was drained before its end */
+bool RenderCheckpoint::Open(const File & output, const String & signature)
+{
+    entries.clear();
+    enabled = false;
+    directory = output.getSiblingFile(output.getFileName() + ".checkpoint");
+    journal = directory.getChildFile("journal.txt");
+    String header = "signature " + String::toHexString(signature.hashCode64());
+
+    StringArray lines;
+    if(journal.existsAsFile())
+        lines.addLines(journal.loadFileAsString());
+    if(lines.size()==0 || lines[0].trim() != header)
+    {
+        // segments of another render or of the other settings
+        directory.deleteRecursively();
+        lines.clear();
+    }
+    if(!directory.createDirectory())
+        return false;
+    if(lines.size()==0 && !journal.replaceWithText(header + "\n"))
+        return false;
+
+    for(int i = 1; i<lines.size(); ++i)
+    {
+        StringArray tokens;
+        tokens.addTokens(lines[i], " ", String::empty);
+        if(tokens.size()!=5)
+            continue;
+        Entry entry;
+        entry.first = tokens[0].getLargeIntValue();
+        entry.count = tokens[1].getLargeIntValue();
+        entry.frames = tokens[2].getLargeIntValue();
+        entry.size = tokens[3].getLargeIntValue();
+        entry.complete = tokens[4].getIntValue() != 0;
+        // the file is checked too, it could be written only partly
+        if(GetSegmentFile(entry.first, entry.count).getSize() == entry.size)
+            entries.push_back(entry);
+    }
+    enabled = true;
+    return true;
+}
+
+bool RenderCheckpoint::IsEnabled()
+{
+    return enabled;
+}
+
+File RenderCheckpoint::GetSegmentFile(int64 first, int64 count)
+{
+    return directory.getChildFile(String(first) + "_" + String(count) + ".segment");
+}
+
+const RenderCheckpoint::Entry * RenderCheckpoint::Find(int64 first, int64 count)
+{
+    for(vector<Entry>::iterator it = entries.begin(); it!=entries.end(); it++)
+    {
+        if(it->first == first && it->count == count)
+            return &(*it);
+    }
+    return 0;
+}
+
+int64 RenderCheckpoint::GetFinishedFrames(int64 first, int64 count, bool & complete)
+{
+    const Entry * entry = Find(first, count);
+    complete = entry && entry->complete;
+    return (entry)?entry->frames:-1;
+}
+
+bool RenderCheckpoint::AddFinished(int64 first, int64 count, int64 frames, bool complete)
+{
+    if(!enabled || Find(first, count))
+        return false;
+    Entry entry;
+    entry.first = first;
+    entry.count = count;
+    entry.frames = frames;
+    entry.size = GetSegmentFile(first, count).getSize();
+    entry.complete = complete;
+    String line;
+    line<<String(first)<<" "<<String(count)<<" "<<String(frames)<<" "<<String(entry.size)<<" "<<(complete?"1":"0")<<"\n";
+    if(!journal.appendText(line))
+        return false;
+    entries.push_back(entry);
+    return true;
+}
+
+int RenderCheckpoint::GetFinishedCount()
+{
+    return (int)entries.size();
+}
+
+void RenderCheckpoint::Remove()
+{
+    if(enabled)
+        directory.deleteRecursively();
+    entries.clear();
+    enabled = false;
+}
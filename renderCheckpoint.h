@@ -0,0 +1,47 @@
+#ifndef RENDER_CHECKPOINT_H
+#define RENDER_CHECKPOINT_H
+#include "juce/juce.h"
+#include <vector>
+using namespace std;
+
+// Finished segments of a render. Every segment begins with a keyframe of its
+// own encoder, so it does not depend on the others. Segments are kept in a
+// directory next to the output and written down in a journal as they are
+// finished. A render of the same timeline with the same settings started
+// after an interruption stitches them instead of encoding them again
+class RenderCheckpoint
+{
+    private:
+    class Entry
+    {
+        public:
+        int64 first;
+        int64 count;
+        int64 frames;
+        int64 size;
+        // false if the segment was drained by a suspension before its end
+        bool complete;
+    };
+    vector<Entry> entries;
+    File directory;
+    File journal;
+    bool enabled;
+
+    const Entry * Find(int64 first, int64 count);
+
+    public:
+    RenderCheckpoint();
+    // output - file being rendered, signature - everything the encoded
+    // packets depend on, segments of another signature are thrown away
+    bool Open(const File & output, const String & signature);
+    bool IsEnabled();
+    File GetSegmentFile(int64 first, int64 count);
+    // frames of the finished segment, -1 if it has to be encoded
+    int64 GetFinishedFrames(int64 first, int64 count, bool & complete);
+    bool AddFinished(int64 first, int64 count, int64 frames, bool complete);
+    int GetFinishedCount();
+    // the output is complete, the segments are not needed anymore
+    void Remove();
+};
+
+#endif
@@ -0,0 +1,300 @@
+#include "config.h"
+#include "timeline.h"
+#include "tasks.h"
+#include "rawOutput.h"
+#include <csignal>
+#include <cstdio>
+
+/* Renders a job without windows: the sources and their parts, the settings
+   of the output and of the renditions are read from an xml file
+
+   <render output="out.mp4" format="mp4">
+       <video codec="libx264" width="1280" height="720" fps="25" bitrate="2000"
+              gop="12" preset="medium" pass="1" segments="0" deadline="0" chunk="0"/>
+       <audio codec="libfaac" bitrate="128" sample_rate="44100" channels="2"/>
+       <source file="a.avi" start="10" end="20"/>
+       <source file="b.avi"/>
+       <rendition output="out_480p.mp4" width="854" height="480"/>
+   </render>
+
+   crf="23" instead of bitrate encodes with constant quality, chunk="6" cuts
+   the output into files of six seconds listed in an m3u8 playlist; with
+   smart_render a copied part of a source is cut at its own keyframes, so
+   its chunks may be longer. End of a
+   source may be left out to take it to its end. Relative paths are taken
+   from the directory of the job. format="y4m" writes the pictures uncompressed for
+   an encoder outside of the editor and the samples next to them as .pcm,
+   output="-" is the standard output. Progress is written to stdout line by
+   line, to stderr when the stdout takes the pictures:
+
+   progress 0.4213 eta 95
+   done | error <message> | interrupted */
+
+enum ExitCode
+{
+    ExitDone = 0,
+    ExitUsage = 1,
+    ExitBadJob = 2,
+    ExitCantLoadSource = 3,
+    ExitRenderFailed = 4,
+    ExitInterrupted = 5
+};
+
+static volatile sig_atomic_t interrupted = 0;
+static FILE * progress_stream = stdout;
+
+void _OnInterrupt(int)
+{
+    interrupted = 1;
+}
+
+static void print_line(const String & line)
+{
+    fprintf(progress_stream, "%s\n", (const char *)line.toUTF8());
+    fflush(progress_stream);
+}
+
+static const char * preset_names[] = {"placebo", "veryslow", "slower", "slow", "medium", "fast", "faster", "veryfast", "superfast", "ultrafast"};
+
+static int get_preset(const String & name)
+{
+    for(int i = 0; i<10; ++i)
+    {
+        if(name.equalsIgnoreCase(preset_names[i]))
+            return i + 1;
+    }
+    return -1;
+}
+
+// the raw output needs neither the codecs nor the bit rates
+static bool read_video(XmlElement * video, bool raw, Movie::VideoInfo & video_info, String & error)
+{
+    video_info.codec_short = video->getStringAttribute("codec");
+    video_info.width = video->getIntAttribute("width");
+    video_info.height = video->getIntAttribute("height");
+    video_info.fps = video->getDoubleAttribute("fps", 25.0);
+    video_info.is_bitrate_or_crf = !video->hasAttribute("crf");
+    video_info.bit_rate = (video_info.is_bitrate_or_crf)?video->getIntAttribute("bitrate"):video->getIntAttribute("crf");
+    video_info.pass = (video_info.is_bitrate_or_crf)?jlimit(1, 2, video->getIntAttribute("pass", 1)):1;
+    video_info.gop = video->getIntAttribute("gop", 12);
+    video_info.compressionPreset = get_preset(video->getStringAttribute("preset"));
+    video_info.segments = video->getIntAttribute("segments", 0);
+    video_info.smart_render = video->getBoolAttribute("smart_render", false);
+    video_info.pass_cache = video->getBoolAttribute("pass_cache", false);
+    video_info.scale_quality = video->getIntAttribute("scale_quality", 2);
+    video_info.deadline = video->getIntAttribute("deadline", 0);
+    video_info.chunk_duration = jmax(0, video->getIntAttribute("chunk", 0));
+
+    if(video_info.codec_short.isEmpty() && !raw)
+        error = "video codec is not set";
+    else if(video_info.width<=0 || video_info.height<=0 || video_info.fps<=0.0)
+        error = "bad size or frame rate of the video";
+    else if(video_info.bit_rate<=0 && !raw)
+        error = "bitrate or crf of the video is not set";
+    return error.isEmpty();
+}
+
+static bool read_audio(XmlElement * audio, bool raw, Movie::AudioInfo & audio_info, String & error)
+{
+    audio_info.codec_short = audio->getStringAttribute("codec");
+    audio_info.bit_rate = audio->getIntAttribute("bitrate", 128);
+    audio_info.sample_rate = audio->getIntAttribute("sample_rate", 44100);
+    audio_info.channels = audio->getIntAttribute("channels", 2);
+    if(audio_info.codec_short.isEmpty() && !raw)
+        error = "audio codec is not set";
+    else if(audio_info.sample_rate<=0 || audio_info.channels<=0)
+        error = "bad sample rate or channels of the audio";
+    return error.isEmpty();
+}
+
+static String get_output(const File & directory, const String & output)
+{
+    return (output == "-")?output:directory.getChildFile(output).getFullPathName();
+}
+
+/* renditions take the settings of the output, the bit rate is scaled by the
+   number of pixels unless it is given */
+static bool read_renditions(XmlElement * job, const File & directory, vector<Movie::Info> & renditions, String & error)
+{
+    Movie::Info info;
+    info.filename = get_output(directory, job->getStringAttribute("output"));
+    info.format_short = job->getStringAttribute("format");
+    if(job->getStringAttribute("output").isEmpty())
+    {
+        error = "output is not set";
+        return false;
+    }
+
+    XmlElement * video = job->getChildByName("video");
+    if(video)
+    {
+        Movie::VideoInfo video_info;
+        if(!read_video(video, IsRawOutput(info), video_info, error))
+            return false;
+        info.videos.push_back(video_info);
+    }
+    XmlElement * audio = job->getChildByName("audio");
+    if(audio)
+    {
+        Movie::AudioInfo audio_info;
+        if(!read_audio(audio, IsRawOutput(info), audio_info, error))
+            return false;
+        info.audios.push_back(audio_info);
+    }
+    if(!video && !audio)
+    {
+        error = "neither video nor audio is set";
+        return false;
+    }
+    renditions.push_back(info);
+
+    forEachXmlChildElementWithTagName(*job, rendition_element, "rendition")
+    {
+        if(!video)
+        {
+            error = "renditions need the video";
+            return false;
+        }
+        Movie::Info rendition(info);
+        Movie::VideoInfo & rendition_video = rendition.videos[0];
+        const Movie::VideoInfo & main_video = info.videos[0];
+        rendition.filename = get_output(directory, rendition_element->getStringAttribute("output"));
+        rendition_video.width = rendition_element->getIntAttribute("width");
+        rendition_video.height = rendition_element->getIntAttribute("height");
+        if(rendition_element->getStringAttribute("output").isEmpty() || rendition_video.width<=0 || rendition_video.height<=0)
+        {
+            error = "rendition needs the output and the size";
+            return false;
+        }
+        if(rendition_element->hasAttribute("bitrate"))
+            rendition_video.bit_rate = rendition_element->getIntAttribute("bitrate");
+        else if(main_video.is_bitrate_or_crf)
+            rendition_video.bit_rate = jmax(1, (int)((int64)main_video.bit_rate * rendition_video.width * rendition_video.height / ((int64)main_video.width * main_video.height)));
+        renditions.push_back(rendition);
+    }
+    return true;
+}
+
+/* sources are opened once to check them, the task opens them again with
+   the decoder threads it is given */
+static int read_timeline(XmlElement * job, const File & directory, Timeline & timeline, String & error)
+{
+    forEachXmlChildElementWithTagName(*job, source, "source")
+    {
+        String filename = directory.getChildFile(source->getStringAttribute("file")).getFullPathName();
+        double start = source->getDoubleAttribute("start", 0.0);
+        double end = source->getDoubleAttribute("end", 0.0);
+        if(!timeline.Append(filename, start, end, true))
+        {
+            error = "can't load " + filename;
+            return ExitCantLoadSource;
+        }
+    }
+    if(timeline.IsEmpty())
+    {
+        error = "no sources";
+        return ExitBadJob;
+    }
+    return ExitDone;
+}
+
+/* the job goes through the task list like the exports of the editor, its
+   state is polled until the render is finished. Interrupted render keeps
+   its checkpoint, the same job started again goes on from it */
+static int wait_for_task()
+{
+    String last_progress;
+    for(;;)
+    {
+        TaskSnapshot t;
+        if(!GetTaskSnapshot(0, t))
+        {
+            print_line("error task is lost");
+            return ExitRenderFailed;
+        }
+        if(interrupted)
+        {
+            RemoveTask(0);
+            print_line("interrupted");
+            return ExitInterrupted;
+        }
+        if(t.state == task::Done)
+        {
+            RemoveTask(0);
+            print_line("progress 1.0000 eta 0");
+            print_line("done");
+            return ExitDone;
+        }
+        if(t.state == task::Failed)
+        {
+            RemoveTask(0);
+            print_line("error " + t.status.trim());
+            return ExitRenderFailed;
+        }
+        String progress = "progress " + String(t.progress, 4) + " eta " + String(t.millis_left / 1000);
+        if(progress != last_progress)
+        {
+            print_line(progress);
+            last_progress = progress;
+        }
+        Thread::sleep(RENDER_CLI_PROGRESS_INTERVAL);
+    }
+}
+
+static int run_job(const File & job_file)
+{
+    XmlDocument document(job_file);
+    XmlElement * job = document.getDocumentElement();
+    if(!job || !job->hasTagName("render"))
+    {
+        print_line("error bad job " + document.getLastParseError());
+        delete job;
+        return ExitBadJob;
+    }
+
+    if(job->getStringAttribute("output") == "-")
+        progress_stream = stderr;
+    File directory = job_file.getParentDirectory();
+    vector<Movie::Info> renditions;
+    String error;
+    if(!read_renditions(job, directory, renditions, error))
+    {
+        print_line("error " + error);
+        delete job;
+        return ExitBadJob;
+    }
+
+    Timeline timeline;
+    int res = read_timeline(job, directory, timeline, error);
+    delete job;
+    if(res != ExitDone)
+    {
+        print_line("error " + error);
+        return res;
+    }
+
+    AddEncodingTask(&timeline, renditions);
+    return wait_for_task();
+}
+
+int main(int argc, char * argv[])
+{
+    if(argc != 2)
+    {
+        print_line("usage: render <job.xml>");
+        return ExitUsage;
+    }
+    initialiseJuce_NonGUI();
+    av_register_all();
+    signal(SIGINT, _OnInterrupt);
+    signal(SIGTERM, _OnInterrupt);
+#ifdef SIGPIPE
+    // a reader of the raw output gone away is an error of the write
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    int res = run_job(File::getCurrentWorkingDirectory().getChildFile(String(argv[1])));
+
+    shutdownJuce_NonGUI();
+    return res;
+}
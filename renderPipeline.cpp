@@ -0,0 +1,183 @@
+#include "config.h"
+#include "renderPipeline.h"
+
+RenderStage::RenderStage(const String & name, const String & label):Thread(name)
+{
+    this->label = label;
+    start_millis = -1.0;
+    stop_millis = -1.0;
+    wait_millis = 0.0;
+    frames = 0;
+}
+
+void RenderStage::Begin()
+{
+    wait_millis = 0.0;
+    frames = 0;
+    stop_millis = -1.0;
+    start_millis = Time::getMillisecondCounterHiRes();
+}
+
+void RenderStage::End()
+{
+    stop_millis = Time::getMillisecondCounterHiRes();
+}
+
+void RenderStage::Idle(int millis)
+{
+    double before = Time::getMillisecondCounterHiRes();
+    sleep(millis);
+    wait_millis += Time::getMillisecondCounterHiRes() - before;
+}
+
+double RenderStage::GetRunningMillis()
+{
+    if(start_millis < 0.0)
+        return 0.0;
+    double end = (stop_millis < 0.0)?Time::getMillisecondCounterHiRes():stop_millis;
+    return jmax(0.0, end - start_millis);
+}
+
+double RenderStage::GetBusyMillis()
+{
+    return jmax(0.0, GetRunningMillis() - wait_millis);
+}
+
+double RenderStage::GetUtilisation()
+{
+    double running = GetRunningMillis();
+    if(running <= 0.0)
+        return 0.0;
+    return jlimit(0.0, 1.0, 1.0 - wait_millis / running);
+}
+
+String RenderStage::GetKey()
+{
+    return getThreadName().fromFirstOccurrenceOf("render ", false, false).upToFirstOccurrenceOf(" thread", false, false);
+}
+
+String RenderStage::PrintUtilisation()
+{
+    return label + " " + String((int)(GetUtilisation() * 100.0 + 0.5)) + "%";
+}
+
+bool RenderStage::Give(AudioRing & ring, const int16 * samples, int count)
+{
+    double before = Time::getMillisecondCounterHiRes();
+    bool res = ring.Write(samples, count);
+    wait_millis += Time::getMillisecondCounterHiRes() - before;
+    return res;
+}
+
+int RenderStage::Take(AudioRing & ring, int16 * samples, int count)
+{
+    double before = Time::getMillisecondCounterHiRes();
+    int res = ring.Read(samples, count);
+    wait_millis += Time::getMillisecondCounterHiRes() - before;
+    return res;
+}
+
+AudioRing::AudioRing()
+{
+    buffer = 0;
+    capacity = 0;
+    read_position = 0;
+    filled = 0;
+    closed = false;
+    aborted = false;
+}
+
+AudioRing::~AudioRing()
+{
+    delete [] buffer;
+}
+
+bool AudioRing::Allocate(int samples)
+{
+    const ScopedLock myScopedLock (critical);
+    delete [] buffer;
+    try
+    {
+        buffer = new int16[samples];
+    }
+    catch(std::bad_alloc& ex)
+    {
+        buffer = 0;
+    }
+    capacity = (buffer)?samples:0;
+    read_position = 0;
+    filled = 0;
+    return buffer != 0;
+}
+
+bool AudioRing::Write(const int16 * samples, int count)
+{
+    while(count > 0)
+    {
+        {
+            const ScopedLock myScopedLock (critical);
+            if(aborted || closed || capacity == 0)
+                return false;
+            int write_position = (read_position + filled) % capacity;
+            int part = jmin(count, capacity - filled, capacity - write_position);
+            if(part > 0)
+            {
+                if(samples)
+                {
+                    memcpy(buffer + write_position, samples, part * sizeof(int16));
+                    samples += part;
+                }
+                else
+                    memset(buffer + write_position, 0, part * sizeof(int16));
+                filled += part;
+                count -= part;
+                not_empty.signal();
+                continue;
+            }
+        }
+        not_full.wait(100);
+    }
+    return true;
+}
+
+int AudioRing::Read(int16 * samples, int count)
+{
+    int done = 0;
+    while(done < count)
+    {
+        {
+            const ScopedLock myScopedLock (critical);
+            if(aborted)
+                return -1;
+            int part = jmin(count - done, filled, capacity - read_position);
+            if(part > 0)
+            {
+                memcpy(samples + done, buffer + read_position, part * sizeof(int16));
+                read_position = (read_position + part) % capacity;
+                filled -= part;
+                done += part;
+                not_full.signal();
+                continue;
+            }
+            if(closed)
+                return done;
+        }
+        not_empty.wait(100);
+    }
+    return done;
+}
+
+void AudioRing::Close()
+{
+    const ScopedLock myScopedLock (critical);
+    closed = true;
+    not_empty.signal();
+}
+
+void AudioRing::Abort()
+{
+    const ScopedLock myScopedLock (critical);
+    aborted = true;
+    not_empty.signal();
+    not_full.signal();
+}
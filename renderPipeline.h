@@ -0,0 +1,185 @@
+#ifndef RENDER_PIPELINE_H
+#define RENDER_PIPELINE_H
+#include "juce/juce.h"
+#include <deque>
+using namespace std;
+
+// Bounded queue between two stages of the render pipeline. Push blocks while
+// the queue is full and Pop while it is empty. After Close the consumer gets
+// the rest of the items and then false, after Abort both sides get false at once
+template <class Item>
+class RenderQueue
+{
+    private:
+    CriticalSection critical;
+    WaitableEvent not_empty;
+    WaitableEvent not_full;
+    deque<Item> items;
+    int capacity;
+    bool closed;
+    bool aborted;
+
+    public:
+    RenderQueue(int capacity)
+    {
+        this->capacity = capacity;
+        closed = false;
+        aborted = false;
+    }
+
+    bool Push(Item item)
+    {
+        for(;;)
+        {
+            {
+                const ScopedLock myScopedLock (critical);
+                if(aborted || closed)
+                    return false;
+                if((int)items.size() < capacity)
+                {
+                    items.push_back(item);
+                    not_empty.signal();
+                    return true;
+                }
+            }
+            not_full.wait(100);
+        }
+    }
+
+    bool Pop(Item & item)
+    {
+        for(;;)
+        {
+            {
+                const ScopedLock myScopedLock (critical);
+                if(aborted)
+                    return false;
+                if(!items.empty())
+                {
+                    item = items.front();
+                    items.pop_front();
+                    not_full.signal();
+                    return true;
+                }
+                if(closed)
+                    return false;
+            }
+            not_empty.wait(100);
+        }
+    }
+
+    void Close()
+    {
+        const ScopedLock myScopedLock (critical);
+        closed = true;
+        not_empty.signal();
+    }
+
+    void Abort()
+    {
+        const ScopedLock myScopedLock (critical);
+        aborted = true;
+        not_empty.signal();
+        not_full.signal();
+    }
+
+    int GetSize()
+    {
+        const ScopedLock myScopedLock (critical);
+        return (int)items.size();
+    }
+
+    int GetCapacity()
+    {
+        return capacity;
+    }
+
+    // items left after the stages are stopped, to be freed by the owner
+    bool TakeRest(Item & item)
+    {
+        const ScopedLock myScopedLock (critical);
+        if(items.empty())
+            return false;
+        item = items.front();
+        items.pop_front();
+        return true;
+    }
+};
+
+// Ring of interleaved 16 bit audio samples between the audio decoder and the
+// mux. Write blocks while there is no room and Read while there are no
+// samples; after Close Read returns the rest and then less than it was asked
+class AudioRing
+{
+    private:
+    CriticalSection critical;
+    WaitableEvent not_empty;
+    WaitableEvent not_full;
+    int16 * buffer;
+    int capacity;
+    int read_position;
+    int filled;
+    bool closed;
+    bool aborted;
+
+    public:
+    AudioRing();
+    ~AudioRing();
+    bool Allocate(int samples);
+    // samples = 0 writes silence
+    bool Write(const int16 * samples, int count);
+    // returns the number of samples read or -1 after Abort
+    int Read(int16 * samples, int count);
+    void Close();
+    void Abort();
+};
+
+// One thread of the render pipeline. Time spent blocked on the queues is
+// counted, the rest of the running time is the utilisation of the stage
+class RenderStage : public Thread
+{
+    private:
+    double start_millis;
+    double stop_millis;
+    double wait_millis;
+
+    protected:
+    void Begin();
+    void End();
+    // pause of the stage, counted as waiting
+    void Idle(int millis);
+
+    public:
+    String label;
+    int frames;
+    RenderStage(const String & name, const String & label);
+
+    template <class Item> bool Take(RenderQueue<Item> & queue, Item & item)
+    {
+        double before = Time::getMillisecondCounterHiRes();
+        bool res = queue.Pop(item);
+        wait_millis += Time::getMillisecondCounterHiRes() - before;
+        return res;
+    }
+
+    template <class Item> bool Give(RenderQueue<Item> & queue, Item item)
+    {
+        double before = Time::getMillisecondCounterHiRes();
+        bool res = queue.Push(item);
+        wait_millis += Time::getMillisecondCounterHiRes() - before;
+        return res;
+    }
+
+    bool Give(AudioRing & ring, const int16 * samples, int count);
+    int Take(AudioRing & ring, int16 * samples, int count);
+
+    // part of the running time the stage was working, from 0 to 1
+    double GetUtilisation();
+    double GetRunningMillis();
+    double GetBusyMillis();
+    // name of the thread without the common words, for the reports
+    String GetKey();
+    String PrintUtilisation();
+};
+
+#endif
@@ -0,0 +1,318 @@
+#include "config.h"
+#include "renderQueue.h"
+
+static XmlElement * write_output(const Movie::Info & info)
+{
+    XmlElement * output = new XmlElement("output");
+    output->setAttribute("filename", info.filename);
+    output->setAttribute("duration", info.duration);
+    output->setAttribute("size", String(info.size));
+    output->setAttribute("bitrate", info.bit_rate);
+    output->setAttribute("format", info.format_short);
+    output->setAttribute("format_long", info.format_long);
+    for(vector<Movie::VideoInfo>::const_iterator it = info.videos.begin(); it!=info.videos.end(); it++)
+    {
+        XmlElement * video = new XmlElement("video");
+        video->setAttribute("bitrate", it->bit_rate);
+        video->setAttribute("is_bitrate", it->is_bitrate_or_crf);
+        video->setAttribute("codec", it->codec_short);
+        video->setAttribute("codec_tag", it->codec_tag);
+        video->setAttribute("codec_long", it->codec_long);
+        video->setAttribute("width", it->width);
+        video->setAttribute("height", it->height);
+        video->setAttribute("fps", it->fps);
+        video->setAttribute("language", it->language);
+        video->setAttribute("title", it->title);
+        video->setAttribute("pix_fmt", (int)it->pix_fmt);
+        video->setAttribute("gop", it->gop);
+        video->setAttribute("preset", it->compressionPreset);
+        video->setAttribute("pass", it->pass);
+        video->setAttribute("segments", it->segments);
+        video->setAttribute("smart_render", it->smart_render);
+        video->setAttribute("pass_cache", it->pass_cache);
+        video->setAttribute("scale_quality", it->scale_quality);
+        video->setAttribute("deadline", it->deadline);
+        video->setAttribute("chunk", it->chunk_duration);
+        output->addChildElement(video);
+    }
+    for(vector<Movie::AudioInfo>::const_iterator it = info.audios.begin(); it!=info.audios.end(); it++)
+    {
+        XmlElement * audio = new XmlElement("audio");
+        audio->setAttribute("bitrate", it->bit_rate);
+        audio->setAttribute("codec", it->codec_short);
+        audio->setAttribute("codec_long", it->codec_long);
+        audio->setAttribute("sample_rate", it->sample_rate);
+        audio->setAttribute("codec_tag", it->codec_tag);
+        audio->setAttribute("channels", it->channels);
+        audio->setAttribute("language", it->language);
+        audio->setAttribute("title", it->title);
+        output->addChildElement(audio);
+    }
+    for(vector<Movie::SubInfo>::const_iterator it = info.subs.begin(); it!=info.subs.end(); it++)
+    {
+        XmlElement * sub = new XmlElement("sub");
+        sub->setAttribute("language", it->language);
+        sub->setAttribute("title", it->title);
+        output->addChildElement(sub);
+    }
+    return output;
+}
+
+static void read_output(XmlElement * output, Movie::Info & info)
+{
+    info.filename = output->getStringAttribute("filename");
+    info.duration = output->getDoubleAttribute("duration");
+    info.size = output->getStringAttribute("size").getLargeIntValue();
+    info.bit_rate = output->getIntAttribute("bitrate");
+    info.format_short = output->getStringAttribute("format");
+    info.format_long = output->getStringAttribute("format_long");
+    forEachXmlChildElementWithTagName(*output, video, "video")
+    {
+        Movie::VideoInfo video_info;
+        video_info.bit_rate = video->getIntAttribute("bitrate");
+        video_info.is_bitrate_or_crf = video->getBoolAttribute("is_bitrate", true);
+        video_info.codec_short = video->getStringAttribute("codec");
+        video_info.codec_tag = video->getStringAttribute("codec_tag");
+        video_info.codec_long = video->getStringAttribute("codec_long");
+        video_info.width = video->getIntAttribute("width");
+        video_info.height = video->getIntAttribute("height");
+        video_info.fps = video->getDoubleAttribute("fps");
+        video_info.language = video->getStringAttribute("language");
+        video_info.title = video->getStringAttribute("title");
+        video_info.pix_fmt = (PixelFormat)video->getIntAttribute("pix_fmt", PIX_FMT_NONE);
+        video_info.gop = video->getIntAttribute("gop");
+        video_info.compressionPreset = video->getIntAttribute("preset");
+        video_info.pass = video->getIntAttribute("pass", 1);
+        video_info.segments = video->getIntAttribute("segments", 1);
+        video_info.smart_render = video->getBoolAttribute("smart_render");
+        video_info.pass_cache = video->getBoolAttribute("pass_cache");
+        video_info.scale_quality = video->getIntAttribute("scale_quality", 2);
+        video_info.deadline = video->getIntAttribute("deadline");
+        video_info.chunk_duration = video->getIntAttribute("chunk");
+        info.videos.push_back(video_info);
+    }
+    forEachXmlChildElementWithTagName(*output, audio, "audio")
+    {
+        Movie::AudioInfo audio_info;
+        audio_info.bit_rate = audio->getIntAttribute("bitrate");
+        audio_info.codec_short = audio->getStringAttribute("codec");
+        audio_info.codec_long = audio->getStringAttribute("codec_long");
+        audio_info.sample_rate = audio->getIntAttribute("sample_rate");
+        audio_info.codec_tag = audio->getStringAttribute("codec_tag");
+        audio_info.channels = audio->getIntAttribute("channels");
+        audio_info.language = audio->getStringAttribute("language");
+        audio_info.title = audio->getStringAttribute("title");
+        info.audios.push_back(audio_info);
+    }
+    forEachXmlChildElementWithTagName(*output, sub, "sub")
+    {
+        Movie::SubInfo sub_info;
+        sub_info.language = sub->getStringAttribute("language");
+        sub_info.title = sub->getStringAttribute("title");
+        info.subs.push_back(sub_info);
+    }
+}
+
+static XmlElement * write_job(const RenderQueueJournal::Job & job)
+{
+    XmlElement * record = new XmlElement("job");
+    record->setAttribute("id", job.id);
+    record->setAttribute("state", job.state);
+    record->setAttribute("priority", job.priority);
+    record->setAttribute("worked", String(job.millis_worked));
+    record->setAttribute("progress", job.progress);
+    record->setAttribute("memory", String(job.memory));
+    record->setAttribute("demand", job.demand);
+    for(vector<Movie::Info>::const_iterator it = job.outputs.begin(); it!=job.outputs.end(); it++)
+        record->addChildElement(write_output(*it));
+    for(vector<RenderQueueJournal::Part>::const_iterator it = job.parts.begin(); it!=job.parts.end(); it++)
+    {
+        XmlElement * part = new XmlElement("part");
+        part->setAttribute("file", it->filename);
+        part->setAttribute("start", it->start);
+        part->setAttribute("end", it->end);
+        part->setAttribute("at", it->absolute_start);
+        record->addChildElement(part);
+    }
+    return record;
+}
+
+static bool read_job(XmlElement * record, RenderQueueJournal::Job & job)
+{
+    job.id = record->getIntAttribute("id");
+    job.state = record->getIntAttribute("state");
+    job.priority = record->getIntAttribute("priority");
+    job.millis_worked = record->getStringAttribute("worked").getLargeIntValue();
+    job.progress = record->getDoubleAttribute("progress");
+    job.memory = record->getStringAttribute("memory").getLargeIntValue();
+    job.demand = record->getIntAttribute("demand", 1);
+    forEachXmlChildElementWithTagName(*record, output, "output")
+    {
+        Movie::Info info;
+        read_output(output, info);
+        job.outputs.push_back(info);
+    }
+    forEachXmlChildElementWithTagName(*record, element, "part")
+    {
+        RenderQueueJournal::Part part;
+        part.filename = element->getStringAttribute("file");
+        part.start = element->getDoubleAttribute("start");
+        part.end = element->getDoubleAttribute("end");
+        part.absolute_start = element->getDoubleAttribute("at");
+        job.parts.push_back(part);
+    }
+    return job.outputs.size()>0 && job.parts.size()>0;
+}
+
+static vector<RenderQueueJournal::Job>::iterator find_job(vector<RenderQueueJournal::Job> & jobs, int id)
+{
+    vector<RenderQueueJournal::Job>::iterator it = jobs.begin();
+    while(it!=jobs.end() && it->id != id)
+        it++;
+    return it;
+}
+
+RenderQueueJournal::RenderQueueJournal():lock("video_editor_render_queue")
+{
+    enabled = false;
+    records = 0;
+}
+
+bool RenderQueueJournal::Open(const File & file, vector<Job> & jobs)
+{
+    jobs.clear();
+    enabled = false;
+    this->file = file;
+    if(!lock.enter(0))
+        return false;
+    if(!file.getParentDirectory().createDirectory())
+        return false;
+
+    StringArray lines;
+    if(file.existsAsFile())
+        lines.addLines(file.loadFileAsString());
+    for(int i = 0; i<lines.size(); ++i)
+    {
+        XmlElement * record = XmlDocument::parse(lines[i]);
+        if(!record)
+            continue;
+        int id = record->getIntAttribute("id");
+        vector<Job>::iterator found = find_job(jobs, id);
+        if(record->hasTagName("job"))
+        {
+            Job job;
+            if(read_job(record, job))
+            {
+                if(found!=jobs.end())
+                    *found = job;
+                else
+                    jobs.push_back(job);
+            }
+        }
+        else if(record->hasTagName("state") && found!=jobs.end())
+        {
+            found->state = record->getIntAttribute("state");
+            found->priority = record->getIntAttribute("priority");
+            found->millis_worked = record->getStringAttribute("worked").getLargeIntValue();
+            found->progress = record->getDoubleAttribute("progress");
+        }
+        else if(record->hasTagName("remove") && found!=jobs.end())
+            jobs.erase(found);
+        else if(record->hasTagName("order"))
+        {
+            StringArray ids;
+            ids.addTokens(record->getStringAttribute("ids"), " ", String::empty);
+            vector<Job> ordered;
+            for(int j = 0; j<ids.size(); ++j)
+            {
+                vector<Job>::iterator it = find_job(jobs, ids[j].getIntValue());
+                if(it==jobs.end())
+                    continue;
+                ordered.push_back(*it);
+                jobs.erase(it);
+            }
+            // jobs the order does not know stay after the ordered ones
+            ordered.insert(ordered.end(), jobs.begin(), jobs.end());
+            jobs.swap(ordered);
+        }
+        delete record;
+    }
+    enabled = true;
+    return Compact(jobs);
+}
+
+bool RenderQueueJournal::IsEnabled()
+{
+    return enabled;
+}
+
+bool RenderQueueJournal::Append(const XmlElement & record)
+{
+    if(!enabled)
+        return false;
+    records++;
+    return file.appendText(record.createDocument(String::empty, true, false) + "\n");
+}
+
+bool RenderQueueJournal::Add(const Job & job)
+{
+    XmlElement * record = write_job(job);
+    bool res = Append(*record);
+    delete record;
+    return res;
+}
+
+bool RenderQueueJournal::SetState(int id, int state, int priority, int64 millis_worked, double progress)
+{
+    XmlElement record("state");
+    record.setAttribute("id", id);
+    record.setAttribute("state", state);
+    record.setAttribute("priority", priority);
+    record.setAttribute("worked", String(millis_worked));
+    record.setAttribute("progress", progress);
+    return Append(record);
+}
+
+bool RenderQueueJournal::Remove(int id)
+{
+    XmlElement record("remove");
+    record.setAttribute("id", id);
+    return Append(record);
+}
+
+bool RenderQueueJournal::SetOrder(const vector<int> & ids)
+{
+    String text;
+    for(vector<int>::const_iterator it = ids.begin(); it!=ids.end(); it++)
+        text<<((it==ids.begin())?"":" ")<<String(*it);
+    XmlElement record("order");
+    record.setAttribute("ids", text);
+    return Append(record);
+}
+
+bool RenderQueueJournal::IsGrown()
+{
+    return records > RENDER_QUEUE_JOURNAL_COMPACT;
+}
+
+/* jobs are written to a temporary file which replaces the journal, a crash
+   leaves either the old journal or the new one */
+bool RenderQueueJournal::Compact(const vector<Job> & jobs)
+{
+    if(!enabled)
+        return false;
+    String text;
+    for(vector<Job>::const_iterator it = jobs.begin(); it!=jobs.end(); it++)
+    {
+        XmlElement * record = write_job(*it);
+        text<<record->createDocument(String::empty, true, false)<<"\n";
+        delete record;
+    }
+    TemporaryFile temp(file);
+    if(!temp.getFile().replaceWithText(text))
+        return false;
+    if(!temp.overwriteTargetFileWithTemporary())
+        return false;
+    records = (int)jobs.size();
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+#include "juce/juce.h"
+#include "movie.h"
+#include <vector>
+using namespace std;
+
+// Jobs of the render queue kept on disk. Every change of the queue is a
+// line appended to the journal: a job with its outputs and the parts of its
+// sources, a new state, a removal or a new order of the jobs. The journal is
+// read back at the start of the editor and rewritten with the jobs left when
+// it has grown. A line cut by a crash is skipped
+class RenderQueueJournal
+{
+    public:
+    class Part
+    {
+        public:
+        String filename;
+        double start;
+        double end;
+        double absolute_start;
+    };
+    class Job
+    {
+        public:
+        int id;
+        // task::TaskState and task::TaskPriority
+        int state;
+        int priority;
+        int64 millis_worked;
+        double progress;
+        int64 memory;
+        int demand;
+        // the first output is the main one
+        vector<Movie::Info> outputs;
+        vector<Part> parts;
+    };
+
+    private:
+    File file;
+    InterProcessLock lock;
+    bool enabled;
+    int records;
+
+    bool Append(const XmlElement & record);
+
+    public:
+    RenderQueueJournal();
+    // jobs of the journal in the order of the queue. Another editor keeping
+    // the journal leaves this one without it
+    bool Open(const File & file, vector<Job> & jobs);
+    bool IsEnabled();
+    bool Add(const Job & job);
+    bool SetState(int id, int state, int priority, int64 millis_worked, double progress);
+    bool Remove(int id);
+    bool SetOrder(const vector<int> & ids);
+    // more records than RENDER_QUEUE_JOURNAL_COMPACT are in the journal
+    bool IsGrown();
+    // the journal is written again with these jobs only
+    bool Compact(const vector<Job> & jobs);
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "config.h"
+#include "renderTelemetry.h"
+#include "localization.h"
+using namespace localization;
+
+RenderTelemetry::RenderTelemetry()
+{
+    start_millis = 0.0;
+    running = false;
+    current.number = 0;
+    current.seconds = 0.0;
+    current.frames = 0;
+    current.bytes = 0;
+    memory_peak = 0;
+}
+
+double RenderTelemetry::GetSeconds()
+{
+    return (Time::getMillisecondCounterHiRes() - start_millis) / 1000.0;
+}
+
+void RenderTelemetry::BeginPass(int number)
+{
+    current = Pass();
+    current.number = number;
+    current.seconds = 0.0;
+    current.frames = 0;
+    current.bytes = 0;
+    start_millis = Time::getMillisecondCounterHiRes();
+    running = true;
+}
+
+void RenderTelemetry::SetProgress(int64 frames, int64 bytes)
+{
+    current.frames = frames;
+    current.bytes = bytes;
+}
+
+void RenderTelemetry::SampleQueue(const String & key, int depth, int capacity)
+{
+    for(vector<Queue>::iterator it = current.queues.begin(); it!=current.queues.end(); it++)
+    {
+        if(it->key == key)
+        {
+            it->depth_sum += depth;
+            it->samples++;
+            return;
+        }
+    }
+    Queue queue;
+    queue.key = key;
+    queue.depth_sum = depth;
+    queue.capacity = capacity;
+    queue.samples = 1;
+    current.queues.push_back(queue);
+}
+
+void RenderTelemetry::AddStage(const String & key, const String & label, double busy_millis, double running_millis, int64 frames)
+{
+    for(vector<Stage>::iterator it = current.stages.begin(); it!=current.stages.end(); it++)
+    {
+        if(it->key == key)
+        {
+            it->instances++;
+            it->busy_millis += busy_millis;
+            it->running_millis += running_millis;
+            it->frames += frames;
+            return;
+        }
+    }
+    Stage stage;
+    stage.key = key;
+    stage.label = label;
+    stage.instances = 1;
+    stage.busy_millis = busy_millis;
+    stage.running_millis = running_millis;
+    stage.frames = frames;
+    current.stages.push_back(stage);
+}
+
+void RenderTelemetry::EndPass()
+{
+    if(!running)
+        return;
+    current.seconds = GetSeconds();
+    passes.push_back(current);
+    running = false;
+}
+
+void RenderTelemetry::SetMemoryPeak(int64 bytes)
+{
+    memory_peak = bytes;
+}
+
+double RenderTelemetry::GetFps()
+{
+    double seconds = (running)?GetSeconds():current.seconds;
+    return (seconds > 0.0)?(double)current.frames / seconds:0.0;
+}
+
+double RenderTelemetry::GetMegabytesPerSecond()
+{
+    double seconds = (running)?GetSeconds():current.seconds;
+    return (seconds > 0.0)?(double)current.bytes / (1024.0 * 1024.0) / seconds:0.0;
+}
+
+String RenderTelemetry::Print()
+{
+    String res = String(GetFps(), 1) + " " + LABEL_FRAMES_PER_SECOND + ", " + String(GetMegabytesPerSecond(), 1) + " " + LABEL_MEGABYTES_PER_SECOND;
+    if(!current.queues.empty())
+    {
+        res += ", " + LABEL_RENDER_QUEUES;
+        for(vector<Queue>::iterator it = current.queues.begin(); it!=current.queues.end(); it++)
+            res += " " + String(it->depth_sum / it->samples, 1) + "/" + String(it->capacity);
+    }
+    return res;
+}
+
+static String _JsonString(const String & text)
+{
+    String res = text.replace("\\", "\\\\").replace("\"", "\\\"");
+    return "\"" + res + "\"";
+}
+
+String RenderTelemetry::PrintPass(const Pass & pass)
+{
+    String res;
+    res << "    {\n";
+    res << "      \"pass\": " << pass.number << ",\n";
+    res << "      \"seconds\": " << String(pass.seconds, 3) << ",\n";
+    res << "      \"frames\": " << String(pass.frames) << ",\n";
+    res << "      \"fps\": " << String((pass.seconds > 0.0)?(double)pass.frames / pass.seconds:0.0, 3) << ",\n";
+    res << "      \"bytes\": " << String(pass.bytes) << ",\n";
+    res << "      \"megabytes_per_second\": " << String((pass.seconds > 0.0)?(double)pass.bytes / (1024.0 * 1024.0) / pass.seconds:0.0, 3) << ",\n";
+    res << "      \"stages\": [";
+    for(int i = 0; i<(int)pass.stages.size(); ++i)
+    {
+        const Stage & stage = pass.stages[i];
+        double utilisation = (stage.running_millis > 0.0)?stage.busy_millis / stage.running_millis:0.0;
+        res << ((i>0)?",":"") << "\n        {";
+        res << "\"name\": " << _JsonString(stage.key);
+        res << ", \"label\": " << _JsonString(stage.label);
+        res << ", \"threads\": " << stage.instances;
+        res << ", \"busy_seconds\": " << String(stage.busy_millis / 1000.0, 3);
+        res << ", \"utilisation\": " << String(utilisation, 3);
+        res << ", \"frames\": " << String(stage.frames) << "}";
+    }
+    res << "\n      ],\n";
+    res << "      \"queues\": [";
+    for(int i = 0; i<(int)pass.queues.size(); ++i)
+    {
+        const Queue & queue = pass.queues[i];
+        res << ((i>0)?",":"") << "\n        {";
+        res << "\"name\": " << _JsonString(queue.key);
+        res << ", \"average_depth\": " << String(queue.depth_sum / queue.samples, 3);
+        res << ", \"capacity\": " << queue.capacity << "}";
+    }
+    res << "\n      ]\n";
+    res << "    }";
+    return res;
+}
+
+String RenderTelemetry::PrintReport(const String & filename)
+{
+    double seconds = 0.0;
+    for(vector<Pass>::iterator it = passes.begin(); it!=passes.end(); it++)
+        seconds += it->seconds;
+    String res;
+    res << "{\n";
+    res << "  \"file\": " << _JsonString(filename) << ",\n";
+    res << "  \"finished\": " << _JsonString(Time::getCurrentTime().toString(true, true)) << ",\n";
+    res << "  \"seconds\": " << String(seconds, 3) << ",\n";
+    res << "  \"processors\": " << SystemStats::getNumCpus() << ",\n";
+    res << "  \"memory_peak_megabytes\": " << String((double)memory_peak / (1024.0 * 1024.0), 1) << ",\n";
+    res << "  \"passes\": [\n";
+    for(int i = 0; i<(int)passes.size(); ++i)
+    {
+        res << PrintPass(passes[i]);
+        res << ((i + 1<(int)passes.size())?",\n":"\n");
+    }
+    res << "  ]\n";
+    res << "}\n";
+    return res;
+}
+
+bool RenderTelemetry::WriteReport(const File & file, const String & filename)
+{
+    return file.replaceWithText(PrintReport(filename));
+}
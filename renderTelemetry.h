@@ -0,0 +1,73 @@
+#ifndef RENDER_TELEMETRY_H
+#define RENDER_TELEMETRY_H
+#include "juce/juce.h"
+#include <vector>
+using namespace std;
+
+// Measures of a render: busy time of every stage, average depth of the
+// queues between them, frames per second and megabytes per second of the
+// output. Shown in the task tab while the render goes and written to a
+// report when it is finished
+class RenderTelemetry
+{
+    private:
+    class Stage
+    {
+        public:
+        String key;
+        String label;
+        // threads of the stage, one per segment
+        int instances;
+        double busy_millis;
+        double running_millis;
+        int64 frames;
+    };
+    class Queue
+    {
+        public:
+        String key;
+        double depth_sum;
+        int capacity;
+        int samples;
+    };
+    class Pass
+    {
+        public:
+        int number;
+        double seconds;
+        int64 frames;
+        int64 bytes;
+        vector<Stage> stages;
+        vector<Queue> queues;
+    };
+    vector<Pass> passes;
+    Pass current;
+    double start_millis;
+    bool running;
+    // most bytes held by the frame arena while this render ran, the renders
+    // running at the same time share it
+    int64 memory_peak;
+
+    double GetSeconds();
+    static String PrintPass(const Pass & pass);
+
+    public:
+    RenderTelemetry();
+    void BeginPass(int number);
+    // frames encoded and bytes written in this pass so far
+    void SetProgress(int64 frames, int64 bytes);
+    void SampleQueue(const String & key, int depth, int capacity);
+    void AddStage(const String & key, const String & label, double busy_millis, double running_millis, int64 frames);
+    void EndPass();
+    void SetMemoryPeak(int64 bytes);
+
+    double GetFps();
+    double GetMegabytesPerSecond();
+    // frames per second, megabytes per second and average depth of the queues
+    String Print();
+    // the whole render as JSON
+    String PrintReport(const String & filename);
+    bool WriteReport(const File & file, const String & filename);
+};
+
+#endif
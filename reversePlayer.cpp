@@ -0,0 +1,467 @@
+#include "config.h"
+#include "reversePlayer.h"
+#include <algorithm>
+#include <math.h>
+
+ReverseFrame::ReverseFrame(double second, const String & filename)
+{
+    this->second = second;
+    this->filename = filename;
+    size = 0;
+}
+
+ReverseFrame::~ReverseFrame()
+{
+    if(size)
+        avpicture_free(&picture);
+}
+
+void ReverseFrame::Copy(AVFrame * frame, AVCodecContext * codec)
+{
+    if(avpicture_alloc(&picture, codec->pix_fmt, codec->width, codec->height)<0)
+        return;
+    av_picture_copy(&picture, (AVPicture *)frame, codec->pix_fmt, codec->width, codec->height);
+    size = avpicture_get_size(codec->pix_fmt, codec->width, codec->height);
+}
+
+bool _CompareFrames(ReverseFrame * a, ReverseFrame * b)
+{
+    return a->second < b->second;
+}
+
+ReverseChunk::ReverseChunk()
+{
+    start = end = 0.0;
+    movie_start = movie_end = 0.0;
+    estimated_size = 0;
+    decode_millis = 0.0;
+    done = false;
+    cancelled = false;
+}
+
+ReverseChunk::~ReverseChunk()
+{
+    for(vector<ReverseFrame*>::iterator it = frames.begin(); it!=frames.end(); it++)
+        delete *it;
+}
+
+ReverseDecoder::ReverseDecoder(ReversePlayer * player):Thread("reverse decoder")
+{
+    this->player = player;
+    startThread(THREAD_PRIORITY_REVERSE);
+}
+
+ReverseDecoder::~ReverseDecoder()
+{
+    stopThread(10000);
+    for(vector<Movie*>::iterator it = movies.begin(); it!=movies.end(); it++)
+        delete *it;
+}
+
+Movie * ReverseDecoder::GetMovie(const String & filename)
+{
+    for(vector<Movie*>::iterator it = movies.begin(); it!=movies.end(); it++)
+    {
+        if((*it)->filename == filename)
+            return *it;
+    }
+    // every worker has its own decoder, the movie of the timeline stays untouched
+    Movie * movie = new Movie();
+    String load_filename = filename;
+    movie->Load(load_filename, true);
+    if(!movie->loaded)
+    {
+        delete movie;
+        return 0;
+    }
+    movies.push_back(movie);
+    return movie;
+}
+
+void ReverseDecoder::Decode(ReverseChunk * chunk)
+{
+    Movie * movie = GetMovie(chunk->filename);
+    if(!movie)
+        return;
+
+    double eps = 1.0 / movie->fps / 5.0;
+    double offset = chunk->start - chunk->movie_start;
+    double back = 0.0;
+    bool first = true;
+
+    // seek goes to the keyframe at or before the chunk start
+    movie->SeekToSecond(chunk->movie_start);
+    while(!threadShouldExit() && !chunk->cancelled)
+    {
+        double before = Time::getMillisecondCounterHiRes();
+        AVPacket* packet = movie->ReadFrame();
+        if(player->clock)
+            player->clock->AddDecodeTime(Time::getMillisecondCounterHiRes() - before);
+        if(!packet)
+            break;
+        av_free_packet(packet);
+        delete packet;
+
+        double second = movie->current;
+        if(movie->pFrame->key_frame)
+            player->AddKeyFrame(chunk->filename, second);
+
+        if(first && second > chunk->movie_start + eps && back < chunk->movie_start)
+        {
+            // container index is not precise, start earlier
+            back = (back==0.0)?0.5:back*2.0;
+            movie->SeekToSecond(jmax(0.0, chunk->movie_start - back));
+            continue;
+        }
+        first = false;
+
+        if(second >= chunk->movie_end - eps)
+            break;
+        if(second < chunk->movie_start - eps)
+            continue;
+        if(!player->IsOnGrid(second + offset))
+            continue;
+
+        ReverseFrame * frame = new ReverseFrame(second + offset, chunk->filename);
+        frame->Copy(movie->pFrame, movie->pCodecCtx);
+        if(!frame->size)
+        {
+            delete frame;
+            break;
+        }
+        chunk->frames.push_back(frame);
+    }
+}
+
+void ReverseDecoder::run()
+{
+    while(!threadShouldExit())
+    {
+        ReverseChunk * chunk = player->ClaimChunk();
+        if(!chunk)
+        {
+            wait(50);
+            continue;
+        }
+        double before = Time::getMillisecondCounterHiRes();
+        Decode(chunk);
+        chunk->decode_millis = Time::getMillisecondCounterHiRes() - before;
+        player->ChunkDone(chunk);
+    }
+}
+
+ReversePlayer::ReversePlayer(PlaybackClock * clock)
+{
+    this->clock = clock;
+    playing = false;
+    origin = 0.0;
+    schedule_end = 0.0;
+    fps = 25.0;
+    step = 1;
+    memory_used = 0;
+    memory_limit = (int64)REVERSE_PLAYBACK_MEMORY * 1024 * 1024;
+    decode_speed = 0.0;
+}
+
+ReversePlayer::~ReversePlayer()
+{
+    Stop();
+    for(vector<ReverseDecoder*>::iterator it = decoders.begin(); it!=decoders.end(); it++)
+        (*it)->signalThreadShouldExit();
+    NotifyDecoders();
+    for(vector<ReverseDecoder*>::iterator it = decoders.begin(); it!=decoders.end(); it++)
+        delete *it;
+}
+
+void ReversePlayer::NotifyDecoders()
+{
+    for(vector<ReverseDecoder*>::iterator it = decoders.begin(); it!=decoders.end(); it++)
+        (*it)->notify();
+}
+
+void ReversePlayer::Start(Timeline * timeline, double second, int step)
+{
+    Stop();
+    {
+        const ScopedLock myScopedLock (critical);
+        sources.clear();
+        for(vector<Timeline::Interval*>::iterator it = timeline->intervals.begin(); it != timeline->intervals.end(); it++)
+        {
+            Movie * movie = (*it)->movie;
+            if(!movie->loaded)
+                continue;
+            Source source;
+            source.filename = movie->filename;
+            source.start = (*it)->start;
+            source.end = (*it)->end;
+            source.absolute_start = (*it)->absolute_start;
+            source.absolute_end = (*it)->GetAbsoluteEnd();
+            source.fps = movie->fps;
+            source.frame_size = avpicture_get_size(movie->pCodecCtx->pix_fmt, movie->width, movie->height);
+            sources.push_back(source);
+        }
+        fps = timeline->GetFps();
+        this->step = (step<1)?1:step;
+        origin = second;
+        schedule_end = second;
+        memory_used = 0;
+        playing = true;
+    }
+
+    if(decoders.size()==0)
+    {
+        int count = jlimit(1, 4, SystemStats::getNumCpus() - 1);
+        for(int i = 0; i<count; ++i)
+            decoders.push_back(new ReverseDecoder(this));
+    }
+    NotifyDecoders();
+}
+
+void ReversePlayer::Stop()
+{
+    const ScopedLock myScopedLock (critical);
+    for(vector<ReverseChunk*>::iterator it = chunks.begin(); it!=chunks.end(); it++)
+    {
+        // chunk which is being decoded is deleted by its worker
+        if((*it)->done)
+            delete *it;
+        else
+            (*it)->cancelled = true;
+    }
+    chunks.clear();
+    memory_used = 0;
+    schedule_end = 0.0;
+    playing = false;
+}
+
+bool ReversePlayer::IsPlaying()
+{
+    return playing;
+}
+
+double ReversePlayer::GetDecodeRate()
+{
+    const ScopedLock myScopedLock (critical);
+    if(decoders.size()==0)
+        return 0.0;
+    return decode_speed * fps * decoders.size();
+}
+
+bool ReversePlayer::IsOnGrid(double second)
+{
+    if(step==1)
+        return true;
+    int number = (int)floor((origin - second) * fps + 0.5);
+    return number % step == 0;
+}
+
+void ReversePlayer::AddKeyFrame(const String & filename, double second)
+{
+    const ScopedLock myScopedLock (critical);
+    for(vector<KeyFrames>::iterator it = keyframes.begin(); it!=keyframes.end(); it++)
+    {
+        if(it->filename == filename)
+        {
+            it->seconds.insert(second);
+            return;
+        }
+    }
+    KeyFrames keys;
+    keys.filename = filename;
+    keys.seconds.insert(second);
+    keyframes.push_back(keys);
+}
+
+bool ReversePlayer::FindKeyFrameBefore(const String & filename, double second, double & keyframe)
+{
+    for(vector<KeyFrames>::iterator it = keyframes.begin(); it!=keyframes.end(); it++)
+    {
+        if(it->filename == filename)
+        {
+            set<double>::iterator found = it->seconds.lower_bound(second);
+            if(found == it->seconds.begin())
+                return false;
+            found--;
+            keyframe = *found;
+            return true;
+        }
+    }
+    return false;
+}
+
+ReversePlayer::Source * ReversePlayer::FindSource(double second, double & gap_start)
+{
+    gap_start = 0.0;
+    for(vector<Source>::iterator it = sources.begin(); it!=sources.end(); it++)
+    {
+        if(second >= it->absolute_start && second < it->absolute_end)
+            return &(*it);
+        if(it->absolute_end <= second && it->absolute_end > gap_start)
+            gap_start = it->absolute_end;
+    }
+    return 0;
+}
+
+ReverseChunk * ReversePlayer::ScheduleChunk()
+{
+    double frame = 1.0 / fps;
+    if(!playing || schedule_end < frame / 5.0)
+        return 0;
+
+    double gap_start;
+    Source * source = FindSource(schedule_end - frame / 2.0, gap_start);
+    ReverseChunk * chunk = new ReverseChunk();
+    chunk->end = schedule_end;
+
+    if(!source)
+    {
+        // nothing to decode between intervals, black frames are shown
+        chunk->start = jmax(gap_start, schedule_end - 1.0);
+        int first = (int)ceil((origin - schedule_end) * fps / step + 0.01);
+        for(int number = first; ; ++number)
+        {
+            double second = origin - number * step * frame;
+            if(second < chunk->start - frame / 5.0)
+                break;
+            chunk->frames.insert(chunk->frames.begin(), new ReverseFrame(second, String::empty));
+        }
+        chunk->done = true;
+        schedule_end = chunk->start;
+        return chunk;
+    }
+
+    double offset = source->absolute_start - source->start;
+    chunk->filename = source->filename;
+    chunk->movie_end = schedule_end - offset;
+
+    // a chunk of one worker must fit in its part of the memory
+    int64 frames_limit = memory_limit / (int64)decoders.size() / (int64)jmax(1, source->frame_size);
+    double max_span = (double)jmax((int64)1, frames_limit) * step / source->fps;
+
+    double keyframe;
+    double movie_start = chunk->movie_end - max_span;
+    if(FindKeyFrameBefore(source->filename, chunk->movie_end - 1.0 / source->fps / 5.0, keyframe))
+    {
+        if(keyframe > movie_start)
+            movie_start = keyframe;
+    }
+    else
+    {
+        // GOP is not known yet, it is learned while decoding
+        movie_start = jmax(movie_start, chunk->movie_end - 1.0);
+    }
+    chunk->movie_start = jmax(source->start, movie_start);
+    chunk->start = chunk->movie_start + offset;
+    chunk->estimated_size = (int64)((chunk->movie_end - chunk->movie_start) * source->fps / step + 2.0) * source->frame_size;
+    schedule_end = chunk->start;
+    return chunk;
+}
+
+ReverseChunk * ReversePlayer::ClaimChunk()
+{
+    const ScopedLock myScopedLock (critical);
+    while(playing)
+    {
+        if(chunks.size()>0 && memory_used >= memory_limit)
+            return 0;
+        ReverseChunk * chunk = ScheduleChunk();
+        if(!chunk)
+            return 0;
+        chunks.push_back(chunk);
+        if(!chunk->done)
+        {
+            memory_used += chunk->estimated_size;
+            return chunk;
+        }
+    }
+    return 0;
+}
+
+void ReversePlayer::ChunkDone(ReverseChunk * chunk)
+{
+    const ScopedLock myScopedLock (critical);
+    if(chunk->cancelled)
+    {
+        delete chunk;
+        return;
+    }
+    sort(chunk->frames.begin(), chunk->frames.end(), _CompareFrames);
+    int64 size = 0;
+    for(vector<ReverseFrame*>::iterator it = chunk->frames.begin(); it!=chunk->frames.end(); it++)
+        size += (*it)->size;
+    memory_used += size - chunk->estimated_size;
+    chunk->done = true;
+
+    if(chunk->decode_millis>0.0)
+    {
+        double speed = (chunk->movie_end - chunk->movie_start) * 1000.0 / chunk->decode_millis;
+        decode_speed = (decode_speed>0.0)?decode_speed * 0.8 + speed * 0.2:speed;
+    }
+}
+
+ReversePlayer::PresentResult ReversePlayer::PresentNext(Timeline * timeline, double dest)
+{
+    ReverseFrame * frame = 0;
+    {
+        const ScopedLock myScopedLock (critical);
+        double tolerance = step / fps / 2.0;
+        while(!frame)
+        {
+            if(!playing)
+                return Finished;
+            if(chunks.size()==0)
+            {
+                if(schedule_end < 1.0 / fps / 5.0)
+                    return Finished;
+                break;
+            }
+            ReverseChunk * chunk = chunks.front();
+            if(!chunk->done)
+                break;
+            if(chunk->frames.size()==0)
+            {
+                delete chunk;
+                chunks.erase(chunks.begin());
+                continue;
+            }
+            frame = chunk->frames.back();
+            // not the time for this frame yet
+            if(frame->second < dest - tolerance)
+            {
+                frame = 0;
+                break;
+            }
+            chunk->frames.pop_back();
+            memory_used -= frame->size;
+            if(frame->second > dest + tolerance)
+            {
+                delete frame;
+                frame = 0;
+                if(clock)
+                    clock->FramesDropped(1);
+            }
+        }
+    }
+    NotifyDecoders();
+    if(!frame)
+        return Waiting;
+
+    if(frame->IsGap())
+    {
+        timeline->current_interval = 0;
+    }
+    else
+    {
+        Timeline::Interval * interval = timeline->FindIntervalBySecond(frame->second);
+        if(interval && interval->movie->filename == frame->filename)
+        {
+            interval->movie->ShowPicture(&frame->picture);
+            timeline->current_interval = interval;
+        }
+    }
+    timeline->current = frame->second;
+    if(clock)
+        clock->FramePresented(frame->second);
+    delete frame;
+    return Presented;
+}
@@ -0,0 +1,136 @@
+#ifndef REVERSE_PLAYER_H
+#define REVERSE_PLAYER_H
+#include "juce/juce.h"
+#include "movie.h"
+#include "timeline.h"
+#include "playbackClock.h"
+#include <vector>
+#include <set>
+using namespace std;
+
+// Decoded picture in the pixel format of the decoder, converted only when shown
+class ReverseFrame
+{
+    public:
+    double second;
+    // empty for a gap between intervals
+    String filename;
+    AVPicture picture;
+    int size;
+    ReverseFrame(double second, const String & filename);
+    ~ReverseFrame();
+    void Copy(AVFrame * frame, AVCodecContext * codec);
+    bool IsGap(){return filename.isEmpty();}
+};
+
+// Part of one interval starting at a keyframe. It is decoded forward by
+// one of the workers and then played from the end to the beginning
+class ReverseChunk
+{
+    public:
+    // timeline seconds, end is not included
+    double start;
+    double end;
+    // movie seconds
+    double movie_start;
+    double movie_end;
+    String filename;
+    int64 estimated_size;
+    // milliseconds spent by the worker
+    double decode_millis;
+    bool done;
+    bool cancelled;
+    vector<ReverseFrame*> frames;
+    ReverseChunk();
+    ~ReverseChunk();
+};
+
+class ReversePlayer;
+
+class ReverseDecoder : public Thread
+{
+    private:
+    ReversePlayer * player;
+    vector<Movie*> movies;
+    Movie * GetMovie(const String & filename);
+    void Decode(ReverseChunk * chunk);
+
+    public:
+    ReverseDecoder(ReversePlayer * player);
+    ~ReverseDecoder();
+    void run();
+};
+
+// Reverse playback. Workers decode whole GOPs ahead of the play position in
+// reverse order into a stack of frames limited by REVERSE_PLAYBACK_MEMORY,
+// the message thread takes frames from the top of the stack.
+class ReversePlayer
+{
+    friend class ReverseDecoder;
+    private:
+    class Source
+    {
+        public:
+        String filename;
+        double start;
+        double end;
+        double absolute_start;
+        double absolute_end;
+        double fps;
+        int frame_size;
+    };
+    class KeyFrames
+    {
+        public:
+        String filename;
+        set<double> seconds;
+    };
+
+    CriticalSection critical;
+    vector<Source> sources;
+    vector<KeyFrames> keyframes;
+    vector<ReverseChunk*> chunks;
+    vector<ReverseDecoder*> decoders;
+    bool playing;
+    double origin;
+    double schedule_end;
+    double fps;
+    int step;
+    int64 memory_used;
+    int64 memory_limit;
+    PlaybackClock * clock;
+    // movie seconds decoded per second by one worker
+    double decode_speed;
+
+    Source * FindSource(double second, double & gap_start);
+    bool IsOnGrid(double second);
+    void AddKeyFrame(const String & filename, double second);
+    bool FindKeyFrameBefore(const String & filename, double second, double & keyframe);
+    ReverseChunk * ScheduleChunk();
+    ReverseChunk * ClaimChunk();
+    void ChunkDone(ReverseChunk * chunk);
+    void NotifyDecoders();
+
+    public:
+    ReversePlayer(PlaybackClock * clock = 0);
+    ~ReversePlayer();
+
+    // step - only every step-th frame is decoded and shown
+    void Start(Timeline * timeline, double second, int step = 1);
+    void Stop();
+    bool IsPlaying();
+    // frames per second all workers are able to decode, 0 if not known yet
+    double GetDecodeRate();
+
+    enum PresentResult
+    {
+        Presented,
+        Waiting,
+        Finished
+    };
+    // Shows the frame for the timeline second dest, frames after it are
+    // dropped. Called on the message thread
+    PresentResult PresentNext(Timeline * timeline, double dest);
+};
+
+#endif
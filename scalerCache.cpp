@@ -0,0 +1,129 @@
+#include "config.h"
+#include "scalerCache.h"
+#include "localization.h"
+using namespace localization;
+
+int GetScaleFlags(int quality)
+{
+    switch(quality)
+    {
+    case SCALE_QUALITY_FAST_BILINEAR:
+        return SWS_FAST_BILINEAR;
+    case SCALE_QUALITY_BILINEAR:
+        return SWS_BILINEAR;
+    case SCALE_QUALITY_LANCZOS:
+        return SWS_LANCZOS;
+    default:
+        return SWS_BICUBIC;
+    }
+}
+
+String GetScaleQualityName(int quality)
+{
+    switch(quality)
+    {
+    case SCALE_QUALITY_FAST_BILINEAR:
+        return LABEL_SCALE_QUALITY_FAST_BILINEAR;
+    case SCALE_QUALITY_BILINEAR:
+        return LABEL_SCALE_QUALITY_BILINEAR;
+    case SCALE_QUALITY_LANCZOS:
+        return LABEL_SCALE_QUALITY_LANCZOS;
+    default:
+        return LABEL_SCALE_QUALITY_BICUBIC;
+    }
+}
+
+ScalerCache::ScalerCache()
+{
+    counter = 0;
+}
+
+ScalerCache::~ScalerCache()
+{
+    Clear();
+}
+
+SwsContext * ScalerCache::Get(int srcW, int srcH, PixelFormat srcFormat, int dstW, int dstH, PixelFormat dstFormat, int flags)
+{
+    counter++;
+    for(vector<Entry>::iterator it = entries.begin(); it!=entries.end(); ++it)
+    {
+        if(it->srcW == srcW && it->srcH == srcH && it->srcFormat == srcFormat
+           && it->dstW == dstW && it->dstH == dstH && it->dstFormat == dstFormat
+           && it->flags == flags)
+        {
+            it->used = counter;
+            return it->context;
+        }
+    }
+
+    SwsContext * context = sws_getContext(srcW, srcH, srcFormat, dstW, dstH, dstFormat, flags, NULL, NULL, NULL);
+    if(!context)
+        return 0;
+
+    if(entries.size() >= RENDER_SCALER_CACHE)
+    {
+        vector<Entry>::iterator oldest = entries.begin();
+        for(vector<Entry>::iterator it = entries.begin(); it!=entries.end(); ++it)
+            if(it->used < oldest->used)
+                oldest = it;
+        sws_freeContext(oldest->context);
+        entries.erase(oldest);
+    }
+
+    Entry entry;
+    entry.srcW = srcW;
+    entry.srcH = srcH;
+    entry.srcFormat = srcFormat;
+    entry.dstW = dstW;
+    entry.dstH = dstH;
+    entry.dstFormat = dstFormat;
+    entry.flags = flags;
+    entry.context = context;
+    entry.used = counter;
+    entries.push_back(entry);
+    return context;
+}
+
+void ScalerCache::Clear()
+{
+    for(vector<Entry>::iterator it = entries.begin(); it!=entries.end(); ++it)
+        sws_freeContext(it->context);
+    entries.clear();
+}
+
+String BenchmarkScaleQualities(AVPicture * src, int srcW, int srcH, PixelFormat srcFormat, int dstW, int dstH)
+{
+    AVPicture dst;
+    if(avpicture_alloc(&dst, PIX_FMT_YUV420P, dstW, dstH) < 0)
+        return String::empty;
+
+    String res = String(srcW) + "x" + String(srcH) + " -> " + String(dstW) + "x" + String(dstH) + "\n";
+    double fastest = 0.0;
+    for(int quality = 0; quality<SCALE_QUALITY_COUNT; ++quality)
+    {
+        double before = Time::getMillisecondCounterHiRes();
+        SwsContext * context = sws_getContext(srcW, srcH, srcFormat, dstW, dstH, PIX_FMT_YUV420P, GetScaleFlags(quality), NULL, NULL, NULL);
+        double create_millis = Time::getMillisecondCounterHiRes() - before;
+        if(!context)
+            continue;
+
+        // the first frame warms up the caches of the processor
+        sws_scale(context, src->data, src->linesize, 0, srcH, dst.data, dst.linesize);
+        before = Time::getMillisecondCounterHiRes();
+        for(int i = 0; i<SCALE_BENCHMARK_FRAMES; ++i)
+            sws_scale(context, src->data, src->linesize, 0, srcH, dst.data, dst.linesize);
+        double frame_millis = (Time::getMillisecondCounterHiRes() - before) / SCALE_BENCHMARK_FRAMES;
+        sws_freeContext(context);
+
+        // cost relative to the fastest quality
+        if(fastest <= 0.0)
+            fastest = frame_millis;
+        res += GetScaleQualityName(quality) + ": " + String(frame_millis, 2) + " " + LABEL_MILLISECONDS_PER_FRAME;
+        if(fastest > 0.0)
+            res += " (x" + String(frame_millis / fastest, 1) + ")";
+        res += ", " + LABEL_SCALE_BENCHMARK_CONTEXT + " " + String(create_millis, 2) + " " + LABEL_MINI_SECONDS + "\n";
+    }
+    avpicture_free(&dst);
+    return res;
+}
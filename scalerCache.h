@@ -0,0 +1,56 @@
+#ifndef SCALER_CACHE_H
+#define SCALER_CACHE_H
+#include "movie.h"
+
+// Quality of the scaling, from the fastest one for drafts and previews to
+// the sharpest one for the final render
+enum ScaleQuality
+{
+    SCALE_QUALITY_FAST_BILINEAR = 0,
+    SCALE_QUALITY_BILINEAR,
+    SCALE_QUALITY_BICUBIC,
+    SCALE_QUALITY_LANCZOS,
+    SCALE_QUALITY_COUNT
+};
+
+// flags of sws_getContext for the quality
+int GetScaleFlags(int quality);
+String GetScaleQualityName(int quality);
+
+// Scaling contexts of a render. Intervals of the timeline often come from
+// the sources of the same size, so the context made for one interval is
+// kept for the next ones instead of being made again. A context can be used
+// by one thread only, so every scaling thread keeps its own cache
+class ScalerCache
+{
+    private:
+    class Entry
+    {
+        public:
+        int srcW;
+        int srcH;
+        PixelFormat srcFormat;
+        int dstW;
+        int dstH;
+        PixelFormat dstFormat;
+        int flags;
+        SwsContext * context;
+        // the least recently used entry is dropped when the cache is full
+        int64 used;
+    };
+    vector<Entry> entries;
+    int64 counter;
+
+    public:
+    ScalerCache();
+    ~ScalerCache();
+    // 0 if the context can't be made
+    SwsContext * Get(int srcW, int srcH, PixelFormat srcFormat, int dstW, int dstH, PixelFormat dstFormat, int flags);
+    void Clear();
+};
+
+// milliseconds per frame of every quality for the picture scaled to the
+// size of the output, and the time to make the context
+String BenchmarkScaleQualities(AVPicture * src, int srcW, int srcH, PixelFormat srcFormat, int dstW, int dstH);
+
+#endif
@@ -0,0 +1,223 @@
+#include "config.h"
+#include "seekWorker.h"
+#include "movie.h"
+
+SeekRequest::SeekRequest(RequestType type, void * object, void (*callback)(void * object, SeekRequest * request))
+{
+    this->type = type;
+    this->object = object;
+    this->callback = callback;
+    dest = 0.0;
+    start = 0.0;
+    frames = 0;
+    decode = true;
+    accurate = true;
+    supersede = (type == GotoSecond);
+    id = 0;
+    cancelled = false;
+    result = false;
+    current = 0.0;
+    movie = 0;
+}
+
+class SeekCompleteMessage : public CallbackMessage
+{
+    public:
+    SeekRequest * request;
+    RequestToken::Ptr worker_token;
+    SeekCompleteMessage(SeekRequest * request, RequestToken * worker_token)
+    {
+        this->request = request;
+        this->worker_token = worker_token;
+    }
+    void messageCallback()
+    {
+        bool alive = worker_token->alive && (request->token == 0 || request->token->alive);
+        if(alive && request->callback)
+            request->callback(request->object, request);
+        delete request;
+    }
+};
+
+SeekWorker::SeekWorker(Movie * movie):Thread("seek thread")
+{
+    this->movie = movie;
+    pending = 0;
+    running = 0;
+    last_id = 0;
+    token = new RequestToken();
+    startThread(THREAD_PRIORITY_SEEK);
+}
+
+SeekWorker::~SeekWorker()
+{
+    token->alive = false;
+    CancelAll(false);
+    stopThread(10000);
+}
+
+void SeekWorker::Deliver(SeekRequest * request)
+{
+    (new SeekCompleteMessage(request, token))->post();
+}
+
+bool SeekWorker::Execute(SeekRequest * request)
+{
+    bool res = false;
+    switch(request->type)
+    {
+    case SeekRequest::GotoSecond:
+        res = movie->GotoSecondAndRead(request->dest,request->decode,request->accurate);
+        break;
+    case SeekRequest::GoBack:
+        res = movie->GoBack(request->frames);
+        if(res && request->decode && !movie->abort_request)
+            movie->DecodeFrame();
+        break;
+    case SeekRequest::KeyFrame:
+        res = movie->SeekToSecond(request->dest) && movie->ReadAndDecodeFrame();
+        // keyframe belongs to the part of the movie which was cut off
+        if((!res || movie->current < request->start) && !movie->abort_request)
+            res = movie->GotoSecondAndRead(request->start);
+        break;
+    case SeekRequest::ReadFrames:
+        res = true;
+        for(int i = 0; i<request->frames && res && !movie->abort_request; ++i)
+        {
+            if(request->decode && i == request->frames - 1)
+                res = movie->ReadAndDecodeFrame();
+            else
+                res = movie->SkipFrame();
+        }
+        break;
+    }
+    request->current = movie->current;
+    return res;
+}
+
+void SeekWorker::run()
+{
+    while(!threadShouldExit())
+    {
+        SeekRequest * request = 0;
+        {
+            const ScopedLock myScopedLock (requests_critical);
+            request = pending;
+            pending = 0;
+            running = request;
+            movie->abort_request = false;
+        }
+        if(!request)
+        {
+            wait(-1);
+            continue;
+        }
+
+        bool res = Execute(request);
+        {
+            const ScopedLock myScopedLock (requests_critical);
+            running = 0;
+            request->result = res;
+            if(movie->abort_request)
+                request->cancelled = true;
+            movie->abort_request = false;
+        }
+        Deliver(request);
+    }
+}
+
+int SeekWorker::Post(SeekRequest * request)
+{
+    SeekRequest * superseded = 0;
+    int id;
+    {
+        const ScopedLock myScopedLock (requests_critical);
+        request->movie = movie;
+        if(pending
+            && pending->type == SeekRequest::ReadFrames
+            && request->type == SeekRequest::ReadFrames
+            && pending->object == request->object
+            && pending->callback == request->callback)
+        {
+            // consecutive steps are merged into one
+            pending->frames += request->frames;
+            pending->decode = pending->decode || request->decode;
+            id = pending->id;
+            delete request;
+            request = 0;
+        }
+        else
+        {
+            id = request->id = ++last_id;
+            if(pending)
+            {
+                superseded = pending;
+                superseded->cancelled = true;
+            }
+            pending = request;
+            if(running && request->supersede)
+                movie->abort_request = true;
+        }
+    }
+    if(superseded)
+        Deliver(superseded);
+    notify();
+    return id;
+}
+
+bool SeekWorker::Cancel(int id)
+{
+    SeekRequest * cancelled = 0;
+    bool res = false;
+    {
+        const ScopedLock myScopedLock (requests_critical);
+        if(pending && pending->id == id)
+        {
+            cancelled = pending;
+            cancelled->cancelled = true;
+            pending = 0;
+            res = true;
+        }
+        else if(running && running->id == id)
+        {
+            running->cancelled = true;
+            movie->abort_request = true;
+            res = true;
+        }
+    }
+    if(cancelled)
+        Deliver(cancelled);
+    return res;
+}
+
+void SeekWorker::CancelAll(bool wait)
+{
+    SeekRequest * cancelled = 0;
+    {
+        const ScopedLock myScopedLock (requests_critical);
+        if(pending)
+        {
+            cancelled = pending;
+            cancelled->cancelled = true;
+            pending = 0;
+        }
+        if(running)
+        {
+            running->cancelled = true;
+            movie->abort_request = true;
+        }
+    }
+    if(cancelled)
+        Deliver(cancelled);
+    if(wait)
+    {
+        while(!IsIdle())
+            Thread::sleep(1);
+    }
+}
+
+bool SeekWorker::IsIdle()
+{
+    const ScopedLock myScopedLock (requests_critical);
+    return !pending && !running;
+}
@@ -0,0 +1,78 @@
+#ifndef SEEK_WORKER_H
+#define SEEK_WORKER_H
+#include "juce/juce.h"
+
+class Movie;
+
+// Shared flag which lets a posted completion message find out
+// whether the object it was addressed to is still alive
+class RequestToken : public ReferenceCountedObject
+{
+    public:
+    bool alive;
+    RequestToken(){alive = true;}
+    typedef ReferenceCountedObjectPtr<RequestToken> Ptr;
+};
+
+class SeekRequest
+{
+    public:
+    enum RequestType
+    {
+        GotoSecond,
+        GoBack,
+        ReadFrames,
+        KeyFrame
+    }type;
+
+    // GotoSecond, KeyFrame - movie second to go to
+    double dest;
+    // KeyFrame - the keyframe is not taken before this movie second
+    double start;
+    // GoBack, ReadFrames - number of frames
+    int frames;
+    bool decode;
+    bool accurate;
+
+    // newer request replaces this one even if it is already running
+    bool supersede;
+
+    int id;
+    bool cancelled;
+    bool result;
+    // movie position after the request was executed
+    double current;
+    Movie * movie;
+
+    // called on the message thread
+    void * object;
+    void (*callback)(void * object, SeekRequest * request);
+    RequestToken::Ptr token;
+
+    SeekRequest(RequestType type, void * object, void (*callback)(void * object, SeekRequest * request));
+};
+
+class SeekWorker : public Thread
+{
+    private:
+    Movie * movie;
+    CriticalSection requests_critical;
+    SeekRequest * pending;
+    SeekRequest * running;
+    int last_id;
+    RequestToken::Ptr token;
+    bool Execute(SeekRequest * request);
+    void Deliver(SeekRequest * request);
+
+    public:
+    SeekWorker(Movie * movie);
+    ~SeekWorker();
+    void run();
+
+    int Post(SeekRequest * request);
+    bool Cancel(int id);
+    void CancelAll(bool wait);
+    bool IsIdle();
+};
+
+#endif
@@ -0,0 +1,197 @@
+#include "config.h"
+#include "shuttle.h"
+#include <math.h>
+
+#define SHUTTLE_MIN_SPEED 0.25
+#define SHUTTLE_MAX_SPEED 16.0
+
+Shuttle::Shuttle()
+{
+    reverse_player = new ReversePlayer(&clock);
+    reverse_used = false;
+    speed = 0.0;
+    step = 1;
+    waiting = false;
+    request_millis = 0.0;
+    request_frames = 0;
+    request_key = false;
+    trick_play = false;
+    decode_cost = 0.0;
+}
+
+Shuttle::~Shuttle()
+{
+    delete reverse_player;
+}
+
+void Shuttle::Start(double speed)
+{
+    reverse_player->Stop();
+    trick_play = false;
+    this->speed = speed;
+    // frames between the shown ones are skipped on purpose
+    step = jmax(1, (int)(fabs(speed) + 0.5));
+    // clock starts with the first frame, when seek requests are done
+    clock.Stop();
+}
+
+bool Shuttle::Stop()
+{
+    bool res = reverse_used;
+    reverse_player->Stop();
+    reverse_used = false;
+    trick_play = false;
+    speed = 0.0;
+    clock.Stop();
+    return res;
+}
+
+bool Shuttle::IsPlaying()
+{
+    return speed != 0.0;
+}
+
+double Shuttle::Faster(double speed, bool forward)
+{
+    if(!forward)
+        return -Faster(-speed, true);
+    if(speed<=0.0)
+        return 1.0;
+    return jmin(SHUTTLE_MAX_SPEED, speed * 2.0);
+}
+
+double Shuttle::Slower(double speed, bool forward)
+{
+    if(!forward)
+        return -Slower(-speed, true);
+    if(speed<=0.0)
+        return 0.5;
+    return jmax(SHUTTLE_MIN_SPEED, speed / 2.0);
+}
+
+bool Shuttle::NeedTrickPlay(double frames_per_second, double decode_rate)
+{
+    // unknown rate means nothing was decoded yet
+    return decode_rate>0.0 && frames_per_second > decode_rate * 0.8;
+}
+
+int Shuttle::Tick(Timeline * timeline, void * object, void (*shown)(void * object))
+{
+    if(!IsPlaying())
+        return -1;
+    double fps = timeline->GetFps();
+    if(!clock.IsStarted())
+        clock.Start(timeline->current, speed, fps);
+    double dest = clock.GetSecond();
+
+    waiting = false;
+    bool res = (speed>0.0)?TickForward(timeline, dest, fps, object, shown):TickReverse(timeline, dest, fps, object, shown);
+    if(!res)
+        return -1;
+
+    // next frame is shown at its presentation time
+    double next = timeline->current + ((speed>0.0)?step:-step) / fps;
+    if(trick_play)
+        next = clock.GetSecond() + speed / fps;
+    double millis = clock.GetMillis(next) - Time::getMillisecondCounterHiRes();
+    // reverse player or seek thread has no frame yet, don't spin on the message thread
+    return jlimit(waiting?5:1, 1000, (int)millis);
+}
+
+bool Shuttle::TickForward(Timeline * timeline, double dest, double fps, void * object, void (*shown)(void * object))
+{
+    if(timeline->current >= timeline->duration)
+        return false;
+    if(dest > timeline->duration)
+        dest = timeline->duration;
+
+    trick_play = NeedTrickPlay(fps * speed, (decode_cost>0.0)?1000.0 / decode_cost:0.0);
+    if(trick_play)
+    {
+        RequestKeyFrame(timeline, dest, object, shown);
+        return dest < timeline->duration;
+    }
+
+    // the frame asked for before is not decoded yet
+    if(timeline->IsRequestPending())
+    {
+        waiting = true;
+        return true;
+    }
+    int behind = (int)((dest - timeline->current) * fps + 0.5);
+    if(behind<1)
+        return true;
+
+    // late frames are only decoded by the seek thread, the last one is shown
+    if(behind > step)
+        clock.FramesDropped(behind - step);
+    request_millis = Time::getMillisecondCounterHiRes();
+    request_frames = behind;
+    request_key = false;
+    timeline->SkipFramesAsync(behind, object, shown);
+    return true;
+}
+
+/* a keyframe asked for while another one is decoded waits for it and is
+   replaced by the next one, so the seek thread is never more than one
+   keyframe behind the clock */
+void Shuttle::RequestKeyFrame(Timeline * timeline, double dest, void * object, void (*shown)(void * object))
+{
+    if(!timeline->IsRequestPending())
+        request_millis = Time::getMillisecondCounterHiRes();
+    request_frames = 1;
+    request_key = true;
+    timeline->GotoKeyFrameAsync(dest, object, shown);
+}
+
+void Shuttle::FrameShown(Timeline * timeline)
+{
+    if(request_frames>0)
+    {
+        double now = Time::getMillisecondCounterHiRes();
+        double cost = (now - request_millis) / request_frames;
+        for(int i = 0; i<request_frames; ++i)
+            clock.AddDecodeTime(cost);
+        // a keyframe costs more than the next frame, it tells nothing of the decoder speed
+        if(!request_key)
+            decode_cost = (decode_cost>0.0)?decode_cost * 0.8 + cost * 0.2:cost;
+        // the keyframe waiting behind this one starts now
+        request_millis = now;
+        if(!request_key)
+            request_frames = 0;
+    }
+    // the keyframe of trick-play is at or before the time of the clock
+    clock.FramePresented(timeline->current);
+}
+
+bool Shuttle::TickReverse(Timeline * timeline, double dest, double fps, void * object, void (*shown)(void * object))
+{
+    if(dest < 0.0)
+        dest = 0.0;
+
+    trick_play = NeedTrickPlay(-fps * speed, reverse_player->GetDecodeRate());
+    if(trick_play)
+    {
+        if(reverse_player->IsPlaying())
+            reverse_player->Stop();
+        if(timeline->current <= 0.0)
+            return false;
+        RequestKeyFrame(timeline, dest, object, shown);
+        return true;
+    }
+
+    // the reverse player starts from the keyframe being decoded
+    if(timeline->IsRequestPending())
+    {
+        waiting = true;
+        return true;
+    }
+    if(!reverse_player->IsPlaying())
+    {
+        reverse_player->Start(timeline, timeline->current, step);
+        reverse_used = true;
+    }
+    ReversePlayer::PresentResult res = reverse_player->PresentNext(timeline, dest);
+    waiting = res == ReversePlayer::Waiting;
+    return res != ReversePlayer::Finished;
+}
@@ -0,0 +1,54 @@
+#ifndef SHUTTLE_H
+#define SHUTTLE_H
+#include "juce/juce.h"
+#include "timeline.h"
+#include "reversePlayer.h"
+#include "playbackClock.h"
+
+// Variable speed playback in both directions (J/K/L keys). Position follows
+// the clock: frames which are late are decoded but not shown, and when the
+// decoder can't keep up with the speed only keyframes are shown (trick-play).
+// Frames going forward and the keyframes are decoded by the seek thread of
+// the movie, the message thread only shows them
+class Shuttle
+{
+    private:
+    ReversePlayer * reverse_player;
+    bool reverse_used;
+    int step;
+    bool waiting;
+    // the request of the seek thread: when it was posted or the one before it
+    // was shown, frames it reads and whether it is a keyframe of trick-play
+    double request_millis;
+    int request_frames;
+    bool request_key;
+    bool NeedTrickPlay(double frames_per_second, double decode_rate);
+    bool TickForward(Timeline * timeline, double dest, double fps, void * object, void (*shown)(void * object));
+    bool TickReverse(Timeline * timeline, double dest, double fps, void * object, void (*shown)(void * object));
+    void RequestKeyFrame(Timeline * timeline, double dest, void * object, void (*shown)(void * object));
+
+    public:
+    double speed;
+    bool trick_play;
+    // milliseconds to decode one frame forward, measured while playing
+    double decode_cost;
+    PlaybackClock clock;
+
+    Shuttle();
+    ~Shuttle();
+    void Start(double speed);
+    // returns true if the movie decoder has to be moved to the shown frame
+    bool Stop();
+    bool IsPlaying();
+    // asks for the frame of the current clock time, shown - called on the
+    // message thread when the seek thread has decoded it. Returns milliseconds
+    // until the next frame is due or -1 when the end of the timeline is reached
+    int Tick(Timeline * timeline, void * object, void (*shown)(void * object));
+    // called from shown, the requested frame is the current one of the timeline
+    void FrameShown(Timeline * timeline);
+
+    static double Faster(double speed, bool forward);
+    static double Slower(double speed, bool forward);
+};
+
+#endif
@@ -5,6 +5,7 @@
 
 void taskTab::timerCallback()
 {
+    GetTaskSnapshots(snapshots);
     table.updateContent();
     repaint();
 }
@@ -32,6 +33,8 @@ taskTab::taskTab():DocumentWindow(LABEL_TASK_TAB,Colours::whitesmoke,DocumentWin
     table.getHeader().addColumn(String::empty,3,26,26,26,TableHeaderComponent::visible | TableHeaderComponent::appearsOnColumnMenu | TableHeaderComponent::draggable);
     table.getHeader().addColumn(LABEL_TASK_TAB_DESCRPTION,4,328,328,900,TableHeaderComponent::visible | TableHeaderComponent::appearsOnColumnMenu | TableHeaderComponent::draggable | TableHeaderComponent::resizable);
     table.getHeader().addColumn(LABEL_TASK_TAB_TIME_LEFT,5,70,70,70,TableHeaderComponent::visible | TableHeaderComponent::appearsOnColumnMenu | TableHeaderComponent::draggable );
+    table.getHeader().addColumn(LABEL_TASK_TAB_CORES,7,60,60,60,TableHeaderComponent::visible | TableHeaderComponent::appearsOnColumnMenu | TableHeaderComponent::draggable );
+    table.getHeader().addColumn(LABEL_TASK_TAB_PRIORITY,8,80,80,80,TableHeaderComponent::visible | TableHeaderComponent::appearsOnColumnMenu | TableHeaderComponent::draggable );
     table.getHeader().addColumn(LABEL_TASK_TAB_PROGRESS,6,170,170,900,TableHeaderComponent::visible | TableHeaderComponent::appearsOnColumnMenu | TableHeaderComponent::draggable | TableHeaderComponent::resizable);
     table.setHeaderHeight(30);
 
@@ -51,6 +54,7 @@ void taskTab::add()
     setVisible(true);
     addToDesktop(ComponentPeer::windowHasCloseButton || ComponentPeer::windowHasTitleBar || ComponentPeer::windowIsResizable);
     isVisible = true;
+    timerCallback();
     startTimer(1000);
 }
 
@@ -72,7 +76,7 @@ taskTab::~taskTab()
 }
 int taskTab::getNumRows()
 {
-    return GetTaskLength();
+    return (int)snapshots.size();
 }
 
 void taskTab::paintRowBackground (Graphics& g, int rowNumber, int width, int height, bool rowIsSelected)
@@ -82,13 +86,37 @@ void taskTab::paintRowBackground (Graphics& g, int rowNumber, int width, int hei
 
 void taskTab::cellClicked(int rowNumber, int columnId, const MouseEvent& e)
 {
+    if(rowNumber < 0 || rowNumber >= (int)snapshots.size())
+        return;
+    // modal windows below let the timer refresh the snapshots
+    TaskSnapshot t_copy = snapshots[rowNumber];
+    if(e.mods.isRightButtonDown())
+    {
+        int length = (int)snapshots.size();
+        PopupMenu context_menu;
+        context_menu.addItem(1000, LABEL_TASK_TAB_MOVE_TOP, rowNumber > 0, false);
+        context_menu.addItem(1001, LABEL_TASK_TAB_MOVE_UP, rowNumber > 0, false);
+        context_menu.addItem(1002, LABEL_TASK_TAB_MOVE_DOWN, rowNumber < length - 1, false);
+        context_menu.addItem(1003, LABEL_TASK_TAB_MOVE_BOTTOM, rowNumber < length - 1, false);
+        switch(context_menu.show())
+        {
+            case 1000: MoveTask(rowNumber,0);break;
+            case 1001: MoveTask(rowNumber,rowNumber - 1);break;
+            case 1002: MoveTask(rowNumber,rowNumber + 1);break;
+            case 1003: MoveTask(rowNumber,length - 1);break;
+        }
+        timerCallback();
+        return;
+    }
     switch(columnId)
     {
+        case 8:
+        {
+            SetTaskPriority(rowNumber,(t_copy.priority + 1) % (task::High + 1));
+            timerCallback();
+        }break;
         case 3:
         {
-            task t_copy;
-            if(!FindTaskByNumberAndCopy(rowNumber,t_copy))
-                return;
             bool answer = true;
             if(t_copy.state != task::Done && t_copy.state != task::Failed)
                 answer = AlertWindow::showOkCancelBox(AlertWindow::QuestionIcon,LABEL_TASK_TAB_CONFIRM_DELETE,t_copy.filename,LABEL_YES,LABEL_NO);
@@ -100,9 +128,6 @@ void taskTab::cellClicked(int rowNumber, int columnId, const MouseEvent& e)
         }break;
         case 2:
         {
-            task t_copy;
-            if(!FindTaskByNumberAndCopy(rowNumber,t_copy))
-                return;
             switch(t_copy.state)
             {
                 case task::Working: PauseTask(rowNumber);timerCallback();break;
@@ -122,9 +147,9 @@ void taskTab::cellClicked(int rowNumber, int columnId, const MouseEvent& e)
 
 void taskTab::paintCell (Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected)
 {
-    task t_copy;
-    if(!FindTaskByNumberAndCopy(rowNumber,t_copy))
+    if(rowNumber < 0 || rowNumber >= (int)snapshots.size())
         return;
+    const TaskSnapshot & t_copy = snapshots[rowNumber];
     String text_to_draw = String::empty;
     Justification just = Justification::centredLeft;
     switch(columnId)
@@ -135,8 +160,16 @@ void taskTab::paintCell (Graphics& g, int rowNumber, int columnId, int width, in
             {
                 text_to_draw = text_to_draw + " (" + LABEL_SAVE_VIDEO_PAUSED + ")";
             };
+            if(t_copy.frames>0 && t_copy.state != task::Failed)
+                text_to_draw = text_to_draw + "  " + LABEL_FRAMES + " " + String(t_copy.frames) + ", " + String((double)t_copy.bytes / (1024.0 * 1024.0), 1) + " " + LABEL_MEGABYTES;
+            if(t_copy.utilisation.isNotEmpty() && t_copy.state != task::Failed)
+                text_to_draw = text_to_draw + "  [" + t_copy.utilisation + "]";
+        break;
+        case 4:
+            text_to_draw = t_copy.filename;
+            if(t_copy.renditions>0)
+                text_to_draw += " (+" + String(t_copy.renditions) + ")";
         break;
-        case 4:text_to_draw = t_copy.filename;break;
         case 1:
         {
             switch(t_copy.type)
@@ -178,6 +211,22 @@ void taskTab::paintCell (Graphics& g, int rowNumber, int columnId, int width, in
             else
                 text_to_draw = "-";
         break;
+        case 7:
+            just = Justification::centred;
+            if(t_copy.cores>0)
+                text_to_draw = String(t_copy.cores) + "/" + String(SystemStats::getNumCpus());
+            else
+                text_to_draw = "-";
+        break;
+        case 8:
+            just = Justification::centred;
+            switch(t_copy.priority)
+            {
+                case task::Low: text_to_draw = LABEL_TASK_PRIORITY_LOW; break;
+                case task::Normal: text_to_draw = LABEL_TASK_PRIORITY_NORMAL; break;
+                case task::High: text_to_draw = LABEL_TASK_PRIORITY_HIGH; break;
+            }
+        break;
 
     }
     if(text_to_draw.length()>0)
@@ -2,6 +2,7 @@
 #define TASK_TAB
 #include "juce/juce.h"
 #include "localization.h"
+#include "tasks.h"
 using namespace localization;
 class taskTab : DocumentWindow, public TableListBoxModel, public Timer
 {
@@ -20,6 +21,8 @@ class taskTab : DocumentWindow, public TableListBoxModel, public Timer
     void resized();
     void timerCallback();
     Image encoding,play,close,pause,open;
+    // the tasks as they were at the last refresh, cells are painted from it
+    vector<TaskSnapshot> snapshots;
     void cellClicked(int rowNumber, int columnId, const MouseEvent& e);
 };
 
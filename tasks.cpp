@@ -1,12 +1,93 @@
 #include "config.h"
 #include "tasks.h"
 #include "localization.h"
+#include "frameArena.h"
+#include "renderQueue.h"
+#include <algorithm>
 using namespace localization;
 
 vector<task *> tasks_list;
 CriticalSection tasks_list_critical;
+RenderQueueJournal tasks_journal;
+int next_task_id = 1;
 
 
+TaskProgress::TaskProgress()
+{
+    progress = 0.0;
+    frames = 0;
+    bytes = 0;
+    reported = false;
+    utilisation[0] = 0;
+}
+
+/* the increments of the atomic are full barriers, the values are not
+   written before the sequence turns odd nor after it turns even */
+void TaskProgress::BeginWrite()
+{
+    ++sequence;
+}
+
+void TaskProgress::EndWrite()
+{
+    ++sequence;
+}
+
+void TaskProgress::SetProgress(double progress)
+{
+    BeginWrite();
+    this->progress = progress;
+    reported = true;
+    EndWrite();
+}
+
+void TaskProgress::SetFrames(int64 frames, int64 bytes)
+{
+    BeginWrite();
+    this->frames = frames;
+    this->bytes = bytes;
+    EndWrite();
+}
+
+void TaskProgress::SetUtilisation(const String & utilisation)
+{
+    const char * text = utilisation.toUTF8();
+    int length = jmin((int)strlen(text), RENDER_PROGRESS_TEXT - 1);
+    // a character of several bytes is not cut in the middle
+    while(length > 0 && length < (int)strlen(text) && (text[length] & 0xc0) == 0x80)
+        length--;
+    BeginWrite();
+    memcpy(this->utilisation, text, length);
+    this->utilisation[length] = 0;
+    EndWrite();
+}
+
+TaskProgress::Values TaskProgress::Read() const
+{
+    Values res;
+    char text[RENDER_PROGRESS_TEXT];
+    for(;;)
+    {
+        int before = sequence.get();
+        if(before & 1)
+        {
+            Thread::yield();
+            continue;
+        }
+        res.progress = progress;
+        res.frames = frames;
+        res.bytes = bytes;
+        res.reported = reported;
+        memcpy(text, utilisation, RENDER_PROGRESS_TEXT);
+        Atomic<int>::memoryBarrier();
+        if(sequence.get() == before)
+            break;
+    }
+    text[RENDER_PROGRESS_TEXT - 1] = 0;
+    res.utilisation = String::fromUTF8(text);
+    return res;
+}
+
 task::task(Timeline * timeline, TaskType type, Movie::Info info,String filename, String status):Thread("task thread")
 {
     this->timeline = timeline;
@@ -15,82 +96,345 @@ task::task(Timeline * timeline, TaskType type, Movie::Info info,String filename,
     this->filename = filename;
     this->status = status;
     this->millis_worked = 0;
-    this->millis_left = 0;
+    this->cores = 0;
+    this->released = false;
+    this->finishing = false;
+    this->allocated = false;
+    this->priority = Normal;
+    this->memory = 0;
+    this->demand = 1;
+    this->passed_over = 0;
+    this->id = 0;
 }
 
-task::task():Thread("task thread")
+task::~task()
 {
 
 }
 
-void task::copy(task*copy_task)
+void _ReportProgress(task* thread,double progress)
 {
-    this->type = copy_task->type;
-    this->filename = copy_task->filename;
-    this->status = copy_task->status;
-    this->state = copy_task->state;
-    this->millis_start = copy_task->millis_start;
-    this->millis_worked = copy_task->millis_worked;
-    this->millis_left = copy_task->millis_left;
-
-    if(!copy_task->isThreadRunning())
-        this->millis_left = 0;
+    thread->measures.SetProgress(progress);
+}
+void ReportTaskUtilisation(task * t, const String & utilisation)
+{
+    t->measures.SetUtilisation(utilisation);
 }
 
-task::~task()
+void ReportTaskFrames(task * t, int64 frames, int64 bytes)
 {
+    t->measures.SetFrames(frames, bytes);
+}
 
+bool _CompareTaskPriorities(const task * a, const task * b)
+{
+    return a->priority > b->priority;
 }
 
-void _ReportProgress(task* thread,double progress)
+/* cores of the machine are shared by the working tasks up to their demands,
+   every round gives the tasks wanting more an equal part of the rest. Cores
+   nobody asked for go round the tasks, higher priority first. Called with
+   tasks_list_critical held whenever a task starts, pauses or stops */
+void _BalanceCores()
 {
+    vector<task*> working;
+    for(vector<task*>::iterator it = tasks_list.begin(); it!=tasks_list.end(); it++)
+    {
+        (*it)->cores = 0;
+        if((*it)->state == task::Working)
+            working.push_back(*it);
+    }
+    if(working.empty())
+        return;
+    stable_sort(working.begin(), working.end(), _CompareTaskPriorities);
 
+    int rest = SystemStats::getNumCpus();
+    for(;;)
     {
-        const ScopedLock myScopedLock (tasks_list_critical);
-        if(thread->state == task::Suspended)
-            return;
-        if(progress>0.001)
-            thread->millis_left = ((double)(thread->millis_worked + Time::currentTimeMillis() - thread->millis_start)) * (1.0-progress) / progress;
-        else
-            thread->millis_left = 0;
-        thread->status = "    " + String(int(progress*100.0)) + "%";
+        int wanting = 0;
+        for(vector<task*>::iterator it = working.begin(); it!=working.end(); it++)
+        {
+            if((*it)->cores < (*it)->demand)
+                wanting++;
+        }
+        if(!wanting || rest <= 0)
+            break;
+        int share = jmax(1, rest / wanting);
+        for(vector<task*>::iterator it = working.begin(); it!=working.end() && rest > 0; it++)
+        {
+            int part = jmin(share, jmin(rest, (*it)->demand - (*it)->cores));
+            if(part <= 0)
+                continue;
+            (*it)->cores += part;
+            rest -= part;
+        }
+    }
+    for(int i = 0; rest > 0; i = (i + 1) % (int)working.size())
+    {
+        working[i]->cores++;
+        rest--;
     }
+    // more tasks than cores share them
+    for(vector<task*>::iterator it = working.begin(); it!=working.end(); it++)
+        (*it)->cores = jmax(1, (*it)->cores);
 }
-void FindSuspendedTaskAndLaunch()
+
+int GetTaskCores(task * t)
 {
     const ScopedLock myScopedLock (tasks_list_critical);
+    return jmax(1, t->cores);
+}
+
+/* a released task whose thread has not looked at its state yet is picked
+   up again by that thread, which takes the lock for it. Only a thread which
+   has looked is waited for: it does not take the lock any more. Called with
+   tasks_list_critical held */
+void _StartTaskThread(task * t)
+{
+    if(t->released && !t->finishing)
+    {
+        t->released = false;
+        return;
+    }
+    if(t->finishing)
+        t->waitForThreadToExit(-1);
+    t->released = false;
+    t->finishing = false;
+    if(!t->isThreadRunning())
+        t->startThread(THREAD_PRIORITY_ENCODE);
+}
+
+/* decoders and files of the sources are closed while the task is suspended */
+void _ReleaseMovies(Timeline * timeline)
+{
+    for(vector<Timeline::Interval *>::iterator it = timeline->intervals.begin(); it!=timeline->intervals.end(); it++)
+    {
+        if((*it)->movie->loaded)
+            (*it)->movie->Dispose();
+    }
+}
+
+/* called with tasks_list_critical held */
+bool _IsAnyTaskWorking()
+{
     for(vector<task*>::iterator it = tasks_list.begin(); it!=tasks_list.end(); it++)
     {
-        task::TaskState state = (*it)->state;
-        if(state == task::NotStarted || state == task::Suspended)
+        if((*it)->state == task::Working)
+            return true;
+    }
+    return false;
+}
+
+/* bytes of one output: pictures of the pipeline queues in the size of the
+   source and of the output, frames kept by the encoder and the references
+   of the decoder, for every segment encoded in parallel */
+int64 _EstimateOutputMemory(const Movie::Info & info, int64 source_pixels, int cores)
+{
+    int64 res = 2 * RENDER_OUTPUT_BUFFER;
+    if(info.audios.size()>0)
+        res += (int64)info.audios[0].sample_rate * info.audios[0].channels * sizeof(int16) * RENDER_AUDIO_BUFFER;
+    if(info.videos.size()==0)
+        return res;
+    const Movie::VideoInfo & video = info.videos[0];
+    int64 picture = (int64)video.width * video.height * 3 / 2;
+    int64 source = ((source_pixels>0)?source_pixels:(int64)video.width * video.height) * 3 / 2;
+    int encoder_frames = (video.codec_short == "libx264")?RENDER_SCHEDULER_X264_FRAMES:RENDER_SCHEDULER_ENCODER_FRAMES;
+    int64 segment = (RENDER_PIPELINE_QUEUE + 2) * (source + picture) + encoder_frames * picture + RENDER_SCHEDULER_DECODER_FRAMES * source;
+    int segments = (video.segments==0)?cores:jmax(1, video.segments);
+    return res + segment * segments;
+}
+
+/* x264 keeps a core busy with every RENDER_SCHEDULER_CORE_PIXELS of its
+   picture, the other encoders work in one thread. Every segment encoded in
+   parallel has its own encoder and decoder */
+int _EstimateOutputCores(const Movie::Info & info, int cores)
+{
+    if(info.videos.size()==0)
+        return 1;
+    const Movie::VideoInfo & video = info.videos[0];
+    int encoder = 1;
+    if(video.codec_short == "libx264")
+        encoder = (int)(((int64)video.width * video.height + RENDER_SCHEDULER_CORE_PIXELS - 1) / RENDER_SCHEDULER_CORE_PIXELS);
+    int segments = (video.segments==0)?cores:jmax(1, video.segments);
+    return (jmax(1, encoder) + 1) * segments;
+}
+
+/* the outputs of the job are rendered at once. Passes run one after
+   another, so their number changes neither the memory nor the cores */
+void _EstimateTask(task * t, int64 source_pixels)
+{
+    int cores = SystemStats::getNumCpus();
+    const vector<Movie::Info> outputs = (t->renditions.empty())?vector<Movie::Info>(1, t->info):t->renditions;
+    t->memory = 0;
+    t->demand = 0;
+    for(vector<Movie::Info>::const_iterator it = outputs.begin(); it!=outputs.end(); it++)
+    {
+        t->memory += _EstimateOutputMemory(*it, source_pixels, cores);
+        t->demand += _EstimateOutputCores(*it, cores);
+    }
+    t->demand = jlimit(1, cores, t->demand);
+}
+
+/* the job as it is written to the journal of the queue. Called with
+   tasks_list_critical held */
+RenderQueueJournal::Job _GetJournalJob(task * t)
+{
+    RenderQueueJournal::Job job;
+    job.id = t->id;
+    job.state = t->state;
+    job.priority = t->priority;
+    job.millis_worked = t->millis_worked;
+    job.progress = t->measures.Read().progress;
+    job.memory = t->memory;
+    job.demand = t->demand;
+    job.outputs = (t->renditions.empty())?vector<Movie::Info>(1, t->info):t->renditions;
+    for(vector<Timeline::Interval *>::iterator it = t->timeline->intervals.begin(); it!=t->timeline->intervals.end(); it++)
+    {
+        RenderQueueJournal::Part part;
+        part.filename = (*it)->movie->filename;
+        part.start = (*it)->start;
+        part.end = (*it)->end;
+        part.absolute_start = (*it)->absolute_start;
+        job.parts.push_back(part);
+    }
+    return job;
+}
+
+/* the grown journal is written again with the jobs which are not finished.
+   Called with tasks_list_critical held */
+void _CompactJournal()
+{
+    if(!tasks_journal.IsGrown())
+        return;
+    vector<RenderQueueJournal::Job> jobs;
+    for(vector<task*>::iterator it = tasks_list.begin(); it!=tasks_list.end(); it++)
+    {
+        if((*it)->type == task::Encoding && (*it)->state != task::Done && (*it)->state != task::Failed)
+            jobs.push_back(_GetJournalJob(*it));
+    }
+    tasks_journal.Compact(jobs);
+}
+
+/* finished jobs leave the journal, they are not started again. Called with
+   tasks_list_critical held */
+void _JournalState(task * t)
+{
+    if(t->type != task::Encoding || !tasks_journal.IsEnabled())
+        return;
+    if(t->state == task::Done || t->state == task::Failed)
+        tasks_journal.Remove(t->id);
+    else
+        tasks_journal.SetState(t->id, t->state, t->priority, t->millis_worked, t->measures.Read().progress);
+    _CompactJournal();
+}
+
+/* called with tasks_list_critical held */
+void _JournalOrder()
+{
+    if(!tasks_journal.IsEnabled())
+        return;
+    vector<int> ids;
+    for(vector<task*>::iterator it = tasks_list.begin(); it!=tasks_list.end(); it++)
+        ids.push_back((*it)->id);
+    tasks_journal.SetOrder(ids);
+    _CompactJournal();
+}
+
+/* called with tasks_list_critical held */
+void _LaunchTask(task * t)
+{
+    t->state = task::Working;
+    _StartTaskThread(t);
+    t->millis_start = Time::currentTimeMillis();
+    t->passed_over = 0;
+    _JournalState(t);
+}
+
+/* queued tasks are started while the machine has room for them: the
+   expected memory of the admitted tasks stays in the budget and some cores
+   are not asked for yet. Higher priority goes first, then the order of the
+   list. A task without room lets the smaller ones after it start, until it
+   has been passed over RENDER_SCHEDULER_PASSES times and the queue waits
+   for it. Suspended tasks are started only by the user. Called with
+   tasks_list_critical held */
+void _AdmitTasks()
+{
+    int64 budget = (int64)(SystemStats::getMemorySizeInMegabytes() * RENDER_SCHEDULER_MEMORY) * 1024 * 1024;
+    int cores = SystemStats::getNumCpus();
+    int64 memory = 0;
+    int demand = 0;
+    int working = 0;
+    vector<task*> queue;
+    for(vector<task*>::iterator it = tasks_list.begin(); it!=tasks_list.end(); it++)
+    {
+        task * t = *it;
+        if(t->state == task::Working)
         {
-            (*it)->state = task::Working;
-            if(!(*it)->isThreadRunning())
-                (*it)->startThread(THREAD_PRIORITY_ENCODE);
-            (*it)->millis_start = Time::currentTimeMillis();
-            break;
+            memory += t->memory;
+            demand += t->demand;
+            working++;
         }
+        // paused pipeline keeps its buffers until it is released
+        else if(t->state == task::Suspended && t->allocated)
+            memory += t->memory;
+        else if(t->state == task::NotStarted)
+            queue.push_back(t);
+    }
+    stable_sort(queue.begin(), queue.end(), _CompareTaskPriorities);
 
+    vector<task*> waiting;
+    for(vector<task*>::iterator it = queue.begin(); it!=queue.end(); it++)
+    {
+        task * t = *it;
+        // the first task starts whatever it takes
+        if(working == 0 || (memory + t->memory <= budget && demand < cores))
+        {
+            _LaunchTask(t);
+            memory += t->memory;
+            demand += t->demand;
+            working++;
+            for(vector<task*>::iterator w = waiting.begin(); w!=waiting.end(); w++)
+                (*w)->passed_over++;
+            continue;
+        }
+        if(t->passed_over >= RENDER_SCHEDULER_PASSES)
+            break;
+        waiting.push_back(t);
     }
+}
 
+void FindSuspendedTaskAndLaunch()
+{
+    const ScopedLock myScopedLock (tasks_list_critical);
+    _AdmitTasks();
+    _BalanceCores();
+    // buffers kept for the next render go back to the system
+    if(!_IsAnyTaskWorking())
+        GetFrameArena().Trim();
 }
 
 void task::run()
 {
     if(type == Encoding)
     {
+        int decoder_threads = jmax(1, GetTaskCores(this) / RENDER_DECODE_SHARE);
         for(vector<Timeline::Interval *>::iterator it = timeline->intervals.begin(); it!=timeline->intervals.end(); it++)
         {
             Movie * movie = (*it)->movie;
             if(!movie->loaded)
             {
+                movie->decoder_threads = decoder_threads;
                 movie->Load(movie->filename,true);
                 if(!movie->loaded)
                 {
                     {
                         const ScopedLock myScopedLock (tasks_list_critical);
                         status = LABEL_TASK_TAB_ERROR_CANT_LOAD_FILE + movie->filename;
+                        state = Failed;
+                        _JournalState(this);
                     }
+                    // the queue does not wait for this task any more
+                    FindSuspendedTaskAndLaunch();
                     return;
                 }
 
@@ -99,21 +443,60 @@ void task::run()
         {
             const ScopedLock myScopedLock (tasks_list_critical);
             millis_start = Time::currentTimeMillis();
+            allocated = true;
         }
         timeline->RecalculateDuration();
 
-        String render_result = timeline->Render(info,this,_ReportProgress,this);
+        String render_result = (renditions.size()>1)?timeline->RenderRenditions(renditions,this,_ReportProgress,this):timeline->Render(info,this,_ReportProgress,this);
+        if(render_result==LABEL_SAVE_VIDEO_SUSPENDED && !threadShouldExit())
+        {
+            bool resumed;
+            {
+                const ScopedLock myScopedLock (tasks_list_critical);
+                // resumed before the render has stopped
+                resumed = state != Suspended;
+                if(resumed)
+                    millis_start = Time::currentTimeMillis();
+                else
+                {
+                    released = true;
+                    allocated = false;
+                    measures.SetUtilisation(String::empty);
+                }
+            }
+            if(!resumed)
+            {
+                _ReleaseMovies(timeline);
+                // the memory of the render is free for the queue
+                FindSuspendedTaskAndLaunch();
+                const ScopedLock myScopedLock (tasks_list_critical);
+                // resumed while the resources were released, maybe paused again
+                resumed = state == Working;
+                if(resumed)
+                    millis_start = Time::currentTimeMillis();
+                else
+                {
+                    released = true;
+                    finishing = true;
+                }
+            }
+            if(resumed)
+                run();
+            return;
+        }
         if(render_result==String::empty)
         {
             const ScopedLock myScopedLock (tasks_list_critical);
             status = LABEL_TASK_TAB_DONE;
             state = Done;
+            _JournalState(this);
         }
         else
         {
             const ScopedLock myScopedLock (tasks_list_critical);
             status = LABEL_TASK_TAB_ERROR_CUSTOM + " " + render_result;
             state = Failed;
+            _JournalState(this);
         }
         FindSuspendedTaskAndLaunch();
     }
@@ -121,30 +504,98 @@ void task::run()
 
 void AddEncodingTask(Timeline * timeline, Movie::Info info)
 {
-    int number_of_working_task = 0;
-    task *new_task = 0;
+    AddEncodingTask(timeline, vector<Movie::Info>(1, info));
+}
+
+/* timeline - intervals of the task, the task deletes it */
+task * _NewEncodingTask(Timeline * timeline, const vector<Movie::Info> & renditions)
+{
+    const Movie::Info & info = renditions.front();
+    task * new_task = new task(timeline,task::Encoding,info,info.filename,LABEL_TASK_TAB_BEGIN);
+    if(renditions.size()>1)
+        new_task->renditions = renditions;
+    new_task->state = task::NotStarted;
+    return new_task;
+}
+
+void AddEncodingTask(Timeline * timeline, const vector<Movie::Info> & renditions)
+{
+    // the sources of the clone are not loaded yet
+    int64 source_pixels = 0;
+    for(vector<Timeline::Interval *>::iterator it = timeline->intervals.begin(); it!=timeline->intervals.end(); it++)
+        source_pixels = jmax(source_pixels, (int64)(*it)->movie->width * (*it)->movie->height);
     {
         const ScopedLock myScopedLock (tasks_list_critical);
-        for(vector<task*>::iterator it = tasks_list.begin(); it!=tasks_list.end(); it++)
-        {
-
-            if((*it)->state == task::Working)
-                number_of_working_task++;
-        }
-        new_task = new task(timeline->CloneIntervals(),task::Encoding,info,info.filename,LABEL_TASK_TAB_BEGIN);
+        task * new_task = _NewEncodingTask(timeline->CloneIntervals(), renditions);
+        new_task->id = next_task_id++;
+        _EstimateTask(new_task, source_pixels);
         tasks_list.push_back(new_task);
-        if(number_of_working_task<3)
+        if(tasks_journal.IsEnabled())
         {
-            new_task->startThread(THREAD_PRIORITY_ENCODE);
-            new_task->state = task::Working;
+            tasks_journal.Add(_GetJournalJob(new_task));
+            _CompactJournal();
         }
-        else
-            new_task->state = task::NotStarted;
+        _AdmitTasks();
+        _BalanceCores();
     }
 
 
 }
 
+/* the jobs come back in their order. Working ones wait for the queue again,
+   their renders go on from the checkpoints; paused ones stay paused */
+int RestoreTasks()
+{
+#if RENDER_QUEUE_JOURNAL
+    File file = File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile(RENDER_QUEUE_JOURNAL_FILE);
+    const ScopedLock myScopedLock (tasks_list_critical);
+    vector<RenderQueueJournal::Job> jobs;
+    if(!tasks_journal.Open(file, jobs))
+        return 0;
+    for(vector<RenderQueueJournal::Job>::iterator it = jobs.begin(); it!=jobs.end(); it++)
+    {
+        // sources are opened by the task, as the ones of CloneIntervals
+        Timeline * timeline = new Timeline();
+        for(vector<RenderQueueJournal::Part>::iterator part = it->parts.begin(); part!=it->parts.end(); part++)
+        {
+            Movie * movie = 0;
+            for(vector<Movie*>::iterator itm = timeline->movies_internal.begin(); itm!=timeline->movies_internal.end(); itm++)
+            {
+                if((*itm)->filename == part->filename)
+                {
+                    movie = *itm;
+                    break;
+                }
+            }
+            if(!movie)
+            {
+                movie = new Movie();
+                movie->filename = part->filename;
+                timeline->movies_internal.push_back(movie);
+            }
+            timeline->intervals.push_back(new Timeline::Interval(movie,part->start,part->end,part->absolute_start,0));
+        }
+        task * t = _NewEncodingTask(timeline, it->outputs);
+        t->id = it->id;
+        next_task_id = jmax(next_task_id, it->id + 1);
+        t->priority = it->priority;
+        t->memory = it->memory;
+        t->demand = it->demand;
+        t->millis_worked = it->millis_worked;
+        if(it->progress > 0.0)
+            t->measures.SetProgress(it->progress);
+        if(it->state == task::Suspended)
+            t->state = task::Suspended;
+        tasks_list.push_back(t);
+    }
+    _AdmitTasks();
+    _BalanceCores();
+    return (int)jobs.size();
+#else
+    return 0;
+#endif
+}
+
 bool RemoveTask(int number)
 {
     task*t;
@@ -155,6 +606,13 @@ bool RemoveTask(int number)
         vector<task*>::iterator it = tasks_list.begin() + number;
         t = *it;
         tasks_list.erase(it);
+        if(t->type == task::Encoding && tasks_journal.IsEnabled())
+        {
+            tasks_journal.Remove(t->id);
+            _CompactJournal();
+        }
+        _AdmitTasks();
+        _BalanceCores();
     }
     if(t->isThreadRunning())
         t->stopThread(20000);
@@ -164,14 +622,49 @@ bool RemoveTask(int number)
 
 
 
-bool FindTaskByNumberAndCopy(int number,task & t)
+/* the time left is taken from the time worked, a suspended task keeps the
+   one it had when it was paused. Called with tasks_list_critical held */
+void _GetTaskSnapshot(task * t, TaskSnapshot & snapshot)
+{
+    TaskProgress::Values values = t->measures.Read();
+    snapshot.state = t->state;
+    snapshot.type = t->type;
+    snapshot.filename = t->filename;
+    snapshot.renditions = (t->renditions.empty())?0:(int)t->renditions.size() - 1;
+    snapshot.status = t->status;
+    snapshot.utilisation = values.utilisation;
+    snapshot.progress = values.progress;
+    snapshot.frames = values.frames;
+    snapshot.bytes = values.bytes;
+    snapshot.cores = t->cores;
+    snapshot.priority = t->priority;
+    snapshot.millis_left = 0;
+    bool active = t->state == task::Working || t->state == task::Suspended;
+    if(active && values.reported)
+        snapshot.status = "    " + String(int(values.progress*100.0)) + "%";
+    if(active && values.progress>0.001)
+    {
+        int64 worked = t->millis_worked;
+        if(t->state == task::Working)
+            worked += Time::currentTimeMillis() - t->millis_start;
+        snapshot.millis_left = (int64)((double)worked * (1.0-values.progress) / values.progress);
+    }
+}
+
+void GetTaskSnapshots(vector<TaskSnapshot> & snapshots)
+{
+    const ScopedLock myScopedLock (tasks_list_critical);
+    snapshots.resize(tasks_list.size());
+    for(int i = 0; i<(int)tasks_list.size(); ++i)
+        _GetTaskSnapshot(tasks_list[i], snapshots[i]);
+}
+
+bool GetTaskSnapshot(int number, TaskSnapshot & snapshot)
 {
     const ScopedLock myScopedLock (tasks_list_critical);
-    if(tasks_list.size()<=number)
+    if(number < 0 || tasks_list.size()<=number)
         return false;
-
-    task *t_copy = tasks_list.at(number);
-    t.copy(t_copy);
+    _GetTaskSnapshot(tasks_list[number], snapshot);
     return true;
 }
 
@@ -185,6 +678,9 @@ bool PauseTask(int number)
     t = *it;
     t->state = task::Suspended;
     t->millis_worked += Time::currentTimeMillis() - t->millis_start;
+    _JournalState(t);
+    _AdmitTasks();
+    _BalanceCores();
     return true;
 }
 
@@ -197,10 +693,36 @@ bool ResumeTask(int number)
     vector<task*>::iterator it = tasks_list.begin() + number;
     t = *it;
 
-    t->state = task::Working;
-    if(!t->isThreadRunning())
-        t->startThread(THREAD_PRIORITY_ENCODE);
-    t->millis_start = Time::currentTimeMillis();
+    // the user starts the task whether there is room for it or not
+    _LaunchTask(t);
+    _BalanceCores();
+    return true;
+}
+
+bool MoveTask(int number, int position)
+{
+    const ScopedLock myScopedLock (tasks_list_critical);
+    if(number < 0 || tasks_list.size()<=number)
+        return false;
+    position = jlimit(0, (int)tasks_list.size() - 1, position);
+    task * t = tasks_list[number];
+    tasks_list.erase(tasks_list.begin() + number);
+    tasks_list.insert(tasks_list.begin() + position, t);
+    _JournalOrder();
+    _AdmitTasks();
+    _BalanceCores();
+    return true;
+}
+
+bool SetTaskPriority(int number, int priority)
+{
+    const ScopedLock myScopedLock (tasks_list_critical);
+    if(number < 0 || tasks_list.size()<=number)
+        return false;
+    tasks_list[number]->priority = jlimit((int)task::Low, (int)task::High, priority);
+    _JournalState(tasks_list[number]);
+    _AdmitTasks();
+    _BalanceCores();
     return true;
 }
 
@@ -7,6 +7,44 @@
 using namespace std;
 class Timeline;
 
+// Measures of the render published by the thread of the task without the
+// lock of the task list. The thread writes them between two increments of
+// the sequence; a reader copies them and reads again if the sequence was
+// odd or has changed meanwhile, so neither of them waits for the other.
+// Only the thread of the task writes, or the one creating it before it runs
+class TaskProgress
+{
+    private:
+    Atomic<int> sequence;
+    volatile double progress;
+    volatile int64 frames;
+    volatile int64 bytes;
+    volatile bool reported;
+    // UTF-8, cut at a whole character
+    char utilisation[RENDER_PROGRESS_TEXT];
+
+    void BeginWrite();
+    void EndWrite();
+
+    public:
+    class Values
+    {
+        public:
+        // part of the render done, 0..1
+        double progress;
+        int64 frames;
+        int64 bytes;
+        // load of the render pipeline stages
+        String utilisation;
+        // progress was published since the task was created
+        bool reported;
+    };
+    TaskProgress();
+    void SetProgress(double progress);
+    void SetFrames(int64 frames, int64 bytes);
+    void SetUtilisation(const String & utilisation);
+    Values Read() const;
+};
 
 class task : public Thread
 {
@@ -24,28 +62,88 @@ class task : public Thread
         Encoding,
         Panorama
     }type;
+    enum TaskPriority
+    {
+        Low,
+        Normal,
+        High
+    };
+    // the label of the state, the progress is in measures
     String status;
     String filename;
     Timeline * timeline;
     Movie::Info info;
+    // outputs of the job rendered from one decoding, the first is info; empty for a single output
+    vector<Movie::Info> renditions;
     task(Timeline * timeline, TaskType type, Movie::Info info,String filename, String status);
-    task();
-    void copy(task*copy_task);
     ~task();
     void run();
 
     int64 millis_start;
     int64 millis_worked;
+    TaskProgress measures;
+    // processor cores given to the task, 0 if it is not working
+    int cores;
+    // the suspended render has released its resources, the thread is finishing
+    bool released;
+    // the render of this run has started and holds its buffers until it
+    // ends or is released; a restored or never started task holds nothing
+    bool allocated;
+    // the released thread has looked at the state for the last time, it
+    // ends without taking the lock of the list
+    bool finishing;
+    // TaskPriority, the queue starts the higher ones first
+    int priority;
+    // bytes of memory and processor cores the render is expected to take
+    int64 memory;
+    int demand;
+    // tasks after this one started while it was waiting for room
+    int passed_over;
+    // the job in the journal of the queue
+    int id;
+};
+
+// what is shown of a task, taken for all of them at once
+class TaskSnapshot
+{
+    public:
+    task::TaskState state;
+    task::TaskType type;
+    // the main output, the other renditions are only counted
+    String filename;
+    int renditions;
+    // the label of the state or the percent done
+    String status;
+    String utilisation;
+    double progress;
     int64 millis_left;
+    int64 frames;
+    int64 bytes;
+    int cores;
+    int priority;
 };
 
 void AddEncodingTask(Timeline * timeline, Movie::Info info);
+void AddEncodingTask(Timeline * timeline, const vector<Movie::Info> & renditions);
+// called by the thread of the task, the lock of the list is not taken
+void ReportTaskUtilisation(task * t, const String & utilisation);
+void ReportTaskFrames(task * t, int64 frames, int64 bytes);
+// cores for the decoders and the encoders of the task, at least one
+int GetTaskCores(task * t);
 bool RemoveTask(int number);
 bool PauseTask(int number);
 bool ResumeTask(int number);
+// the task goes to the position in the list, the queue is looked through again
+bool MoveTask(int number, int position);
+bool SetTaskPriority(int number, int priority);
 extern EventList OnChangeList;
-bool FindTaskByNumberAndCopy(int number,task &t);
+// the list is locked once for all the tasks, their renders are not waited for
+void GetTaskSnapshots(vector<TaskSnapshot> & snapshots);
+bool GetTaskSnapshot(int number, TaskSnapshot & snapshot);
 int GetTaskLength();
 void FindSuspendedTaskAndLaunch();
+// jobs left in the journal of the queue by the last run of the editor are
+// added again, the number of them is returned
+int RestoreTasks();
 
 #endif
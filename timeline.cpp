@@ -16,6 +16,14 @@ Timeline::Timeline()
     current_interval = 0;
     disposeMovies = true;
     disposeIntervals = true;
+    token = new RequestToken();
+    request_id = 0;
+    request_type = SeekRequest::GotoSecond;
+    request_movie = 0;
+    request_interval = 0;
+    request_second = 0.;
+    request_object = 0;
+    request_callback = 0;
 };
 
 
@@ -51,6 +59,39 @@ Movie* Timeline::Load(String &filename, bool soft)
 
 }
 
+Timeline::Interval* Timeline::Append(String &filename, double start, double end, bool soft)
+{
+    Movie *movie = 0;
+    for(vector<Movie*>::iterator it = movies_internal.begin(); it!=movies_internal.end(); it++)
+    {
+        if((*it)->filename == filename)
+            movie = *it;
+    }
+    if(!movie)
+    {
+        movie = new Movie();
+        movie->Load(filename,soft);
+        if(!movie->loaded)
+        {
+            delete movie;
+            return 0;
+        }
+        movies.push_back(movie);
+        movies_internal.push_back(movie);
+    }
+
+    start = jlimit(0.0, movie->duration, start);
+    if(end <= start || end > movie->duration)
+        end = movie->duration;
+    Interval * interval = new Interval(movie,start,end,duration,movie->image_preview);
+    intervals.push_back(interval);
+    if(!current_interval)
+        current_interval = interval;
+    loaded = true;
+    RecalculateDuration();
+    return interval;
+}
+
 Timeline::Interval* Timeline::GetCurrentInterval()
 {
     return current_interval;
@@ -61,6 +102,12 @@ Image* Timeline::GetImage()
     return (GetCurrentInterval())?GetCurrentInterval()->movie->image:&black_image;
 }
 
+const CriticalSection & Timeline::GetImageLock()
+{
+    static CriticalSection black_image_critical;
+    return (GetCurrentInterval())?GetCurrentInterval()->movie->image_critical:black_image_critical;
+}
+
 double Timeline::GetFps()
 {
     return (current_interval)?GetCurrentInterval()->movie->fps:25.0;
@@ -101,6 +148,7 @@ void Timeline::Dispose()
 
 Timeline::~Timeline()
 {
+    token->alive = false;
     Dispose();
 }
 
@@ -218,6 +266,17 @@ bool Timeline::SkipFrame(bool jump_to_next)
     return ContinueToNextFrame(false,jump_to_next);
 }
 
+bool Timeline::DropFrame()
+{
+    if(current_interval && current + 1.0/GetFps() - current_interval->absolute_start + current_interval->start <= current_interval->end && current_interval->movie->DropFrame())
+    {
+        RecalculateCurrent();
+        return true;
+    }
+    // the next interval starts with a decoded frame
+    return SkipFrame();
+}
+
 bool Timeline::GoBack(int frames)
 {
     double frame = 1.0 / GetFps();
@@ -235,6 +294,161 @@ bool Timeline::GoBack(int frames)
     return true;
 }
 
+void _TimelineRequestDone(void * object, SeekRequest * request)
+{
+    Timeline * timeline = (Timeline *)object;
+    timeline->RequestDone(request);
+}
+
+int Timeline::PostRequest(Interval * interval, SeekRequest * request, void * object, void (*callback)(void * object))
+{
+    request->token = token;
+    request_type = request->type;
+    request_movie = interval->movie;
+    request_interval = interval;
+    request_object = object;
+    request_callback = callback;
+    request_id = request_movie->PostRequest(request);
+    return request_id;
+}
+
+void Timeline::RequestDone(SeekRequest * request)
+{
+    // only results of the movie we are waiting for are shown
+    if(request->movie != request_movie)
+        return;
+    bool last = request->id == request_id;
+    if(last)
+        request_movie = 0;
+    if(request->cancelled)
+        return;
+
+    Interval * interval = 0;
+    if(find(intervals.begin(), intervals.end(), request_interval) != intervals.end())
+        interval = request_interval;
+    else
+    {
+        for(vector<Interval*>::iterator it = intervals.begin(); it != intervals.end(); it++)
+        {
+            if((*it)->movie == request->movie && request->current>=(*it)->start && request->current<=(*it)->end)
+            {
+                interval = *it;
+                break;
+            }
+        }
+    }
+    if(!interval)
+        return;
+
+    current_interval = interval;
+    current = request->current - current_interval->start + current_interval->absolute_start;
+    if(request_callback)
+        request_callback(request_object);
+}
+
+int Timeline::GotoSecondAndReadAsync(double dest, void * object, void (*callback)(void * object), bool decode)
+{
+    Interval * interval = FindIntervalBySecond(dest);
+    if(request_movie && (!interval || interval->movie != request_movie))
+        request_movie->CancelRequest(request_id);
+
+    request_second = dest;
+    if(!interval)
+    {
+        request_movie = 0;
+        current_interval = 0;
+        current = dest;
+        if(callback)
+            callback(object);
+        return 0;
+    }
+
+    SeekRequest * request = new SeekRequest(SeekRequest::GotoSecond, this, _TimelineRequestDone);
+    request->dest = dest - interval->absolute_start + interval->start;
+    request->decode = decode;
+    return PostRequest(interval, request, object, callback);
+}
+
+int Timeline::GoBackAsync(int frames, void * object, void (*callback)(void * object))
+{
+    double desired = GetRequestedSecond() - ((double)frames) / GetFps();
+    if(desired<0.0)
+        desired = 0.0;
+
+    // relative request is only correct when nothing else is waiting
+    if(!request_movie && current_interval && desired>=current_interval->absolute_start)
+    {
+        SeekRequest * request = new SeekRequest(SeekRequest::GoBack, this, _TimelineRequestDone);
+        request->frames = frames;
+        request_second = desired;
+        return PostRequest(current_interval, request, object, callback);
+    }
+    return GotoSecondAndReadAsync(desired, object, callback);
+}
+
+int Timeline::SkipFramesAsync(int frames, void * object, void (*callback)(void * object))
+{
+    double desired = GetRequestedSecond() + ((double)frames) / GetFps();
+    Interval * interval = (request_movie)?request_interval:current_interval;
+    bool can_read = !request_movie || request_type == SeekRequest::ReadFrames;
+    if(can_read && interval && find(intervals.begin(), intervals.end(), interval) != intervals.end()
+        && desired - interval->absolute_start + interval->start <= interval->end)
+    {
+        SeekRequest * request = new SeekRequest(SeekRequest::ReadFrames, this, _TimelineRequestDone);
+        request->frames = frames;
+        request_second = desired;
+        return PostRequest(interval, request, object, callback);
+    }
+    return GotoSecondAndReadAsync(desired, object, callback);
+}
+
+int Timeline::GotoKeyFrameAsync(double dest, void * object, void (*callback)(void * object))
+{
+    Interval * interval = FindIntervalBySecond(dest);
+    if(request_movie && (!interval || interval->movie != request_movie))
+        request_movie->CancelRequest(request_id);
+
+    request_second = dest;
+    if(!interval)
+    {
+        request_movie = 0;
+        current_interval = 0;
+        current = dest;
+        if(callback)
+            callback(object);
+        return 0;
+    }
+
+    SeekRequest * request = new SeekRequest(SeekRequest::KeyFrame, this, _TimelineRequestDone);
+    request->dest = dest - interval->absolute_start + interval->start;
+    request->start = interval->start;
+    return PostRequest(interval, request, object, callback);
+}
+
+void Timeline::CancelRequests(bool wait)
+{
+    for(vector<Movie*>::iterator it = movies_internal.begin(); it!=movies_internal.end(); it++)
+        (*it)->CancelRequests(wait);
+    request_movie = 0;
+}
+
+bool Timeline::IsRequestPending()
+{
+    if(request_movie)
+        return true;
+    for(vector<Movie*>::iterator it = movies_internal.begin(); it!=movies_internal.end(); it++)
+    {
+        if((*it)->IsRequestPending())
+            return true;
+    }
+    return false;
+}
+
+double Timeline::GetRequestedSecond()
+{
+    return (request_movie)?request_second:current;
+}
+
 void Timeline::DecodeFrame()
 {
     if(!GetCurrentInterval())
@@ -4,12 +4,14 @@
 #include "juce/juce.h"
 #include "movie.h"
 #include "tasks.h"
+#include "seekWorker.h"
 #include <vector>
 
 using namespace std;
 
 extern Image black_image;
 class task;
+class RenditionSource;
 class Timeline
 {
 private:
@@ -30,6 +32,8 @@ public:
     void Dispose();
     ~Timeline();
     bool SkipFrame(bool jump_to_next = true);
+    // as SkipFrame, the frame is not decoded when it is not needed for the next ones
+    bool DropFrame();
     bool ReadAndDecodeFrame(bool jump_to_next = true);
     double GetFps();
 
@@ -39,7 +43,23 @@ public:
     bool GotoSecondAndRead(double dest,bool decode = true);
     bool GoBack(int frames);
 
+    // Asynchronous navigation for the message thread. Decoding is done on
+    // the movie seek thread, callback is called on the message thread when
+    // current position is updated. Newer request supersedes the older one.
+    int GotoSecondAndReadAsync(double dest, void * object, void (*callback)(void * object), bool decode = true);
+    int GoBackAsync(int frames, void * object, void (*callback)(void * object));
+    int SkipFramesAsync(int frames, void * object, void (*callback)(void * object));
+    // the keyframe at or before dest, used for fast shuttle playback. The
+    // keyframe being decoded is finished, a waiting one is replaced
+    int GotoKeyFrameAsync(double dest, void * object, void (*callback)(void * object));
+    void CancelRequests(bool wait = true);
+    bool IsRequestPending();
+    double GetRequestedSecond();
+    void RequestDone(SeekRequest * request);
+
     Image* GetImage();
+    // held while the picture of GetImage is used, the seek thread decodes into it
+    const CriticalSection & GetImageLock();
     Timeline();
     void DecodeFrame();
 
@@ -80,6 +100,9 @@ public:
     // >0 - move interval to insert_position, interval must be from existing timeline
     Timeline* PreviewInsertIntervalIn(Interval* interval, double insert_position = -1.0);
     void InsertIntervalIn(Timeline::Interval* insert_interval, double insert_position = -1.0);
+    // adds start..end of the file at the end of the timeline, end <= start
+    // takes the file to its end. The file is opened once for all its parts
+    Interval* Append(String &filename, double start, double end, bool soft);
 
     Interval  * FindIntervalBySecond(double second);
 
@@ -92,9 +115,25 @@ public:
     bool IsNearMovieBoundary();
 
     String Render(const Movie::Info & info, Thread * thread, void (* reportProgress)(task*,double), task* t);
+    // outputs of the timeline rendered at once, the ones of the same frame
+    // rate and of one pass share the decoded frames
+    String RenderRenditions(const vector<Movie::Info> & infos, Thread * thread, void (* reportProgress)(task*,double), task* t);
+    // source - decoder shared by the renditions of the job, 0 for a single output
+    String RenderOutput(const Movie::Info & info, Thread * thread, void (* reportProgress)(task*,double), task* t, RenditionSource * source, int rendition);
     bool IsEmpty();
 
     Timeline* CloneIntervals();
+
+private:
+    RequestToken::Ptr token;
+    int request_id;
+    SeekRequest::RequestType request_type;
+    Movie * request_movie;
+    Interval * request_interval;
+    double request_second;
+    void * request_object;
+    void (*request_callback)(void * object);
+    int PostRequest(Interval * interval, SeekRequest * request, void * object, void (*callback)(void * object));
 };
 
 
@@ -0,0 +1,172 @@
+#include "config.h"
+#include "twoPass.h"
+
+TwoPassStats::TwoPassStats()
+{
+    out = 0;
+    failed = false;
+}
+
+TwoPassStats::~TwoPassStats()
+{
+    if(out)
+        delete out;
+    if(file != File::nonexistent)
+        file.deleteFile();
+}
+
+bool TwoPassStats::StartWriting()
+{
+    file = File::createTempFile(".stats");
+    out = file.createOutputStream();
+    failed = out == 0;
+    return !failed;
+}
+
+void TwoPassStats::Write(const char * stats)
+{
+    if(failed || !out)
+        return;
+    size_t size = strlen(stats);
+    if(size && !out->write(stats, (int)size))
+        failed = true;
+}
+
+bool TwoPassStats::FinishWriting()
+{
+    if(out)
+    {
+        out->flush();
+        delete out;
+        out = 0;
+    }
+    return !failed;
+}
+
+char * TwoPassStats::Load()
+{
+    if(failed || !file.loadFileAsData(loaded))
+        return 0;
+    loaded.append("", 1);
+    return (char *)loaded.getData();
+}
+
+FrameCache::FrameCache()
+{
+    width = 0;
+    height = 0;
+    out = 0;
+    in = 0;
+    failed = false;
+    frames = 0;
+}
+
+FrameCache::~FrameCache()
+{
+    if(out)
+        delete out;
+    if(in)
+        delete in;
+    if(file != File::nonexistent)
+        file.deleteFile();
+}
+
+bool FrameCache::HasRoom(int64 frames, int width, int height)
+{
+    int64 frame_size = (int64)width * height * 3 / 2 + 1;
+    File temp = File::getSpecialLocation(File::tempDirectory);
+    // the rest of the volume is left for the output file
+    return frames * frame_size < temp.getBytesFreeOnVolume() / 2;
+}
+
+bool FrameCache::StartWriting(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    file = File::createTempFile(".frames");
+    out = file.createOutputStream(RENDER_FRAME_CACHE_BUFFER);
+    failed = out == 0;
+    frames = 0;
+    return !failed;
+}
+
+bool FrameCache::Kind(bool repeat)
+{
+    char kind = (repeat)?1:0;
+    return out->write(&kind, 1);
+}
+
+bool FrameCache::Plane(uint8_t * data, int linesize, int plane_width, int plane_height, bool write)
+{
+    for(int y = 0; y<plane_height; ++y, data += linesize)
+    {
+        if(write && !out->write(data, plane_width))
+            return false;
+        if(!write && in->read(data, plane_width) != plane_width)
+            return false;
+    }
+    return true;
+}
+
+void FrameCache::WritePicture(AVFrame * picture)
+{
+    if(failed || !out)
+        return;
+    int chroma_width = (width + 1) / 2;
+    int chroma_height = (height + 1) / 2;
+    failed = !Kind(false)
+             || !Plane(picture->data[0], picture->linesize[0], width, height, true)
+             || !Plane(picture->data[1], picture->linesize[1], chroma_width, chroma_height, true)
+             || !Plane(picture->data[2], picture->linesize[2], chroma_width, chroma_height, true);
+    frames++;
+}
+
+void FrameCache::WriteRepeat()
+{
+    if(failed || !out)
+        return;
+    failed = !Kind(true);
+    frames++;
+}
+
+bool FrameCache::FinishWriting()
+{
+    if(out)
+    {
+        out->flush();
+        delete out;
+        out = 0;
+    }
+    return !failed;
+}
+
+bool FrameCache::IsComplete()
+{
+    return !failed && frames > 0 && file.existsAsFile();
+}
+
+bool FrameCache::StartReading()
+{
+    if(!IsComplete())
+        return false;
+    FileInputStream * fs = file.createInputStream();
+    if(!fs)
+        return false;
+    in = new BufferedInputStream(fs, RENDER_FRAME_CACHE_BUFFER, true);
+    return true;
+}
+
+bool FrameCache::ReadPicture(AVFrame * picture, bool & repeat)
+{
+    if(!in || in->isExhausted())
+        return false;
+    repeat = in->readBool();
+    if(repeat)
+        return true;
+    int chroma_width = (width + 1) / 2;
+    int chroma_height = (height + 1) / 2;
+    failed = !Plane(picture->data[0], picture->linesize[0], width, height, false)
+             || !Plane(picture->data[1], picture->linesize[1], chroma_width, chroma_height, false)
+             || !Plane(picture->data[2], picture->linesize[2], chroma_width, chroma_height, false);
+    return !failed;
+}
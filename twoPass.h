@@ -0,0 +1,59 @@
+#ifndef TWO_PASS_H
+#define TWO_PASS_H
+#include "movie.h"
+
+// Statistics of the first pass. They are appended to a temporary file as the
+// encoder gives them out and read back only to open the encoder of the
+// second pass, which wants them as one string
+class TwoPassStats
+{
+    private:
+    File file;
+    FileOutputStream * out;
+    MemoryBlock loaded;
+    bool failed;
+
+    public:
+    TwoPassStats();
+    ~TwoPassStats();
+    bool StartWriting();
+    void Write(const char * stats);
+    bool FinishWriting();
+    // zero terminated statistics for stats_in, 0 if they could not be read
+    char * Load();
+};
+
+// Scaled pictures of the first pass kept on disk, the second pass reads them
+// instead of decoding and scaling the timeline again. Planes are stored as
+// they are, so the encoder gets exactly the same pictures in both passes
+class FrameCache
+{
+    private:
+    File file;
+    FileOutputStream * out;
+    InputStream * in;
+    int width;
+    int height;
+    bool failed;
+    int64 frames;
+
+    bool Kind(bool repeat);
+    bool Plane(uint8_t * data, int linesize, int plane_width, int plane_height, bool write);
+
+    public:
+    FrameCache();
+    ~FrameCache();
+    // free space of the temporary volume is enough for the frames of the timeline
+    static bool HasRoom(int64 frames, int width, int height);
+    bool StartWriting(int width, int height);
+    void WritePicture(AVFrame * picture);
+    void WriteRepeat();
+    bool FinishWriting();
+    // all frames of the first pass were written
+    bool IsComplete();
+    bool StartReading();
+    // false at the end of the cache, repeat - the previous picture is repeated
+    bool ReadPicture(AVFrame * picture, bool & repeat);
+};
+
+#endif
@@ -142,15 +142,30 @@ void videoPreviewComponent::UpdatePreview()
     _UpdatePreview(this);
 }
 
+void _RepaintPreview(void * object)
+{
+    videoPreviewComponent * o = (videoPreviewComponent *)object;
+    o->repaint();
+}
+
+void _RepaintPreviewAfterRequest(void * object, SeekRequest * request)
+{
+    _RepaintPreview(object);
+}
+
 void  videoPreviewComponent::timerCallback()
 {
 
     if(encodedMovie && !isThreadRunning() && !dirty)
     {
+        if(encodedMovie->IsRequestPending() || timeline_copy->IsRequestPending())
+            return;
         if(!(encodedMovie->ReadAndDecodeFrame()))
         {
-            encodedMovie->GotoSecondAndRead(0.0);
-            timeline_copy->GotoSecondAndRead(0.0,true);
+            SeekRequest * request = new SeekRequest(SeekRequest::GotoSecond,this,_RepaintPreviewAfterRequest);
+            request->dest = 0.0;
+            encodedMovie->PostRequest(request);
+            timeline_copy->GotoSecondAndReadAsync(0.0,this,_RepaintPreview);
         }
         else
         {
@@ -244,8 +259,12 @@ void videoPreviewComponent::paint(Graphics& g)
 
     if(encodedMovie)
     {
-        int image_width = parent->timeline->GetImage()->getWidth();
-        int image_height = parent->timeline->GetImage()->getHeight();
+        int image_width, image_height;
+        {
+            const ScopedLock image_lock (parent->timeline->GetImageLock());
+            image_width = parent->timeline->GetImage()->getWidth();
+            image_height = parent->timeline->GetImage()->getHeight();
+        }
         int aviable_width = width/2 - 3;
         int font_height = 1.2 * (double)g.getCurrentFont().getHeight();
 
@@ -277,7 +296,10 @@ void videoPreviewComponent::paint(Graphics& g)
         {
             srcY = (- aviable_height + image_height)/2;
         }
-        g.drawImage(*(timeline_copy->GetImage()),dstX,dstY,aviable_width,aviable_height,srcX,srcY,aviable_width,aviable_height);
+        {
+            const ScopedLock image_lock (timeline_copy->GetImageLock());
+            g.drawImage(*(timeline_copy->GetImage()),dstX,dstY,aviable_width,aviable_height,srcX,srcY,aviable_width,aviable_height);
+        }
 
         image_width = encodedMovie->width;
         image_height = encodedMovie->height;
@@ -302,7 +324,10 @@ void videoPreviewComponent::paint(Graphics& g)
         {
             srcY = (- aviable_height + image_height)/2;
         }
-        g.drawImage(*(encodedMovie->image),dstX + width/2,dstY,aviable_width,aviable_height,srcX,srcY,aviable_width,aviable_height);
+        {
+            const ScopedLock image_lock (encodedMovie->image_critical);
+            g.drawImage(*(encodedMovie->image),dstX + width/2,dstY,aviable_width,aviable_height,srcX,srcY,aviable_width,aviable_height);
+        }
     }else
     {
         g.drawText(LABEL_VIDEO_PREVIEW_FAILED,0,0,width,height/2,Justification::centredBottom,true);